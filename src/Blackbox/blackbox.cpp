@@ -0,0 +1,265 @@
+// SD Card Flight Recorder for the dRehmFlight Flight Control Software
+//
+// GPL 3.0
+
+#include <cstring>
+
+#include "../Console/console.h"
+
+#define __BLACKBOX__ 1
+#include "blackbox.h"
+
+// DMAMEM (RAM2): keeps the 64KB ring out of the tightly coupled memory used by the control loop
+
+DMAMEM static uint8_t ring[Blackbox::RING_SIZE] __attribute__((aligned(32)));
+
+bool
+Blackbox::setup()
+{
+  if (!sd.begin(SdioConfig(FIFO_SDIO))) {
+    console.println(F("Blackbox: no SD card"));
+    state = State::NO_CARD;
+    return false;
+  }
+
+  // First log file prepared now, the same steps as after a recording
+
+  file_index = 0;
+  state      = State::STOPPING;
+  step       = Step::FIND_NAME;
+
+  while (state == State::STOPPING) stop_step();
+
+  return state == State::READY;
+}
+
+bool
+Blackbox::start(const uint8_t * header, uint16_t size)
+{
+  if (state != State::READY) return false;
+
+  state   = State::RECORDING;
+  sync_ms = millis();
+  return log(header, size);
+}
+
+void
+Blackbox::stop()
+{
+  if (state == State::RECORDING) {
+    state = State::STOPPING;
+    step  = Step::FLUSH;
+  }
+}
+
+bool
+Blackbox::log(const uint8_t * frame, uint16_t size)
+{
+  // Called from the control loop: copies the frame or drops it, never waits for the card
+
+  if (state != State::RECORDING) return false;
+
+  uint32_t fill = head - tail;
+
+  if ((fill + size) > RING_SIZE) {
+    frames_dropped++;
+    return false;
+  }
+
+  uint32_t pos   = head % RING_SIZE;
+  uint32_t first = min((uint32_t) size, RING_SIZE - pos);
+
+  memcpy(&ring[pos], frame, first);
+  if (first < size) memcpy(ring, frame + first, size - first);
+
+  head += size;
+  fill += size;
+  frames_logged++;
+  if (fill > max_fill) max_fill = fill;
+
+  return true;
+}
+
+bool
+Blackbox::write_sector()
+{
+  // Full sectors only, they are always contiguous in the ring and aligned in the file
+
+  uint32_t start = micros();
+
+  if (file.write(&ring[tail % RING_SIZE], SECTOR_SIZE) != SECTOR_SIZE) return false;
+
+  uint32_t duration = micros() - start;
+  if (duration > max_write_us) max_write_us = duration;
+
+  tail += SECTOR_SIZE;
+  sectors_written++;
+
+  return true;
+}
+
+bool
+Blackbox::sync_file()
+{
+  // The full sectors are written directly to the card: a sync only writes the directory entry
+  // sector, with the file size, a bounded operation like each STOPPING step
+
+  uint32_t start = micros();
+
+  if (!file.sync()) return false;
+
+  uint32_t duration = micros() - start;
+  if (duration > max_sync_us) max_sync_us = duration;
+
+  sync_ms = millis();
+
+  return true;
+}
+
+void
+Blackbox::write_error()
+{
+  // The data not written is dropped: the file keeps what the card accepted
+
+  console.println(F("Blackbox: SD card write error"));
+  tail = head;
+  file.truncate();
+  file.close();
+  state = State::NO_CARD;
+}
+
+void
+Blackbox::run()
+{
+  if ((state == State::RECORDING) && ((millis() - sync_ms) >= SYNC_INTERVAL_MS)) {
+    if (sd.card()->isBusy()) {
+      busy_count++;
+    }
+    else if (!sync_file()) {
+      write_error();
+    }
+    return;
+  }
+
+  if ((state == State::RECORDING) || ((state == State::STOPPING) && (step == Step::FLUSH))) {
+    for (int i = 0; (i < MAX_SECTORS_PER_RUN) && ((head - tail) >= SECTOR_SIZE); i++) {
+      if (file.isBusy()) {
+        busy_count++;
+        return;
+      }
+      if (!write_sector()) {
+        write_error();
+        return;
+      }
+    }
+  }
+
+  if (state != State::STOPPING) return;
+
+  if (step == Step::FLUSH) {
+    if ((head - tail) < SECTOR_SIZE) step = Step::LAST_SECTOR;    // Next run
+    return;
+  }
+
+  stop_step();
+}
+
+void
+Blackbox::stop_step()
+{
+  // One SD card operation: a few ms at most, except PREALLOCATE which searches the free
+  // clusters of the card (run once per disarm, never while recording)
+
+  if (sd.card()->isBusy()) {
+    busy_count++;
+    return;
+  }
+
+  switch (step) {
+    case Step::FLUSH:
+      break;
+
+    case Step::LAST_SECTOR: {
+      // Less than a sector, contiguous: tail is sector aligned in the ring
+
+      uint32_t remaining = head - tail;
+
+      if ((remaining > 0) && (file.write(&ring[tail % RING_SIZE], remaining) != remaining)) {
+        write_error();
+        return;
+      }
+      tail += remaining;
+      step  = Step::TRUNCATE;
+      break;
+    }
+
+    case Step::TRUNCATE:
+      file.truncate();                 // The preallocated space is given back
+      step = Step::CLOSE;
+      break;
+
+    case Step::CLOSE:
+      file.close();
+      step = Step::FIND_NAME;
+      break;
+
+    case Step::FIND_NAME:
+      // Next free LOGnnnnn.BBL name, the search restarts from the last one used
+
+      for (int i = 0; i < NAMES_PER_RUN; i++) {
+        if (++file_index >= 100000) {
+          console.println(F("Blackbox: unable to create a log file"));
+          state = State::NO_CARD;
+          return;
+        }
+        snprintf(file_name, sizeof(file_name), "LOG%05lu.BBL", file_index);
+        if (!sd.exists(file_name)) {
+          step = Step::OPEN;
+          break;
+        }
+      }
+      break;
+
+    case Step::OPEN:
+      if (!file.open(file_name, O_RDWR | O_CREAT | O_TRUNC)) {
+        console.println(F("Blackbox: unable to create a log file"));
+        state = State::NO_CARD;
+        return;
+      }
+      step = Step::PREALLOCATE;
+      break;
+
+    case Step::PREALLOCATE:
+      if (!file.preAllocate(PREALLOCATED_SIZE)) {
+        console.println(F("Blackbox: unable to create a log file"));
+        file.close();
+        state = State::NO_CARD;
+        return;
+      }
+      head  = tail = 0;
+      state = State::READY;
+      break;
+  }
+}
+
+void
+Blackbox::reset_stats()
+{
+  frames_logged   = 0;
+  frames_dropped  = 0;
+  sectors_written = 0;
+  busy_count      = 0;
+  max_fill        = 0;
+  max_write_us    = 0;
+  max_sync_us     = 0;
+}
+
+void
+Blackbox::show_stats()
+{
+  static const char * state_names[] = { "no card", "ready", "recording", "stopping" };
+
+  console.printf(F("Blackbox: %s, %lu frames, %lu dropped, %lu sectors, ring max %lu%%, write max %luus, sync max %luus, card busy %lu\n"),
+                state_names[(int) state], frames_logged, frames_dropped, sectors_written,
+                (max_fill * 100) / RING_SIZE, max_write_us, max_sync_us, busy_count);
+}
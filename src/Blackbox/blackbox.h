@@ -0,0 +1,85 @@
+#pragma once
+
+// SD Card Flight Recorder for the dRehmFlight Flight Control Software
+//
+// Frames are copied by log() into a RAM ring buffer from the control loop, which never waits:
+// a frame that does not fit is dropped and counted. The ring is emptied by run(), called from a
+// low priority background task, one 512 bytes sector at a time and only while the card is not
+// busy, so that a write never waits for the card programming time. Log files are created and
+// preallocated ahead of time (LOGnnnnn.BBL in the root of the Teensy 4.1 built-in SDIO card) to
+// keep the FAT updates out of the recording. stop() lets run() flush the ring, then the file is
+// truncated to its real size, closed, and the next one is prepared: one SD card operation per
+// run() call (Step), each one started only when the card is not busy. While recording, run() also
+// syncs the file every SYNC_INTERVAL_MS, in place of its sector writes: the file size saved in its
+// directory entry then follows the recording, and a log cut by a power loss is readable up to the
+// last sync.
+//
+// GPL 3.0
+
+#include <cinttypes>
+
+#include "Arduino.h"
+#include <SdFat.h>
+
+class Blackbox
+{
+  public:
+    enum class State : uint8_t { NO_CARD, READY, RECORDING, STOPPING };
+
+    static const uint32_t SECTOR_SIZE         = 512;
+    static const uint32_t RING_SIZE           = 64 * 1024;          // Must be a multiple of SECTOR_SIZE
+    static const int      MAX_SECTORS_PER_RUN = 4;
+    static const uint64_t PREALLOCATED_SIZE   = 256ULL * 1024 * 1024;
+    static const int      NAMES_PER_RUN       = 8;                  // sd.exists() calls per run() in FIND_NAME
+    static const uint32_t SYNC_INTERVAL_MS    = 1000;
+
+    Blackbox() : state(State::NO_CARD), step(Step::FLUSH), file_index(0) { reset_stats(); }
+   ~Blackbox() { }
+
+    bool setup();
+    bool start(const uint8_t * header, uint16_t size);
+    void stop();
+    bool log(const uint8_t * frame, uint16_t size);
+    void run();
+
+    inline State get_state()    const { return state; }
+    inline bool  is_recording() const { return state == State::RECORDING; }
+
+    void reset_stats();
+    void show_stats();
+
+  private:
+    // STOPPING steps: the ring is flushed by full sectors, then one step per run() call
+
+    enum class Step : uint8_t { FLUSH, LAST_SECTOR, TRUNCATE, CLOSE, FIND_NAME, OPEN, PREALLOCATE };
+
+    SdFs     sd;
+    FsFile   file;
+    State    state;
+    Step     step;
+    uint32_t file_index;                // Number of the prepared LOGnnnnn.BBL file
+    char     file_name[16];
+
+    uint32_t head;                      // Total bytes put in the ring, wraps at 2^32
+    uint32_t tail;                      // Total bytes written to the card
+    uint32_t sync_ms;                   // millis() of the last file sync
+
+    uint32_t frames_logged;
+    uint32_t frames_dropped;            // Ring full, the card is not keeping up
+    uint32_t sectors_written;
+    uint32_t busy_count;                // run() calls that found the card busy
+    uint32_t max_fill;                  // Ring high-water mark (bytes)
+    uint32_t max_write_us;              // Longest sector write
+    uint32_t max_sync_us;               // Longest file sync
+
+    void stop_step();
+    bool write_sector();
+    bool sync_file();
+    void write_error();
+};
+
+#if __BLACKBOX__
+  Blackbox blackbox;
+#else
+  extern Blackbox blackbox;
+#endif
@@ -0,0 +1,131 @@
+// Blackbox Log Encoder for the dRehmFlight Flight Control Software
+//
+// GPL 3.0
+
+#include <cstdio>
+#include <cstring>
+
+#include "../Console/console.h"
+
+#define __BLACKBOX_FORMAT__ 1
+#include "blackbox_format.h"
+
+bool
+BlackboxEncoder::setup(const BlackboxField * field_list, int count, uint16_t intra_frames_interval)
+{
+  if ((count <= 0) || (count > MAX_FIELDS) || (intra_frames_interval == 0)) return false;
+
+  fields         = field_list;
+  field_count    = count;
+  intra_interval = intra_frames_interval;
+
+  reset();
+  reset_stats();
+
+  return true;
+}
+
+void
+BlackboxEncoder::reset()
+{
+  // Next frame is an intra frame
+
+  frame_index = 0;
+}
+
+int
+BlackboxEncoder::write_header(char * buffer, int size, uint16_t divider, uint16_t loop_rate)
+{
+  int len = snprintf(buffer, size, "DRFBBX2\nH divider:%u\nH loop_rate:%u\nH intra_interval:%u\n",
+                     divider, loop_rate, intra_interval);
+
+  for (int i = 0; (i < field_count) && (len < size); i++) {
+    len += snprintf(buffer + len, size - len, "H field:%s,%g,%d\n",
+                    fields[i].name, (double) fields[i].scale, (int) fields[i].predictor);
+  }
+
+  if (len < size) len += snprintf(buffer + len, size - len, "H end\n");
+
+  return (len < size) ? len : 0; // Truncated header
+}
+
+int
+BlackboxEncoder::encode(const int32_t * values, uint8_t * frame)
+{
+  uint32_t  start = ARM_DWT_CYCCNT;
+  uint8_t * p     = frame;
+
+  if (frame_index == 0) {
+    *p++ = SYNC_0;
+    *p++ = SYNC_1;
+    *p++ = INTRA_MARKER;
+    for (int i = 0; i < field_count; i++) {
+      p = put_varint(p, values[i]);
+      previous2[i] = previous[i] = values[i];
+    }
+    intra_count++;
+  }
+  else {
+    // Bitmap of the fields that differ from their prediction, then their differences only
+
+    uint8_t * bitmap = p + 1;
+    *p++ = INTER_MARKER;
+    memset(bitmap, 0, (field_count + 7) >> 3);
+    p += (field_count + 7) >> 3;
+
+    for (int i = 0; i < field_count; i++) {
+      // Modulo 2^32 arithmetic: micros() based fields wrap around
+      uint32_t prediction;
+      switch (fields[i].predictor) {
+        case BlackboxPredictor::PREVIOUS: prediction = previous[i];                                          break;
+        case BlackboxPredictor::LINEAR:   prediction = 2 * (uint32_t) previous[i] - (uint32_t) previous2[i]; break;
+        default:                          prediction = 0;                                                    break;
+      }
+      int32_t residual = (int32_t) ((uint32_t) values[i] - prediction);
+      if (residual != 0) {
+        bitmap[i >> 3] |= 1 << (i & 7);
+        p = put_varint(p, residual);
+      }
+      previous2[i] = previous[i];
+      previous[i]  = values[i];
+    }
+  }
+
+  if (++frame_index >= intra_interval) frame_index = 0;
+
+  int      len    = p - frame;
+  uint32_t cycles = ARM_DWT_CYCCNT - start;
+
+  frame_count++;
+  byte_count   += len;
+  total_cycles += cycles;
+  if (cycles > max_cycles) max_cycles = cycles;
+
+  return len;
+}
+
+void
+BlackboxEncoder::reset_stats()
+{
+  frame_count  = 0;
+  intra_count  = 0;
+  byte_count   = 0;
+  total_cycles = 0;
+  max_cycles   = 0;
+}
+
+void
+BlackboxEncoder::show_stats()
+{
+  if (frame_count == 0) return;
+
+  // Compared with the same fields logged as float32
+
+  float    avg_size   = (float) byte_count / frame_count;
+  uint32_t raw_size   = field_count * sizeof(float);
+  uint32_t cycles_us  = F_CPU_ACTUAL / 1000000;
+
+  console.printf(F("Blackbox encoder: %lu frames (%lu intra), %.1f bytes/frame, %.1fx vs float32, encode avg %.2fus max %.2fus\n"),
+                frame_count, intra_count, avg_size, raw_size / avg_size,
+                (float) total_cycles / frame_count / cycles_us, (float) max_cycles / cycles_us);
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+// Blackbox Log Encoder for the dRehmFlight Flight Control Software
+//
+// A log is a text header followed by binary frames. The header describes every field (name,
+// scale and predictor), so that a decoder does not need to know the firmware version:
+//
+//   DRFBBX2
+//   H divider:2
+//   H loop_rate:2000
+//   H intra_interval:32
+//   H field:time_us,1,2
+//   ...
+//   H end
+//
+// Every field is logged as an integer: round(value * scale). An intra frame (SYNC_0, SYNC_1, 'I')
+// holds the values themselves, every intra_interval frames and at the start of the log. In between,
+// an inter frame ('P') holds the difference with a prediction from the previous frames: the previous
+// value (PREVIOUS) or the linear extrapolation of the last two (LINEAR). A bitmap (one bit per
+// field, LSB first) follows the 'P' marker, only the fields with a non-zero difference are written.
+// Values and differences are zig-zag varints (1 byte for -64..63). A frame never exceeds
+// MAX_FRAME_SIZE bytes and the encoding time of each frame is measured with the DWT cycle counter.
+//
+// GPL 3.0
+
+#include <cinttypes>
+#include <cmath>
+
+#include "Arduino.h"
+
+enum class BlackboxPredictor : uint8_t { NONE, PREVIOUS, LINEAR };
+
+struct BlackboxField {
+  const char        * name;
+  float               scale;      // Logged value is round(value * scale)
+  BlackboxPredictor   predictor;
+};
+
+class BlackboxEncoder
+{
+  public:
+    static const int     MAX_FIELDS     = 64;
+    static const int     MAX_FRAME_SIZE = 3 + MAX_FIELDS / 8 + MAX_FIELDS * 5;
+    static const uint8_t SYNC_0         = 0xA5;
+    static const uint8_t SYNC_1         = 0x5A;
+    static const uint8_t INTRA_MARKER   = 'I';
+    static const uint8_t INTER_MARKER   = 'P';
+
+    BlackboxEncoder() : fields(nullptr), field_count(0), intra_interval(32) { reset(); }
+   ~BlackboxEncoder() { }
+
+    bool     setup(const BlackboxField * field_list, int count, uint16_t intra_frames_interval);
+    int      write_header(char * buffer, int size, uint16_t divider, uint16_t loop_rate);
+    int      encode(const int32_t * values, uint8_t * frame);
+    void     reset();
+    void     reset_stats();
+    void     show_stats();
+
+    inline int get_field_count() const { return field_count; }
+
+    static inline int32_t to_field(float value, float scale) { return lroundf(value * scale); }
+
+  private:
+    const BlackboxField * fields;
+    int                   field_count;
+    uint16_t              intra_interval;
+    uint16_t              frame_index;       // Frames since the last intra frame
+
+    int32_t  previous[MAX_FIELDS];
+    int32_t  previous2[MAX_FIELDS];
+
+    uint32_t frame_count;
+    uint32_t intra_count;
+    uint64_t byte_count;
+    uint64_t total_cycles;
+    uint32_t max_cycles;
+
+    static inline uint8_t * put_varint(uint8_t * p, int32_t value) {
+      uint32_t v = ((uint32_t) value << 1) ^ (uint32_t) (value >> 31); // zig-zag
+      while (v >= 0x80) {
+        *p++ = (uint8_t) (v | 0x80);
+        v >>= 7;
+      }
+      *p++ = (uint8_t) v;
+      return p;
+    }
+};
+
+#if __BLACKBOX_FORMAT__
+  BlackboxEncoder blackbox_encoder;
+#else
+  extern BlackboxEncoder blackbox_encoder;
+#endif
@@ -5,212 +5,148 @@
 // (c) February 2021 - GPL 3.0
 
 #include <cinttypes>
+#include <cstddef>
 #include <cstring>
 
 #include <EEPROM.h>
 #include <CRC32.h>
 
 #include "tests.h"
+#include "../Profiler/profiler.h"
+#include "../Scheduler/scheduler.h"
+#include "../Console/console.h"
 
 #define __CONFIG__ 1
 #include "config.h"
+#include "config_v12.h"
+#include "flight_params.h"
 
 // ---- Modifyable variables from the dRehmFlight global data ----
 
 extern unsigned long USB_output;    // = 0; // No USB debugging output by default
 extern unsigned long receiver_only; // = 0; // If = 1 all other functions are not being used in the loop
 
-//Radio failsafe values for every channel in the event that bad reciever data is detected. Recommended defaults:
-extern unsigned long     throttle_fs; // = 1000; //thro
-extern unsigned long      aileron_fs; // = 1500; //ail
-extern unsigned long     elevator_fs; // = 1500; //elev
-extern unsigned long       rudder_fs; // = 1500; //rudd
-extern unsigned long throttle_cut_fs; // = 2000; //gear, greater than 1500 = throttle cut
-extern unsigned long         aux1_fs; // = 2000; //aux1
+// The saved parameters are generated from the registry (params.h): their global variables, or
+// for the controller and mixer values the flight_params edit copy (published to the control loop
+// by flight_params.publish(), see flight_params.h)
 
-//Filter parameters - Defaults tuned for 2kHz loop rate; Do not touch unless you know what you are doing:
-extern float B_madgwick;     // = 0.04;  //Madgwick filter parameter
-extern float B_accel;        // = 0.14;  //Accelerometer LP filter paramter, (MPU6050 default: 0.14. MPU9250 default: 0.2)
-extern float B_gyro;         // = 0.1;   //Gyro LP filter paramter, (MPU6050 default: 0.1. MPU9250 default: 0.17)
-extern float B_mag;          // = 1.0;   //Magnetometer LP filter parameter
+#define PARAM_RUNNING_FLIGHT(name) &flight_params.edit.name
+#define PARAM_RUNNING_GLOBAL(name) &name
 
-//Magnetometer calibration parameters - if using MPU9250, uncomment calibrateMagnetometer() in void setup() to get these values, else just ignore these
-extern float MagErrorX;      // = 0.0;
-extern float MagErrorY;      // = 0.0; 
-extern float MagErrorZ;      // = 0.0;
-extern float MagScaleX;      // = 1.0;
-extern float MagScaleY;      // = 1.0;
-extern float MagScaleZ;      // = 1.0;
+// This is the data configuration saved in EEPROM, one field per registry parameter. A save
+// converts it to a tagged record (see below).
 
-//Controller parameters (take note of defaults before modifying!): 
-extern float i_limit;        // = 25.0;    //Integrator saturation level, mostly for safety (default 25.0)
-extern float maxRoll;        // = 30.0;    //Max roll angle in degrees for angle mode (maximum 60 degrees), deg/sec for rate mode 
-extern float maxPitch;       // = 30.0;    //Max pitch angle in degrees for angle mode (maximum 60 degrees), deg/sec for rate mode
-extern float maxYaw;         // = 160.0;   //Max yaw rate in deg/sec
-
-extern float Kp_roll_angle;  // = 0.2;     //Roll P-gain - angle mode 
-extern float Ki_roll_angle;  // = 0.3;     //Roll I-gain - angle mode
-extern float Kd_roll_angle;  // = 0.05;    //Roll D-gain - angle mode (if using controlANGLE2(), has no effect. Use B_loop_roll)
-extern float B_loop_roll;    // = 0.9;     //Roll damping term for controlANGLE2(), lower is more damping (must be between 0 to 1)
-extern float Kp_pitch_angle; // = 0.2;     //Pitch P-gain - angle mode
-extern float Ki_pitch_angle; // = 0.3;     //Pitch I-gain - angle mode
-extern float Kd_pitch_angle; // = 0.05;    //Pitch D-gain - angle mode (if using controlANGLE2(), has no effect. Use B_loop_pitch)
-extern float B_loop_pitch;   // = 0.9;     //Pitch damping term for controlANGLE2(), lower is more damping (must be between 0 to 1)
-
-extern float Kp_roll_rate;   // = 0.15;    //Roll P-gain - rate mode
-extern float Ki_roll_rate;   // = 0.2;     //Roll I-gain - rate mode
-extern float Kd_roll_rate;   // = 0.0002;  //Roll D-gain - rate mode (be careful when increasing too high, motors will begin to overheat!)
-extern float Kp_pitch_rate;  // = 0.15;    //Pitch P-gain - rate mode
-extern float Ki_pitch_rate;  // = 0.2;     //Pitch I-gain - rate mode
-extern float Kd_pitch_rate;  // = 0.0002;  //Pitch D-gain - rate mode (be careful when increasing too high, motors will begin to overheat!)
-
-extern float Kp_yaw;         // = 0.3;     //Yaw P-gain
-extern float Ki_yaw;         // = 0.05;    //Yaw I-gain
-extern float Kd_yaw;         // = 0.00015; //Yaw D-gain (be careful when increasing too high, motors will begin to overheat!)
-
-// Mixer Forward Flight Parameter
-
-extern float mx_fw_pitch_amount;                    // = 0.5;
-extern float mx_fw_roll_amount;                     // = 0.65;
-
-// float mx_front_pitch_amount = 0.5;
-extern float mx_fw_front_motor_center_offset;       // = 0.57;
-
-extern float mx_fw_left_aileron_center_offset;      // = 0.55;
-extern float mx_fw_right_aileron_center_offset;     // = 0.56;
-
-extern float mx_fw_right_elevator_center_offset;    // = 0.48;
-extern float mx_fw_left_elevator_center_offset;     // = 0.46;
-
-// Mixer Hover Flight Parameter
-
-extern float mx_hover_front_roll_amount;            // = 0.65;
-extern float mx_hover_front_motor_center_offset;    // = 0.57;
-
-extern float mx_hover_right_elevator_center_offset; // = 0.48;
-extern float mx_hover_left_elevator_center_offset;  // = 0.46;
-
-extern float mx_hover_left_aileron_bottom_offset;   // = 0.0;
-extern float mx_hover_right_aileron_bottom_offset;  // = 1.0;
-
-// Mixer Transition Flight Parameters
-
-extern float mx_trans_front_roll_amount;            // = 0.65;
-extern float mx_trans_front_motor_center_offset;    // = 0.57;
-
-extern float mx_trans_left_aileron_45_offset;       // = 0.22;
-extern float mx_trans_right_aileron_45_offset;      // = 0.87;
-
-extern float mx_trans_right_elevator_center_offset; // = 0.48;
-extern float mx_trans_left_elevator_center_offset;  // = 0.46;
-
-extern float mx_trans_pitch_rate_low;               // = 0.1;
-extern float mx_trans_pitch_rate_high;              // = 0.3;
-
-extern float mx_trans_pitch_to_over_duration;       // = 5.5;
-extern float mx_trans_pitch_to_forward_duration;    // = 2.5;
-
-// This is the data configuration saved in EEPROM. This reflects the parameters defined above.
-// A Version number and a CRC checksum are used to validate the content.
+#define CONFIG_FIELD(storage, type, name, caption, def, min, max) PARAM_TYPE_##type name;
 
 #pragma pack(push, 1)
 static struct ConfigData {
-  
-  //Radio failsafe values for every channel in the event that bad reciever data is detected. Recommended defaults:
-  unsigned long     throttle_fs; // = 1000; //thro
-  unsigned long      aileron_fs; // = 1500; //ail
-  unsigned long     elevator_fs; // = 1500; //elev
-  unsigned long       rudder_fs; // = 1500; //rudd
-  unsigned long throttle_cut_fs; // = 2000; //gear, greater than 1500 = throttle cut
-  unsigned long         aux1_fs; // = 2000; //aux1
 
-  //Filter parameters - Defaults tuned for 2kHz loop rate; Do not touch unless you know what you are doing:
-  float B_madgwick;     // = 0.04;  //Madgwick filter parameter
-  float B_accel;        // = 0.14;  //Accelerometer LP filter paramter, (MPU6050 default: 0.14. MPU9250 default: 0.2)
-  float B_gyro;         // = 0.1;   //Gyro LP filter paramter, (MPU6050 default: 0.1. MPU9250 default: 0.17)
-  float B_mag;          // = 1.0;   //Magnetometer LP filter parameter
+  ALL_PARAMS(CONFIG_FIELD)
+
+} config_data;
+#pragma pack(pop)
 
-  //Magnetometer calibration parameters - if using MPU9250, uncomment calibrateMagnetometer() in void setup() to get these values, else just ignore these
-  float MagErrorX;      // = 0.0;
-  float MagErrorY;      // = 0.0; 
-  float MagErrorZ;      // = 0.0;
-  float MagScaleX;      // = 1.0;
-  float MagScaleY;      // = 1.0;
-  float MagScaleZ;      // = 1.0;
+// The registry parameters, indexed by ParamId
 
-  //Controller parameters (take note of defaults before modifying!): 
-  float i_limit;        // = 25.0;    //Integrator saturation level, mostly for safety (default 25.0)
-  float maxRoll;        // = 30.0;    //Max roll angle in degrees for angle mode (maximum 60 degrees), deg/sec for rate mode 
-  float maxPitch;       // = 30.0;    //Max pitch angle in degrees for angle mode (maximum 60 degrees), deg/sec for rate mode
-  float maxYaw;         // = 160.0;   //Max yaw rate in deg/sec
+#define PARAM_ENTRY(storage, type, name, caption, def, min, max) \
+  { #name, caption, ValueType::type, offsetof(ConfigData, name), PARAM_RUNNING_##storage(name), \
+    (float) (def), (float) (min), (float) (max), param_hash(#name) },
 
-  float Kp_roll_angle;  // = 0.2;     //Roll P-gain - angle mode 
-  float Ki_roll_angle;  // = 0.3;     //Roll I-gain - angle mode
-  float Kd_roll_angle;  // = 0.05;    //Roll D-gain - angle mode (if using controlANGLE2(), has no effect. Use B_loop_roll)
-  float B_loop_roll;    // = 0.9;     //Roll damping term for controlANGLE2(), lower is more damping (must be between 0 to 1)
-  float Kp_pitch_angle; // = 0.2;     //Pitch P-gain - angle mode
-  float Ki_pitch_angle; // = 0.3;     //Pitch I-gain - angle mode
-  float Kd_pitch_angle; // = 0.05;    //Pitch D-gain - angle mode (if using controlANGLE2(), has no effect. Use B_loop_pitch)
-  float B_loop_pitch;   // = 0.9;     //Pitch damping term for controlANGLE2(), lower is more damping (must be between 0 to 1)
+static constexpr Param PARAMS[] = { ALL_PARAMS(PARAM_ENTRY) };
 
-  float Kp_roll_rate;   // = 0.15;    //Roll P-gain - rate mode
-  float Ki_roll_rate;   // = 0.2;     //Roll I-gain - rate mode
-  float Kd_roll_rate;   // = 0.0002;  //Roll D-gain - rate mode (be careful when increasing too high, motors will begin to overheat!)
-  float Kp_pitch_rate;  // = 0.15;    //Pitch P-gain - rate mode
-  float Ki_pitch_rate;  // = 0.2;     //Pitch I-gain - rate mode
-  float Kd_pitch_rate;  // = 0.0002;  //Pitch D-gain - rate mode (be careful when increasing too high, motors will begin to overheat!)
+const int PARAM_COUNT = (int) ParamId::COUNT;
 
-  float Kp_yaw;         // = 0.3;     //Yaw P-gain
-  float Ki_yaw;         // = 0.05;    //Yaw I-gain
-  float Kd_yaw;         // = 0.00015; //Yaw D-gain (be careful when increasing too high, motors will begin to overheat!)
+static_assert(sizeof(PARAMS) / sizeof(PARAMS[0]) == PARAM_COUNT, "ParamId and PARAMS differ");
+static_assert(PARAM_COUNT < 255, "Too many parameters for the name hash table");
 
-  // Mixer Forward Flight Parameter
+// Open addressing hash table of the parameter names, built at compile time
 
-  float mx_fw_pitch_amount;                    // = 0.5;
-  float mx_fw_roll_amount;                     // = 0.65;
+struct ParamIndex {
+  static const uint32_t SIZE = 256;   // Power of 2, at least twice the number of parameters
+  uint8_t slots[SIZE];                // Parameter index + 1, 0 = empty
 
-  // float mx_front_pitch_amount = 0.5;
-  float mx_fw_front_motor_center_offset;       // = 0.57;
+  constexpr ParamIndex() : slots() {
+    for (int i = 0; i < PARAM_COUNT; i++) {
+      uint32_t slot = PARAMS[i].hash & (SIZE - 1);
+      while (slots[slot] != 0) slot = (slot + 1) & (SIZE - 1);
+      slots[slot] = i + 1;
+    }
+  }
+};
 
-  float mx_fw_left_aileron_center_offset;      // = 0.55;
-  float mx_fw_right_aileron_center_offset;     // = 0.56;
+static constexpr ParamIndex param_index;
 
-  float mx_fw_right_elevator_center_offset;    // = 0.48;
-  float mx_fw_left_elevator_center_offset;     // = 0.46;
+static constexpr bool
+param_hashes_unique()
+{
+  for (int i = 0; i < PARAM_COUNT; i++) {
+    for (int j = i + 1; j < PARAM_COUNT; j++) {
+      if (PARAMS[i].hash == PARAMS[j].hash) return false;
+    }
+  }
+  return true;
+}
 
-  // Mixer Hover Flight Parameter
+// ---- EEPROM records ----
+//
+// A record is a header, a list of tagged entries (ID, type, length, value) and a CRC32 of both.
+// The ID of an entry is the name hash of its parameter: when loading, entries are found by ID,
+// entries of unknown ID (parameters removed, or added by a newer version) are skipped, a value
+// of another type is converted and the parameters without an entry keep their default value.
+// Tuned values then survive firmware updates: VERSION only changes with the record format.
+//
+// The EEPROM holds two records, A and B. A save writes the record not holding the last saved
+// configuration, its CRC last, then the record with the highest sequence number is loaded: a
+// save interrupted by a power loss leaves the previous configuration in place.
 
-  float mx_hover_front_roll_amount;            // = 0.65;
-  float mx_hover_front_motor_center_offset;    // = 0.57;
+enum class RecordType : uint8_t { FLOAT = 1, ULONG = 2 };
 
-  float mx_hover_right_elevator_center_offset; // = 0.48;
-  float mx_hover_left_elevator_center_offset;  // = 0.46;
+#pragma pack(push, 1)
+struct RecordHeader {
+  uint16_t version;              // Record format
+  uint16_t size;                 // Bytes of entries
+  uint32_t sequence;
+};
 
-  float mx_hover_left_aileron_bottom_offset;   // = 1.0;
-  float mx_hover_right_aileron_bottom_offset;  // = 0.0;
+struct RecordEntry {
+  uint32_t id;                   // param_hash() of the parameter name
+  uint8_t  type;                 // RecordType
+  uint8_t  length;               // Value bytes
+  uint8_t  value[4];
+};
 
-  // Mixer Transition Flight Parameters
+static struct Record {
+  RecordHeader header;
+  RecordEntry  entries[PARAM_COUNT];
+  uint32_t     crc;
+} record_image;                  // Built from config_data by start_save()
+#pragma pack(pop)
 
-  float mx_trans_front_roll_amount;            // = 0.65;
-  float mx_trans_front_motor_center_offset;    // = 0.57;
+const uint32_t RECORD_SIZE   = 2048;
+const uint32_t ENTRY_HEADER  = offsetof(RecordEntry, value);
+const uint32_t ENTRIES_START = sizeof(RecordHeader);
+const uint32_t ENTRIES_END   = offsetof(Record, crc);
 
-  float mx_trans_left_aileron_45_offset;       // = 0.22;
-  float mx_trans_right_aileron_45_offset;      // = 0.87;
+static_assert(sizeof(Record) <= RECORD_SIZE, "Too many parameters for the EEPROM records");
+#ifdef E2END
+  static_assert(2 * RECORD_SIZE <= E2END + 1, "EEPROM too small for two records");
+#endif
 
-  float mx_trans_right_elevator_center_offset; // = 0.48;
-  float mx_trans_left_elevator_center_offset;  // = 0.46;
+// Content of the two EEPROM records, the bytes to save are found by comparison with it
 
-  float mx_trans_pitch_rate_low;               // = 0.1;
-  float mx_trans_pitch_rate_high;              // = 0.3;
+static byte records[2][RECORD_SIZE];
 
-  float mx_trans_pitch_to_over_duration;       // = 5.5;
-  float mx_trans_pitch_to_forward_duration;    // = 2.5;
+// Renamed parameters keep their saved value: ID of the previous name, parameter
 
-  uint32_t version;
-  uint32_t crc;
+struct ParamRename {
+  uint32_t id;
+  ParamId  param;
+};
 
-} config_data;
-#pragma pack(pop)
+static const ParamRename PARAM_RENAMES[] = {
+  // { param_hash("previous_name"), ParamId::new_name },
+  { 0, ParamId::COUNT }
+};
 
 const char     ESC     =  27;
 const char     BS      =   8;
@@ -218,7 +154,10 @@ const char     LF      =  10;
 const char     CR      =  13;
 const char     DEL     = 127;
 
-const uint32_t VERSION =  12;
+const uint32_t VERSION =  13;
+
+static_assert(ParamIndex::SIZE >= 2 * PARAM_COUNT, "Parameter name hash table too small");
+static_assert(param_hashes_unique(),                "Two parameter names have the same hash");
 
 static SelectEntry output_select[] = {
   F("None"),
@@ -233,6 +172,11 @@ static SelectEntry output_select[] = {
   F("Motors' Commands"),
   F("Servos' Commands"),
   F("Loop Duration"),
+  F("Scheduler Stats"),
+  F("Loop Profile"),
+  F("Motors' RPM"),
+  F("Gyro FFT Peaks"),
+  F("Telemetry View Binary (500Hz)"),
   nullptr
 };
 
@@ -242,92 +186,68 @@ static SelectEntry enable_select[] = {
   nullptr
 };
 
+// Menu line of a registry parameter
+
+#define MENU_VALUE_FLOAT(def) { fval: (float) (def) }
+#define MENU_VALUE_ULONG(def) { uval: (unsigned long) (def) }
+
+#define MENU_PARAM(storage, type, name, caption, def, min, max) \
+  { F(caption), F(#name), ValueType::type, PARAM_RUNNING_##storage(name), &config_data.name, nullptr, \
+    MENU_VALUE_##type(def), &PARAMS[(int) ParamId::name] },
+
 static MenuEntry debug_menu[] = {
   { F("USB Data Output"),   F("USB_output"),    ValueType::SELECT, &USB_output,    nullptr, output_select, { uval: 0UL } },
   { F("Radiocomms Only"),   F("receiver_only"), ValueType::SELECT, &receiver_only, nullptr, enable_select, { uval: 0UL } },
   { F("Servo test"),        nullptr,            ValueType::SERVO,   nullptr,       nullptr, nullptr,               0UL   },
   { F("Motor test"),        nullptr,            ValueType::MOTOR,   nullptr,       nullptr, nullptr,               0UL   },
   { F("Motor calibration"), nullptr,            ValueType::CALIB,   nullptr,       nullptr, nullptr,               0UL   },
+  { F("Loop Profile"),      nullptr,            ValueType::PROFILE, nullptr,       nullptr, nullptr,               0UL   },
   { nullptr,                nullptr,            ValueType::END,     nullptr,       nullptr, nullptr,               0UL   }
 };
 
-static MenuEntry roll_menu [] = {
-  { F("Max Angle"),         F("maxRoll"),       ValueType::FLOAT, &maxRoll,       &config_data.maxRoll,       nullptr, { fval: (float)  30.0    } },
-  { F("P-gain Angle Mode"), F("Kp_roll_angle"), ValueType::FLOAT, &Kp_roll_angle, &config_data.Kp_roll_angle, nullptr, { fval: (float)   0.2    } },
-  { F("I-gain Angle Mode"), F("Ki_roll_angle"), ValueType::FLOAT, &Ki_roll_angle, &config_data.Ki_roll_angle, nullptr, { fval: (float)   0.3    } },
-  { F("D-gain Angle Mode"), F("Kd_roll_angle"), ValueType::FLOAT, &Kd_roll_angle, &config_data.Kd_roll_angle, nullptr, { fval: (float)   0.05   } },
-  { F("P-gain Rate Mode"),  F("Kp_roll_rate"),  ValueType::FLOAT, &Kp_roll_rate,  &config_data.Kp_roll_rate,  nullptr, { fval: (float)   0.15   } },
-  { F("I-gain Rate Mode"),  F("Ki_roll_rate"),  ValueType::FLOAT, &Ki_roll_rate,  &config_data.Ki_roll_rate,  nullptr, { fval: (float)   0.2    } },
-  { F("D-gain Rate Mode"),  F("Kd_roll_rate"),  ValueType::FLOAT, &Kd_roll_rate,  &config_data.Kd_roll_rate,  nullptr, { fval: (float)   0.0002 } },
-  { F("Loop Damping"),      F("B_loop_roll"),   ValueType::FLOAT, &B_loop_roll,   &config_data.B_loop_roll,   nullptr, { fval: (float)   0.9    } },
-  { nullptr,                nullptr,            ValueType::END,   nullptr,         nullptr,                   nullptr,                   0UL      }
+static MenuEntry roll_menu[] =
+{
+  ROLL_PARAMS(MENU_PARAM)
+  { nullptr, nullptr, ValueType::END, nullptr, nullptr, nullptr, 0UL }
 };
 
-static MenuEntry pitch_menu [] = {
-  { F("Max Angle"),         F("maxPitch"),       ValueType::FLOAT, &maxPitch,       &config_data.maxPitch,       nullptr, { fval: (float)  30.0    } },
-  { F("P-gain Angle Mode"), F("Kp_pitch_angle"), ValueType::FLOAT, &Kp_pitch_angle, &config_data.Kp_pitch_angle, nullptr, { fval: (float)   0.2    } },
-  { F("I-gain Angle Mode"), F("Ki_pitch_angle"), ValueType::FLOAT, &Ki_pitch_angle, &config_data.Ki_pitch_angle, nullptr, { fval: (float)   0.3    } },
-  { F("D-gain Angle Mode"), F("Kd_pitch_angle"), ValueType::FLOAT, &Kd_pitch_angle, &config_data.Kd_pitch_angle, nullptr, { fval: (float)   0.05   } },
-  { F("P-gain Rate Mode"),  F("Kp_pitch_rate"),  ValueType::FLOAT, &Kp_pitch_rate,  &config_data.Kp_pitch_rate,  nullptr, { fval: (float)   0.15   } },
-  { F("I-gain Rate Mode"),  F("Ki_pitch_rate"),  ValueType::FLOAT, &Ki_pitch_rate,  &config_data.Ki_pitch_rate,  nullptr, { fval: (float)   0.2    } },
-  { F("D-gain Rate Mode"),  F("Kd_pitch_rate"),  ValueType::FLOAT, &Kd_pitch_rate,  &config_data.Kd_pitch_rate,  nullptr, { fval: (float)   0.0002 } },
-  { F("Loop Damping"),      F("B_loop_pitch"),   ValueType::FLOAT, &B_loop_pitch,   &config_data.B_loop_pitch,   nullptr, { fval: (float)   0.9    } },
-  { nullptr,                nullptr,             ValueType::END,   nullptr,          nullptr,                    nullptr,                   0UL      }
+static MenuEntry pitch_menu[] =
+{
+  PITCH_PARAMS(MENU_PARAM)
+  { nullptr, nullptr, ValueType::END, nullptr, nullptr, nullptr, 0UL }
 };
 
-static MenuEntry yaw_menu [] = {
-  { F("Max Rate"),          F("maxYaw"), ValueType::FLOAT, &maxYaw, &config_data.maxYaw, nullptr, { fval: (float) 160.0     } },
-  { F("P-gain"),            F("Kp_yaw"), ValueType::FLOAT, &Kp_yaw, &config_data.Kp_yaw, nullptr, { fval: (float)   0.3     } },
-  { F("I-gain"),            F("Ki_yaw"), ValueType::FLOAT, &Ki_yaw, &config_data.Ki_yaw, nullptr, { fval: (float)   0.05    } },
-  { F("D-gain"),            F("Kd_yaw"), ValueType::FLOAT, &Kd_yaw, &config_data.Kd_yaw, nullptr, { fval: (float)   0.00015 } },
-  { nullptr,                nullptr,     ValueType::END,   nullptr,  nullptr,            nullptr,                   0UL       }
+static MenuEntry yaw_menu[] =
+{
+  YAW_PARAMS(MENU_PARAM)
+  { nullptr, nullptr, ValueType::END, nullptr, nullptr, nullptr, 0UL }
 };
 
 static MenuEntry ctrl_menu[] =
 {
-  { F("Integrator Saturation Level"), F("i_limit"), ValueType::FLOAT,  &i_limit, &config_data.i_limit, nullptr, { fval: (float) 25.0 } },
-  { F("Roll"),                        nullptr,      ValueType::MENU,  roll_menu,  nullptr,             nullptr,                 0UL    },
-  { F("Pitch"),                       nullptr,      ValueType::MENU, pitch_menu,  nullptr,             nullptr,                 0UL    },
-  { F("Yaw"),                         nullptr,      ValueType::MENU,   yaw_menu,  nullptr,             nullptr,                 0UL    },
-  { nullptr,                          nullptr,      ValueType::END,     nullptr,  nullptr,             nullptr,                 0UL    }
+  CTRL_PARAMS(MENU_PARAM)
+  { F("Roll"),                        nullptr,      ValueType::MENU,   roll_menu,  nullptr,             nullptr,                 0UL    },
+  { F("Pitch"),                       nullptr,      ValueType::MENU,  pitch_menu,  nullptr,             nullptr,                 0UL    },
+  { F("Yaw"),                         nullptr,      ValueType::MENU,    yaw_menu,  nullptr,             nullptr,                 0UL    },
+  { nullptr,                          nullptr,      ValueType::END,      nullptr,  nullptr,             nullptr,                 0UL    }
 };
 
 static MenuEntry hover_menu[] =
 {
-  { F("Left Aileron Bottom Offset"),   F("mx_hover_left_aileron_bottom_offset"),   ValueType::FLOAT, &mx_hover_left_aileron_bottom_offset,   &config_data.mx_hover_left_aileron_bottom_offset,   nullptr, { fval: (float) LEFT_AILERON_BOTTOM   } },
-  { F("Left Elevator Center Offset"),  F("mx_hover_left_elevator_center_offset"),  ValueType::FLOAT, &mx_hover_left_elevator_center_offset,  &config_data.mx_hover_left_elevator_center_offset,  nullptr, { fval: (float) LEFT_ELEVATOR_CENTER  } },
-  { F("Front Motor Center Offset"),    F("mx_hover_front_motor_center_offset"),    ValueType::FLOAT, &mx_hover_front_motor_center_offset,    &config_data.mx_hover_front_motor_center_offset,    nullptr, { fval: (float) FRONT_MOTOR_CENTER    } },
-  { F("Right Elevator Center Offset"), F("mx_hover_right_elevator_center_offset"), ValueType::FLOAT, &mx_hover_right_elevator_center_offset, &config_data.mx_hover_right_elevator_center_offset, nullptr, { fval: (float) RIGHT_ELEVATOR_CENTER } },
-  { F("Right Aileron Bottom Offset"),  F("mx_hover_right_aileron_bottom_offset"),  ValueType::FLOAT, &mx_hover_right_aileron_bottom_offset,  &config_data.mx_hover_right_aileron_bottom_offset,  nullptr, { fval: (float) RIGHT_AILERON_BOTTOM  } },
-  { F("Front Roll Amount"),            F("mx_hover_front_roll_amount"),            ValueType::FLOAT, &mx_hover_front_roll_amount,            &config_data.mx_hover_front_roll_amount,            nullptr, { fval: (float) 0.65                  } },
-  { nullptr,                           nullptr,                                    ValueType::END,    nullptr,                                nullptr,                                           nullptr,                 0UL                     }
+  HOVER_PARAMS(MENU_PARAM)
+  { nullptr, nullptr, ValueType::END, nullptr, nullptr, nullptr, 0UL }
 };
 
 static MenuEntry trans_menu[] =
 {
-  { F("Left Aileron 45 Offset"),       F("mx_trans_left_aileron_45_offset"),       ValueType::FLOAT, &mx_trans_left_aileron_45_offset,       &config_data.mx_trans_left_aileron_45_offset,       nullptr, { fval: (float) LEFT_AILERON_45       } },
-  { F("Left Elevator Center Offset"),  F("mx_trans_left_elevator_center_offset"),  ValueType::FLOAT, &mx_trans_left_elevator_center_offset,  &config_data.mx_trans_left_elevator_center_offset,  nullptr, { fval: (float) LEFT_ELEVATOR_CENTER  } },
-  { F("Front Motor Center Offset"),    F("mx_trans_front_motor_center_offset"),    ValueType::FLOAT, &mx_trans_front_motor_center_offset,    &config_data.mx_trans_front_motor_center_offset,    nullptr, { fval: (float) FRONT_MOTOR_CENTER    } },
-  { F("Right Aileron 45 Offset"),      F("mx_trans_right_aileron_45_offset"),      ValueType::FLOAT, &mx_trans_right_aileron_45_offset,      &config_data.mx_trans_right_aileron_45_offset,      nullptr, { fval: (float) RIGHT_AILERON_45      } },
-  { F("Right Elevator Center Offset"), F("mx_trans_right_elevator_center_offset"), ValueType::FLOAT, &mx_trans_right_elevator_center_offset, &config_data.mx_trans_right_elevator_center_offset, nullptr, { fval: (float) RIGHT_ELEVATOR_CENTER } },
-  { F("Front Roll Amount"),            F("mx_trans_front_roll_amount"),            ValueType::FLOAT, &mx_trans_front_roll_amount,            &config_data.mx_trans_front_roll_amount,            nullptr, { fval: (float) 0.65                  } },
-  { F("Pitch Rate Low"),               F("mx_trans_pitch_rate_low"),               ValueType::FLOAT, &mx_trans_pitch_rate_low,               &config_data.mx_trans_pitch_rate_low,               nullptr, { fval: (float) 0.1                   } },
-  { F("Pitch Rate High"),              F("mx_trans_pitch_rate_high"),              ValueType::FLOAT, &mx_trans_pitch_rate_high,              &config_data.mx_trans_pitch_rate_high,              nullptr, { fval: (float) 0.3                   } },
-  { F("Pitch to Hover Duration"),      F("mx_trans_pitch_to_over_duration"),       ValueType::FLOAT, &mx_trans_pitch_to_over_duration,       &config_data.mx_trans_pitch_to_over_duration,       nullptr, { fval: (float) 5.5                   } },
-  { F("Pitch to Forward Duration"),    F("mx_trans_pitch_to_forward_duration"),    ValueType::FLOAT, &mx_trans_pitch_to_forward_duration,    &config_data.mx_trans_pitch_to_forward_duration,    nullptr, { fval: (float) 2.5                   } },
-  { nullptr,                           nullptr,                                    ValueType::END,    nullptr,                                nullptr,                                           nullptr,                 0UL                     }
+  TRANS_PARAMS(MENU_PARAM)
+  { nullptr, nullptr, ValueType::END, nullptr, nullptr, nullptr, 0UL }
 };
 
 static MenuEntry fw_menu[] =
 {
-  { F("Pitch Amount"),                 F("mx_fw_pitch_amount"),                 ValueType::FLOAT, &mx_fw_pitch_amount,                 &config_data.mx_fw_pitch_amount,                 nullptr, { fval: (float) 0.5                     } },
-  { F("Roll Amount"),                  F("mx_fw_roll_amount"),                  ValueType::FLOAT, &mx_fw_roll_amount,                  &config_data.mx_fw_roll_amount,                  nullptr, { fval: (float) 0.65                    } },
-  { F("Left Aileron Center Offset"),   F("mx_fw_left_aileron_center_offset"),   ValueType::FLOAT, &mx_fw_left_aileron_center_offset,   &config_data.mx_fw_left_aileron_center_offset,   nullptr, { fval: (float) LEFT_AILERON_CENTER     } },
-  { F("Left Elevator Center Offset"),  F("mx_fw_left_elevator_center_offset"),  ValueType::FLOAT, &mx_fw_left_elevator_center_offset,  &config_data.mx_fw_left_elevator_center_offset,  nullptr, { fval: (float) LEFT_ELEVATOR_CENTER    } },
-  { F("Front Motor Center Offset"),    F("mx_fw_front_motor_center_offset"),    ValueType::FLOAT, &mx_fw_front_motor_center_offset,    &config_data.mx_fw_front_motor_center_offset,    nullptr, { fval: (float) FRONT_MOTOR_CENTER      } },
-  { F("Right Elevator Center Offset"), F("mx_fw_right_elevator_center_offset"), ValueType::FLOAT, &mx_fw_right_elevator_center_offset, &config_data.mx_fw_right_elevator_center_offset, nullptr, { fval: (float) RIGHT_ELEVATOR_CENTER   } },
-  { F("Right Aileron Center Offset"),  F("mx_fw_right_aileron_center_offset"),  ValueType::FLOAT, &mx_fw_right_aileron_center_offset,  &config_data.mx_fw_right_aileron_center_offset,  nullptr, { fval: (float) RIGHT_AILERON_CENTER    } },
-  { nullptr,                           nullptr,                                 ValueType::END,    nullptr,                             nullptr,                                        nullptr,                 0UL                       }
+  FW_PARAMS(MENU_PARAM)
+  { nullptr, nullptr, ValueType::END, nullptr, nullptr, nullptr, 0UL }
 };
 
 static MenuEntry mixer_menu[] =
@@ -340,52 +260,62 @@ static MenuEntry mixer_menu[] =
 
 static MenuEntry fail_safe_menu[] =
 {
-  { F("Throttle"),     F("throttle_fs"),     ValueType::ULONG, &    throttle_fs, &config_data.    throttle_fs, nullptr, { uval: 1000UL } },
-  { F("Aileron"),      F("aileron_fs"),      ValueType::ULONG, &     aileron_fs, &config_data.     aileron_fs, nullptr, { uval: 1500UL } },
-  { F("Elevator"),     F("elevator_fs"),     ValueType::ULONG, &    elevator_fs, &config_data.    elevator_fs, nullptr, { uval: 1500UL } },
-  { F("Rudder"),       F("rudder_fs"),       ValueType::ULONG, &      rudder_fs, &config_data.      rudder_fs, nullptr, { uval: 1500UL } },
-  { F("Throttle Cut"), F("throttle_cut_fs"), ValueType::ULONG, &throttle_cut_fs, &config_data.throttle_cut_fs, nullptr, { uval: 2000UL } },
-  { F("Aux1"),         F("aux1_fs"),         ValueType::ULONG, &        aux1_fs, &config_data.        aux1_fs, nullptr, { uval: 2000UL } },
-  { nullptr,           nullptr,              ValueType::END,            nullptr,                      nullptr, nullptr,         0UL      }
+  FAIL_SAFE_PARAMS(MENU_PARAM)
+  { nullptr, nullptr, ValueType::END, nullptr, nullptr, nullptr, 0UL }
 };
 
 static MenuEntry filter_menu[] =
 {
-  { F("Madgwick"),               F("B_madgwick"), ValueType::FLOAT, &B_madgwick, &config_data.B_madgwick, nullptr, { fval: (float) 0.04 } },
-  { F("Accelerometer Low Pass"), F("B_accel"),    ValueType::FLOAT, &B_accel,    &config_data.B_accel,    nullptr, { fval: (float) 0.14 } },
-  { F("Gyro Low Pass"),          F("B_gyro"),     ValueType::FLOAT, &B_gyro,     &config_data.B_gyro,     nullptr, { fval: (float) 0.1  } },
-  { F("Magnetometer Low Pass"),  F("B_mag"),      ValueType::FLOAT, &B_mag,      &config_data.B_mag,      nullptr, { fval: (float) 1.0  } },
-  { nullptr,                     nullptr,         ValueType::END,    nullptr,     nullptr,                nullptr,                 0UL    }
+  FILTER_PARAMS(MENU_PARAM)
+  { nullptr, nullptr, ValueType::END, nullptr, nullptr, nullptr, 0UL }
 };
 
 static MenuEntry mag_menu[] =
 {
-  { F("Error X"), F("MagErrorX"), ValueType::FLOAT, &MagErrorX, &config_data.MagErrorX, nullptr, { fval: (float) 0.0 } },
-  { F("Error Y"), F("MagErrorY"), ValueType::FLOAT, &MagErrorY, &config_data.MagErrorY, nullptr, { fval: (float) 0.0 } },
-  { F("Error Z"), F("MagErrorZ"), ValueType::FLOAT, &MagErrorZ, &config_data.MagErrorZ, nullptr, { fval: (float) 0.0 } },
-  { F("Scale X"), F("MagScaleX"), ValueType::FLOAT, &MagScaleX, &config_data.MagScaleX, nullptr, { fval: (float) 1.0 } },
-  { F("Scale Y"), F("MagScaleY"), ValueType::FLOAT, &MagScaleY, &config_data.MagScaleY, nullptr, { fval: (float) 1.0 } },
-  { F("Scale Z"), F("MagScaleZ"), ValueType::FLOAT, &MagScaleZ, &config_data.MagScaleZ, nullptr, { fval: (float) 1.0 } },
-  { nullptr,      nullptr,        ValueType::END,    nullptr,    nullptr,               nullptr,                 0UL   }
+  MAG_PARAMS(MENU_PARAM)
+  { nullptr, nullptr, ValueType::END, nullptr, nullptr, nullptr, 0UL }
+};
+
+static MenuEntry imu_offsets_menu[] =
+{
+  IMU_OFFSETS_PARAMS(MENU_PARAM)
+  { nullptr, nullptr, ValueType::END, nullptr, nullptr, nullptr, 0UL }
+};
+
+static MenuEntry blackbox_menu[] =
+{
+  BLACKBOX_PARAMS(MENU_PARAM)
+  { nullptr, nullptr, ValueType::END, nullptr, nullptr, nullptr, 0UL }
+};
+
+static MenuEntry telemetry_menu[] =
+{
+  TELEMETRY_PARAMS(MENU_PARAM)
+  { nullptr, nullptr, ValueType::END, nullptr, nullptr, nullptr, 0UL }
 };
 
 static MenuEntry main_menu[] = 
 {
-  { F("Controller Params"),              nullptr, ValueType::MENU,  ctrl_menu,      nullptr, nullptr, { uval: 0UL } },
-  { F("Mixer Params"),                   nullptr, ValueType::MENU,  mixer_menu,     nullptr, nullptr, { uval: 0UL } },
-  { F("Fail Safe Params"),               nullptr, ValueType::MENU,  fail_safe_menu, nullptr, nullptr, { uval: 0UL } },
-  { F("Filter Params"),                  nullptr, ValueType::MENU,  filter_menu,    nullptr, nullptr, { uval: 0UL } },
-  { F("Magnetometer Params"),            nullptr, ValueType::MENU,  mag_menu,       nullptr, nullptr, { uval: 0UL } },
-  { F("Debug Params"),                   nullptr, ValueType::MENU,  debug_menu,     nullptr, nullptr, { uval: 0UL } },
-  { F("Save params to EEPROM"),          nullptr, ValueType::SAVE,  nullptr,        nullptr, nullptr, { uval: 0UL } },
-  { F("Reset params to default values"), nullptr, ValueType::RESET, nullptr,        nullptr, nullptr, { uval: 0UL } },
-  { F("List all params"),                nullptr, ValueType::LIST,  nullptr,        nullptr, nullptr, { uval: 0UL } },
-  { F("Exit"),                           nullptr, ValueType::EXIT,  nullptr,        nullptr, nullptr, { uval: 0UL } },
-  { nullptr,                             nullptr, ValueType::END,   nullptr,        nullptr, nullptr,         0UL   }
+  { F("Controller Params"),              nullptr, ValueType::MENU,  ctrl_menu,        nullptr, nullptr, { uval: 0UL } },
+  { F("Mixer Params"),                   nullptr, ValueType::MENU,  mixer_menu,       nullptr, nullptr, { uval: 0UL } },
+  { F("Fail Safe Params"),               nullptr, ValueType::MENU,  fail_safe_menu,   nullptr, nullptr, { uval: 0UL } },
+  { F("Filter Params"),                  nullptr, ValueType::MENU,  filter_menu,      nullptr, nullptr, { uval: 0UL } },
+  { F("Magnetometer Params"),            nullptr, ValueType::MENU,  mag_menu,         nullptr, nullptr, { uval: 0UL } },
+  { F("IMU Offsets Params"),             nullptr, ValueType::MENU,  imu_offsets_menu, nullptr, nullptr, { uval: 0UL } },
+  { F("Blackbox Params"),                nullptr, ValueType::MENU,  blackbox_menu,    nullptr, nullptr, { uval: 0UL } },
+  { F("Telemetry Params"),               nullptr, ValueType::MENU,  telemetry_menu,   nullptr, nullptr, { uval: 0UL } },
+  { F("Debug Params"),                   nullptr, ValueType::MENU,  debug_menu,       nullptr, nullptr, { uval: 0UL } },
+  { F("Save params to EEPROM"),          nullptr, ValueType::SAVE,  nullptr,          nullptr, nullptr, { uval: 0UL } },
+  { F("Reset params to default values"), nullptr, ValueType::RESET, nullptr,          nullptr, nullptr, { uval: 0UL } },
+  { F("List all params"),                nullptr, ValueType::LIST,  nullptr,          nullptr, nullptr, { uval: 0UL } },
+  { F("Exit"),                           nullptr, ValueType::EXIT,  nullptr,          nullptr, nullptr, { uval: 0UL } },
+  { nullptr,                             nullptr, ValueType::END,   nullptr,          nullptr, nullptr,         0UL   }
 };
 
 static CRC32 crc;
 
+static const char DASHES[] = "----------------------------------------";
+
 void 
 Config::setup()
 {
@@ -402,15 +332,16 @@ Config::setup()
 
   if (!load_config_from_eeprom()) {
 
-    DEBUG(F("reset_config_to_defaults()..."));
-    reset_config_to_defaults(main_menu, 0);
     DEBUG(F("save_config_to_eeprom()..."));
-    save_config_to_eeprom();
+    action = Action::NONE;
+    start_save();
+    while (state == State::SAVE) save_next_bytes();
   }
 
   DEBUG(F("copy_config_to_running()..."));
 
   copy_config_to_running(main_menu, 0);
+  flight_params.publish();
 
   bool found = false;
 
@@ -428,41 +359,354 @@ Config::setup()
   }
 
   Serial.flush();
-  if (found) show_main_menu();
+
+  // Same state machine as in the main loop, run here until the menu is exited
+
+  if (found) {
+    prev_char = CR;
+    open_main_menu();
+    while (state != State::IDLE) {
+      run();
+      console.drain();
+    }
+    console.flush_all();
+  }
+
+  running = true;
+}
+
+void
+Config::run()
+{
+  switch (state) {
+    case State::IDLE:   read_command();                    break;
+    case State::MENU:   display_menu_line();               break;
+    case State::SELECT: display_select_line();             break;
+    case State::CHOICE: if (read_line()) choose();         break;
+    case State::VALUE:  if (read_line()) set_value();      break;
+    case State::PIN:
+    case State::FREQ:   if (read_line()) run_test();       break;
+    case State::ASK:    if (read_answer()) answered((answer == 'Y') || (answer == 'y') ||
+                                                       ((answer == 0) && default_answer)); break;
+    case State::LIST:   list_next_param();                 break;
+    case State::SAVE:   save_next_bytes();                 break;
+  }
+}
+
+void
+Config::open_main_menu()
+{
+  menus[0]    = main_menu;
+  captions[0] = F("Main Menu");
+  level       = 0;
+  show_menu();
+}
+
+void
+Config::close_menu()
+{
+  console.println(F("Menu closed, press Enter to open it again."));
+  command_length = 0;
+  state          = State::IDLE;
+}
+
+// Parameter of a record entry ID, nullptr if unknown
+
+static const Param *
+param_of_id(uint32_t id)
+{
+  for (uint32_t slot = id & (ParamIndex::SIZE - 1);
+       param_index.slots[slot] != 0;
+       slot = (slot + 1) & (ParamIndex::SIZE - 1)) {
+    const Param * param = &PARAMS[param_index.slots[slot] - 1];
+    if (param->hash == id) return param;
+  }
+
+  for (const ParamRename * rename = PARAM_RENAMES; rename->param != ParamId::COUNT; rename++) {
+    if (rename->id == id) return &PARAMS[(int) rename->param];
+  }
+
+  return nullptr;
+}
+
+static bool
+record_valid(const byte * record)
+{
+  RecordHeader header;
+  uint32_t     crc_sum;
+
+  memcpy(&header, record, sizeof(RecordHeader));
+
+  if (VERSION != header.version) return false;
+  if ((ENTRIES_START + header.size + sizeof(uint32_t)) > RECORD_SIZE) return false;
+
+  memcpy(&crc_sum, record + ENTRIES_START + header.size, sizeof(uint32_t));
+
+  crc.reset();
+  return crc_sum == crc.calculate<byte>((byte *) record, ENTRIES_START + header.size);
+}
+
+static uint32_t
+record_sequence(const byte * record)
+{
+  RecordHeader header;
+
+  memcpy(&header, record, sizeof(RecordHeader));
+  return header.sequence;
+}
+
+// Stores an entry value in config_data, converted to the parameter type. False if skipped:
+// unknown ID, unknown type or length, value out of range.
+
+static bool
+load_entry(uint32_t id, uint8_t type, uint8_t length, const byte * value)
+{
+  const Param * param = param_of_id(id);
+
+  if ((param == nullptr) || (length != 4)) return false;
+
+  float         fval;
+  unsigned long uval;
+
+  if (type == (uint8_t) RecordType::FLOAT) {
+    memcpy(&fval, value, sizeof(float));
+    uval = (fval > 0.0f) ? (unsigned long) (fval + 0.5f) : 0;
+  }
+  else if (type == (uint8_t) RecordType::ULONG) {
+    uint32_t val;
+    memcpy(&val, value, sizeof(uint32_t));
+    uval = val;
+    fval = val;
+  }
+  else {
+    return false;
+  }
+
+  if (!((fval >= param->min) && (fval <= param->max))) return false;
+
+  byte * ptr_config = (byte *) &config_data + param->offset;
+
+  if (param->value_type == ValueType::FLOAT) memcpy(ptr_config, &fval, sizeof(float));
+  else                                       memcpy(ptr_config, &uval, sizeof(unsigned long));
+
+  return true;
+}
+
+static void
+build_record(uint32_t sequence)
+{
+  record_image.header.version  = VERSION;
+  record_image.header.size     = sizeof(record_image.entries);
+  record_image.header.sequence = sequence;
+
+  for (int i = 0; i < PARAM_COUNT; i++) {
+    RecordEntry & entry = record_image.entries[i];
+
+    entry.id     = PARAMS[i].hash;
+    entry.type   = (uint8_t) ((PARAMS[i].value_type == ValueType::FLOAT) ? RecordType::FLOAT : RecordType::ULONG);
+    entry.length = sizeof(entry.value);
+    memcpy(entry.value, (byte *) &config_data + PARAMS[i].offset, sizeof(entry.value));
+  }
+
+  crc.reset();
+  record_image.crc = crc.calculate<byte>((byte *) &record_image, ENTRIES_END);
 }
 
+// False if no record of the current format was found: the defaults, or the values of a
+// VERSION 12 record, are then in config_data and must be saved.
+
 bool 
 Config::load_config_from_eeprom()
 {
-  byte * ptr = (byte *) &config_data;
+  bool valid[2];
 
-  for (uint32_t i = 0; i < sizeof(config_data); i++) {
-    *ptr++ = EEPROM.read(i);
+  for (int i = 0; i < 2; i++) {
+    for (uint32_t j = 0; j < RECORD_SIZE; j++) records[i][j] = EEPROM.read(i * RECORD_SIZE + j);
+    valid[i]       = record_valid(records[i]);
+    dirty_first[i] = ENTRIES_START;
+    dirty_last [i] = ENTRIES_END;
   }
 
-  uint32_t crc_sum;
+  reset_config_to_defaults(main_menu, 0);    // Parameters without an entry keep their default value
 
-  crc.reset();
-  crc_sum = crc.calculate<byte>((byte *) &config_data, sizeof(config_data) - sizeof(uint32_t));
+  if (!valid[0] && !valid[1]) {
+    record   = 0;                            // The first save goes to record B, clear of the VERSION 12 records
+    sequence = 0;
+    load_config_v12();
+    return false;
+  }
+
+  // Sequence numbers compared modulo 2^32
+
+  if      (!valid[1]) record = 0;
+  else if (!valid[0]) record = 1;
+  else                record = ((int32_t) (record_sequence(records[1]) - record_sequence(records[0])) > 0) ? 1 : 0;
+
+  sequence = record_sequence(records[record]);
+
+  RecordHeader header;
+  int          loaded  = 0;
+  int          skipped = 0;
+
+  memcpy(&header, records[record], sizeof(RecordHeader));
+
+  for (uint32_t pos = ENTRIES_START, end = ENTRIES_START + header.size; (pos + ENTRY_HEADER) <= end; ) {
+    RecordEntry entry;
+
+    memcpy(&entry, &records[record][pos], ENTRY_HEADER);
+    if ((pos + ENTRY_HEADER + entry.length) > end) break;
+
+    if (load_entry(entry.id, entry.type, entry.length, &records[record][pos + ENTRY_HEADER])) loaded++;
+    else skipped++;
+
+    pos += ENTRY_HEADER + entry.length;
+  }
+
+  if ((loaded != PARAM_COUNT) || (skipped != 0)) {
+    console.printf(F("EEPROM configuration: %d parameters loaded, %d entries skipped, %d parameters set to default.\n"),
+                   loaded, skipped, PARAM_COUNT - loaded);
+  }
 
-  if (crc_sum != config_data.crc    ) return false;
-  if (VERSION != config_data.version) return false;
+  // Written with the same parameter list: only its header and CRC will differ at the next save
+
+  build_record(sequence);
+  if (memcmp(&record_image, records[record], ENTRIES_END) == 0) {
+    dirty_first[record] = ENTRIES_END;
+    dirty_last [record] = ENTRIES_START;
+  }
 
   return true;
 }
 
+// Converts a VERSION 12 fixed layout record (see config_v12.h), false if none. The released
+// firmware saved it at address 0; record B, right after it, is read when A is not valid.
+
+#define V12_FIELD(name, type) { param_hash(#name), RecordType::type },
+
+bool
+Config::load_config_v12()
+{
+  static constexpr struct { uint32_t id; RecordType type; } FIELDS[] = { CONFIG_V12_FIELDS(V12_FIELD) };
+
+  const uint32_t COUNT = sizeof(FIELDS) / sizeof(FIELDS[0]);
+  const uint32_t SIZE  = (COUNT + 2) * 4;    // Fields, version and CRC
+
+  static_assert(SIZE == 248,               "The VERSION 12 record is 248 bytes long");
+  static_assert(2 * SIZE <= RECORD_SIZE,   "Version 12 records must be in records[0]");
+
+  for (int i = 0; i < 2; i++) {
+    const byte * data = &records[0][i * SIZE];
+    uint32_t     trailer[2];                 // Version, CRC
+
+    memcpy(trailer, data + COUNT * 4, sizeof(trailer));
+
+    crc.reset();
+    if ((trailer[0] != 12) || (trailer[1] != crc.calculate<byte>((byte *) data, SIZE - 4))) continue;
+
+    int loaded = 0;
+
+    for (uint32_t j = 0; j < COUNT; j++) {
+      if (load_entry(FIELDS[j].id, (uint8_t) FIELDS[j].type, 4, &data[j * 4])) loaded++;
+    }
+
+    console.printf(F("EEPROM configuration of version 12 converted: %d parameters loaded.\n"), loaded);
+
+    return true;
+  }
+
+  return false;
+}
+
+// Record bytes [first, last) have changed, in both records
+
+void
+Config::mark_dirty(uint32_t first, uint32_t last)
+{
+  for (int i = 0; i < 2; i++) {
+    if (first < dirty_first[i]) dirty_first[i] = first;
+    if (last  > dirty_last [i]) dirty_last [i] = last;
+  }
+}
+
+// A flash sector erase can stall the loop for tens of ms: no save while armed
+
+bool
+Config::save_refused()
+{
+  if ((armed_check == nullptr) || !armed_check()) return false;
+
+  console.println(F("EEPROM save refused while armed, disarm first."));
+  return true;
+}
+
 void 
-Config::save_config_to_eeprom()
+Config::start_save()
 {
-  config_data.version = VERSION;
-  crc.reset();
-  config_data.crc = crc.calculate<byte>((byte *) &config_data, sizeof(config_data) - sizeof(uint32_t));
+  build_record(sequence + 1);
+
+  save_record   = record ^ 1;
+  save_phase    = 0;
+  save_pos      = dirty_first[save_record];
+  save_end      = dirty_last [save_record];
+  save_written  = 0;
+  save_max_us   = 0;
+  save_start_us = micros();
+  state         = State::SAVE;
+}
+
+// config_data cannot change while saving: no input is read in the SAVE state. Only the bytes
+// that differ from the record content are written: the dirty entries of the record, then the
+// header, then the CRC.
+
+void
+Config::save_next_bytes()
+{
+  byte     * ptr     = (byte *) &record_image;
+  byte     * content = records[save_record];
+  uint32_t   base    = save_record * RECORD_SIZE;
+  uint32_t   start   = micros();
+
+  for (int scanned = 0, written = 0;
+       (scanned < SAVE_SCAN_PER_RUN) && (written < SAVE_BYTES_PER_RUN) && (save_phase < 3); ) {
+    if (save_pos >= save_end) {
+      save_phase++;
+      save_pos = (save_phase == 1) ? 0             : ENTRIES_END;
+      save_end = (save_phase == 1) ? ENTRIES_START : sizeof(Record);
+      continue;
+    }
+    if (content[save_pos] != ptr[save_pos]) {
+      EEPROM.write(base + save_pos, ptr[save_pos]);
+      content[save_pos] = ptr[save_pos];
+      written++;
+      save_written++;
+    }
+    save_pos++;
+    scanned++;
+  }
+
+  uint32_t duration = micros() - start;
+  if (duration > save_max_us) save_max_us = duration;
 
-  byte * ptr = (byte *) &config_data;
+  if (save_phase < 3) return;
 
-  for (uint32_t i = 0; i < sizeof(config_data); i++) {
-    EEPROM.write(i, *ptr++);
+  record                   = save_record;
+  sequence                 = record_image.header.sequence;
+  dirty_first[save_record] = ENTRIES_END;
+  dirty_last [save_record] = ENTRIES_START;
+  some_parameter_changed   = false;
+
+  if (action == Action::NONE) {
+    state = State::IDLE;
+    return;
   }
+
+  console.printf(F("Configuration has been saved to EEPROM, record %c, sequence %lu.\n"),
+                 'A' + record, sequence);
+  console.printf(F("%lu bytes written in %lu ms, %lu us at most per loop iteration.\n"),
+                 save_written, (micros() - save_start_us) / 1000, save_max_us);
+
+  if (action == Action::EXIT) close_menu();
+  else show_menu();
 }
 
 void 
@@ -487,50 +731,6 @@ Config::copy_config_to_running(MenuEntry * menu, int level)
   } 
 }
 
-void 
-Config::list_params(MenuEntry * menu, const __FlashStringHelper * caption, int level)
-{
-  bool first = true;
-  while (menu->value_type != ValueType::END) {
-    if (menu->value_type == ValueType::FLOAT) {
-      if (first) {
-        first = false;
-        Serial.printf(F("\n// %s\n\n"), caption);
-      }
-      Serial.printf(F("%-15s = %10.5f  // %s\n"), 
-                    menu->name, 
-                    *(float *) menu->ptr_running, 
-                    menu->caption);
-    }
-    else if (menu->value_type == ValueType::ULONG) {
-      if (first) {
-        first = false;
-        Serial.printf(F("\n// %s\n\n"), caption);
-      }
-      Serial.printf(F("%-15s = %10lu  // %s\n"), 
-                    menu->name, 
-                    *(unsigned long *) menu->ptr_running, 
-                    menu->caption);
-    }
-    else if (menu->value_type == ValueType::SELECT) {
-      if (first) {
-        first = false;
-        Serial.printf(F("\n// %s\n\n"), caption);
-      }
-      Serial.printf(F("%-15s = %10lu  // %s -> %s\n"), 
-                    menu->name, 
-                    *(unsigned long *) menu->ptr_running, 
-                    menu->caption, 
-                    menu->select_entries[*(unsigned long *) menu->ptr_running].caption);
-    }
-    else if (menu->value_type == ValueType::MENU) {
-      list_params((MenuEntry *) menu->ptr_running, menu->caption, level + 1);
-    }
-
-    menu++;
-  } 
-}
-
 void 
 Config::reset_config_to_defaults(MenuEntry * menu, int level)
 {
@@ -555,298 +755,543 @@ Config::reset_config_to_defaults(MenuEntry * menu, int level)
   } 
 }
 
-bool
-Config::ask(const __FlashStringHelper * question, bool default_value)
+// ---- Input ----
+
+// Next received character, -1 if none. The LF of a CR LF pair is skipped.
+
+int
+Config::read_char()
 {
-  int pos = 0;
-  char ans;
-  char ch;
+  int ch = Serial.read();
 
-  Serial.printf(F("%s (%c/%c): "), question, default_value ? 'Y' : 'y', default_value ? 'n' : 'N');
+  if ((ch == LF) && (prev_char == CR)) {
+    prev_char = LF;
+    ch        = Serial.read();
+  }
+  if (ch != -1) prev_char = ch;
 
-  while (Serial.read() != -1) ;
+  return ch;
+}
 
-  bool done = false;
-  while (!done) {
-    if ((ch = Serial.read()) != -1) {
-      if ((pos == 1) && ((ch == BS) || (ch == DEL))) {
-        pos = 0;
-        Serial.print(BS);
-        Serial.print(' ');
-        Serial.print(BS);
-      }
-      else if ((pos == 0) && ((ch == 'Y') || (ch == 'y') || (ch == 'N') || (ch == 'n'))) {
-        Serial.print(ch);
-        ans = ch;
-        pos = 1;
+void
+Config::read_command()
+{
+  for (int i = 0; i < MAX_INPUT_BYTES; i++) {
+    int ch = read_char();
+    if (ch == -1) return;
+
+    if ((ch == CR) || (ch == LF)) {
+      if (command_length == 0) {
+        open_main_menu();
+        return;
       }
-      else if ((ch == '\r') || (ch == '\n') || (ch == ESC)) {
-        done = true;
+      command[command_length] = 0;
+      command_length = 0;
+      if ((command[0] == 'p') && ((command[1] == ' ') || (command[1] == 0))) param_command(&command[1]);
+      else if (command_handler) command_handler(command);
+      return;
+    }
+    else if (command_length < (int) sizeof(command) - 1) {
+      command[command_length++] = ch;
+    }
+  }
+}
+
+void
+Config::start_input(ValueType type)
+{
+  input_pos  = 0;
+  input_dot  = false;
+  input_type = type;
+}
+
+// True when the line is complete (CR, LF, ESC or buffer full), in input[]
+
+bool 
+Config::read_line()
+{
+  for (int i = 0; i < MAX_INPUT_BYTES; i++) {
+
+    int ch = read_char();
+    if (ch == -1) return false;
+
+    bool done = false;
+
+    if ((ch == CR) || (ch == LF) || (ch == ESC)) {
+      done = true;
+    }
+    else if ((input_type == ValueType::FLOAT) && (ch == '-') && (input_pos == 0)) {
+      input[input_pos++] = '-';
+      console.print('-');
+    }
+    else if ((input_type == ValueType::FLOAT) && (ch == '.') && !input_dot) {
+      input_dot = true;
+      input[input_pos++] = '.';
+      console.print('.');
+    }
+    else if ((ch >= '0') && (ch <= '9')) {
+      input[input_pos++] = ch;
+      console.print((char) ch);
+    }
+    else if ((ch == BS) || (ch == DEL)) {
+      if (input_pos > 0) {
+        if (input[input_pos - 1] == '.') input_dot = false;
+        console.print(BS);
+        console.print(' ');
+        console.print(BS);
+        input_pos--;
       }
     }
+
+    if (done || (input_pos >= (int) sizeof(input) - 1)) {
+      console.println();
+      input[input_pos] = 0;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+void
+Config::ask(const __FlashStringHelper * question, bool default_value, Action act)
+{
+  console.printf(F("%s (%c/%c): "), question, default_value ? 'Y' : 'y', default_value ? 'n' : 'N');
+
+  answer         = 0;
+  default_answer = default_value;
+  action         = act;
+  state          = State::ASK;
+}
+
+// True when the answer is complete, in answer (0: none given)
+
+bool
+Config::read_answer()
+{
+  for (int i = 0; i < MAX_INPUT_BYTES; i++) {
+    int ch = read_char();
+    if (ch == -1) return false;
+
+    if ((answer != 0) && ((ch == BS) || (ch == DEL))) {
+      answer = 0;
+      console.print(BS);
+      console.print(' ');
+      console.print(BS);
+    }
+    else if ((answer == 0) && ((ch == 'Y') || (ch == 'y') || (ch == 'N') || (ch == 'n'))) {
+      console.print((char) ch);
+      answer = ch;
+    }
+    else if ((ch == CR) || (ch == LF) || (ch == ESC)) {
+      console.println();
+      return true;
+    }
   }
 
-  Serial.println();
+  return false;
+}
+
+// ---- Menus ----
 
-  if (pos == 0) return default_value;
-  else return ((ans == 'Y') || (ans == 'y'));
+void
+Config::show_menu()
+{
+  line  = -1;
+  state = State::MENU;
 }
 
 void 
-Config::get_str(char * buff, int size, ValueType type)
+Config::display_menu_line() 
 {
-  int  pos  = 0;
-  bool done = false;
-  bool dot  = false;
-  char ch;
+  if (line < 0) {
+    int len = min(strlen_P(captions[level]), sizeof(DASHES) - 1);
+    console.printf(F("\n%s\n%.*s\n"), captions[level], len, DASHES);
+    line = 0;
+    return;
+  }
 
-  size--;
+  MenuEntry * menu = &menus[level][line];
 
-  while (Serial.read() != -1) ;
+  if (menu->value_type == ValueType::END) {
+    max_idx = line;
+    console.print(F("> "));
+    start_input(ValueType::ULONG);
+    state = State::CHOICE;
+    return;
+  }
 
-  while (!done) {
+  line++;
 
-    ch = Serial.read();
+  if (menu->value_type == ValueType::FLOAT) {
+    console.printf(F("%d - (Parm) %s [%s](%.5f)\n"), line, menu->caption, menu->name, *(float *) menu->ptr_running);
+  }
+  else if (menu->value_type == ValueType::ULONG) {
+    console.printf(F("%d - (Parm) %s [%s](%lu)\n"), line, menu->caption, menu->name, *(unsigned long *) menu->ptr_running);
+  }
+  else if (menu->value_type == ValueType::SELECT) {
+    console.printf(F("%d - (Parm) %s [%s](%d: %s)\n"), 
+                   line, 
+                   menu->caption, 
+                   menu->name, 
+                   *(unsigned long *) menu->ptr_running,
+                   menu->select_entries[*(unsigned long *) menu->ptr_running].caption);
+  }
+  else if (menu->value_type == ValueType::MENU) {
+    console.printf(F("%d - (Menu) %s\n"), line, menu->caption);
+  }
+  else if (menu->value_type != ValueType::EXIT) {
+    console.printf(F("%d - (Task) %s\n"), line, menu->caption);
+  }
+  else {
+    console.printf(F("%d - %s\n"), line, menu->caption);
+  }
+}
 
-    if (ch != -1) {
-      //Serial.printf(F("[%d]"), ch);
-      if ((ch == CR) || (ch == LF) || (ch == ESC)) {
-        done = true;
-      }
-      else if ((type == ValueType::FLOAT) && (ch == '-') && (pos == 0)) {
-        buff[pos++] = '-';
-        Serial.print('-');
-      }
-      else if ((type == ValueType::FLOAT) && (ch == '.') && !dot) {
-        dot = true;
-        buff[pos++] = '.';
-        Serial.print('.');
+void 
+Config::display_select_line()
+{
+  if (line < 0) {
+    console.printf(F("\n%s\nPlease select one of the following:\n\n"), entry->caption);
+    line = 0;
+    return;
+  }
+
+  SelectEntry * select = &entry->select_entries[line];
+
+  if (select->caption != nullptr) {
+    console.printf(F("%3d - %s\n"), line, select->caption);
+    line++;
+    return;
+  }
+
+  max_idx = line;
+  console.printf(F("---\n%s [%s](%lu: %s): "), 
+                 entry->caption, 
+                 entry->name,
+                 *(unsigned long *) entry->ptr_running, 
+                 entry->select_entries[*(unsigned long *) entry->ptr_running].caption);
+  start_input(ValueType::ULONG);
+  state = State::VALUE;
+}
+
+void
+Config::choose()
+{
+  unsigned long idx = atol(input);
+
+  if ((input[0] == 0) || (idx == 0) || (idx > max_idx)) {
+    if (level > 0) level--;
+    show_menu();
+    return;
+  }
+
+  entry = &menus[level][idx - 1];
+
+  switch (entry->value_type) {
+    case ValueType::EXIT:
+      if (some_parameter_changed) ask(F("Some parameter changed. Save to EEPROM?"), false, Action::EXIT);
+      else close_menu();
+      break;
+
+    case ValueType::MENU:
+      if (level < (MAX_LEVELS - 1)) {
+        level++;
+        menus[level]    = (MenuEntry *) entry->ptr_running;
+        captions[level] = entry->caption;
       }
-      else if ((ch >= '0') && (ch <= '9')) {
-        buff[pos++] = ch;
-        Serial.print(ch);
+      show_menu();
+      break;
+
+    case ValueType::RESET:
+      ask(F("Resetting configuration to default values. Are you sure?"), false, Action::RESET);
+      break;
+
+    case ValueType::SAVE:
+      ask(F("Saving configuration to EEPROM. Are you sure?"), false, Action::SAVE);
+      break;
+
+    case ValueType::LIST:
+      start_list();
+      break;
+
+    case ValueType::SERVO:
+    case ValueType::MOTOR:
+    case ValueType::CALIB:
+      if (running) {
+        console.println(F("Only available from the boot menu, the flight loop is running."));
+        show_menu();
       }
-      else if ((ch == BS) || (ch == DEL)) {
-        if (pos > 0) {
-          Serial.print(BS);
-          Serial.print(' ');
-          Serial.print(BS);
-          pos--;
-        }
+      else {
+        if      (entry->value_type == ValueType::SERVO) console.print(F("Servo pin number: "));
+        else if (entry->value_type == ValueType::MOTOR) console.print(F("Motor pin number: "));
+        else                                            console.print(F("Motor Calibration pin number: "));
+        start_input(ValueType::ULONG);
+        state = State::PIN;
       }
-    }
+      break;
+
+    case ValueType::PROFILE:
+      profiler.show();
+      profiler.reset();
+      scheduler.reset_stats();
+      console.println(F("Loop profile and scheduler task statistics have been reset."));
+      show_menu();
+      break;
+
+    case ValueType::FLOAT:
+      console.printf(F("%s [%s](%.5f): "), entry->caption, entry->name, *(float *) entry->ptr_running);
+      start_input(ValueType::FLOAT);
+      state = State::VALUE;
+      break;
+
+    case ValueType::ULONG:
+      console.printf(F("%s [%s](%lu): "), entry->caption, entry->name, *(unsigned long *) entry->ptr_running);
+      start_input(ValueType::ULONG);
+      state = State::VALUE;
+      break;
+
+    case ValueType::SELECT:
+      line  = -1;
+      state = State::SELECT;
+      break;
+
+    default:
+      show_menu();
+      break;
+  }
+}
 
-    done = done || (pos >= size);
+void
+Config::set_value()
+{
+  if (input[0] != 0) {
+    if (entry->param) {
+      set_param(entry->param, input);
+    }
+    else {
+      unsigned long val = atol(input);
+      if (val < max_idx) *(unsigned long *) entry->ptr_running = val;   // Debug choices, not saved
+    }
   }
 
-  Serial.println();
-  buff[pos] = 0;
+  show_menu();
 }
 
-bool 
-Config::get_ulong(unsigned long & val)
+// ---- Registry parameters ----
+
+const Param *
+Config::find_param(const char * name)
 {
-  char buff[20];
+  uint32_t hash = param_hash(name);
 
-  get_str(buff, 30, ValueType::ULONG);
-  if (buff[0] == 0) return false;
-  val = atol(buff);
+  for (uint32_t slot = hash & (ParamIndex::SIZE - 1);
+       param_index.slots[slot] != 0;
+       slot = (slot + 1) & (ParamIndex::SIZE - 1)) {
+    const Param * param = &PARAMS[param_index.slots[slot] - 1];
+    if ((param->hash == hash) && (strcmp(param->name, name) == 0)) return param;
+  }
 
-  return true;
+  return nullptr;
 }
 
-bool 
-Config::get_float(float & val)
+// Changes the running value and the value to be saved, false if out of range
+
+bool
+Config::set_param(const Param * param, const char * value)
 {
-  char buff[20];
+  float val = atof(value);
+
+  if ((val < param->min) || (val > param->max)) {
+    console.printf(F("%s: out of range [%g, %g], not changed.\n"), param->name, param->min, param->max);
+    return false;
+  }
+
+  byte * ptr_config = (byte *) &config_data + param->offset;
 
-  get_str(buff, 30, ValueType::FLOAT);
-  if (buff[0] == 0) return false;
-  val = atof(buff);
+  if (param->value_type == ValueType::FLOAT) {
+    *(float *) param->ptr_running = val;
+    memcpy(ptr_config, &val, sizeof(float));
+  }
+  else {
+    unsigned long uval = strtoul(value, nullptr, 10);
+    *(unsigned long *) param->ptr_running = uval;
+    memcpy(ptr_config, &uval, sizeof(unsigned long));
+  }
+
+  uint32_t entry = ENTRIES_START + (param - PARAMS) * sizeof(RecordEntry);
+  mark_dirty(entry, entry + sizeof(RecordEntry));
+
+  some_parameter_changed = true;
+  flight_params.publish(); // Used by the control loop from its next iteration
 
   return true;
 }
 
-uint32_t 
-Config::show_select_entries(SelectEntry * select_entries, const __FlashStringHelper * caption)
+// USB command "p <name>" shows a parameter, "p <name> <value>" changes it (not saved in EEPROM)
+
+void
+Config::param_command(char * args)
 {
-  uint32_t max_idx = 0;
-  
-  Serial.printf(F("\n%s\nPlease select one of the following:\n\n"), caption);
+  char * name  = strtok(args,    " ");
+  char * value = strtok(nullptr, " ");
 
-  while (select_entries->caption != nullptr) {
-    Serial.printf(F("%3d - %s\n"), max_idx, select_entries->caption);
-    select_entries++;
-    max_idx++;
+  if (name == nullptr) {
+    console.println(F("Usage: p <name> [<value>]"));
+    return;
   }
-  Serial.println(F("---"));
 
-  return max_idx;
-}
+  const Param * param = find_param(name);
 
-uint32_t 
-Config::display_menu(MenuEntry * menu, const __FlashStringHelper * caption) 
-{
-  int  len  = strlen_P(caption);
-
-  Serial.println();
-  Serial.println(caption);
+  if (param == nullptr) {
+    console.printf(F("Unknown parameter: %s\n"), name);
+    return;
+  }
 
-  for (int i = 0; i < len; i++) Serial.print('-');
-  Serial.println();
+  if ((value != nullptr) && !set_param(param, value)) return;
 
-  uint32_t max_idx = 0;
+  if (param->value_type == ValueType::FLOAT) {
+    console.printf(F("%s = %.5f\n"), param->name, *(float *) param->ptr_running);
+  }
+  else {
+    console.printf(F("%s = %lu\n"), param->name, *(unsigned long *) param->ptr_running);
+  }
+}
 
-  while (menu->value_type != ValueType::END) {
+// Blocking tests, setup() only: the console is flushed first, the tests write to Serial
 
-    max_idx++;
+void
+Config::run_test()
+{
+  if (input[0] == 0) {
+    show_menu();
+    return;
+  }
 
-    if (menu->value_type == ValueType::FLOAT) {
-      Serial.printf(F("%d - (Parm) %s [%s](%.5f)\n"), max_idx, menu->caption, menu->name, *(float *) menu->ptr_running);
-    }
-    else if (menu->value_type == ValueType::ULONG) {
-      Serial.printf(F("%d - (Parm) %s [%s](%lu)\n"), max_idx, menu->caption, menu->name, *(unsigned long *) menu->ptr_running);
-    }
-    else if (menu->value_type == ValueType::SELECT) {
-      Serial.printf(F("%d - (Parm) %s [%s](%d: %s)\n"), 
-                    max_idx, 
-                    menu->caption, 
-                    menu->name, 
-                    *(unsigned long *) menu->ptr_running,
-                    menu->select_entries[*(unsigned long *) menu->ptr_running].caption);
-    }
-    else if (menu->value_type == ValueType::MENU) {
-      Serial.printf(F("%d - (Menu) %s\n"), max_idx, menu->caption);
+  if (state == State::PIN) {
+    pin = atol(input);
+    if (entry->value_type == ValueType::MOTOR) {
+      console.print(F("Signal frequency: "));
+      start_input(ValueType::ULONG);
+      state = State::FREQ;
+      return;
     }
-    else if (menu->value_type != ValueType::EXIT) {
-      Serial.printf(F("%d - (Task) %s\n"), max_idx, menu->caption);
-    }
-    else {
-      Serial.printf(F("%d - %s\n"), max_idx, menu->caption);
-    }
-
-    menu++;
   }
 
-  return max_idx;
+  console.flush_all();
+
+  if      (entry->value_type == ValueType::SERVO) tests.servo(pin);
+  else if (entry->value_type == ValueType::MOTOR) tests.motor(pin, atol(input));
+  else                                            tests.motor_calibration(pin);
+
+  show_menu();
 }
 
-void 
-Config::show_menu(MenuEntry * menu, const __FlashStringHelper * caption, int level) 
-{
-  bool done = false;
-
-  while (!done) {
-    uint32_t max_idx = display_menu(menu, caption);
-
-    Serial.print(F("> "));
-
-    unsigned long idx;
-    if (get_ulong(idx) && ((idx > 0) && (idx <= max_idx))) {
-      if (menu[idx - 1].value_type == ValueType::EXIT) {
-        done = true;
-        if (some_parameter_changed) {
-          if (ask(F("Some parameter changed. Save to EEPROM?"), false)) {
-            save_config_to_eeprom();
-            some_parameter_changed = false;
-            Serial.println(F("Configuration has been saved to EEPROM."));
-          }
-          else {
-            Serial.println(F("Configuration has NOT been saved."));
-          }
-        }
-      }
-      else if (menu[idx - 1].value_type == ValueType::MENU) {
-        show_menu((MenuEntry *) menu[idx - 1].ptr_running, menu[idx - 1].caption, level + 1);
-      }
-      else if (menu[idx - 1].value_type == ValueType::RESET) {
-        if (ask(F("Resetting configuration to default values. Are you sure?"), false)) {
-          reset_config_to_defaults(main_menu, 0);
-          Serial.println(F("Configuration reset to default values."));
-          some_parameter_changed = true;
-        }
-        else Serial.println(F("Reset not done."));
-      }
-      else if (menu[idx - 1].value_type == ValueType::SAVE) {
-        if (ask(F("Saving configuration to EEPROM. Are you sure?"), false)) {
-          save_config_to_eeprom();
-          Serial.println(F("Configuration saved to EEPROM."));
-          some_parameter_changed = false;
-        }
-        else Serial.println(F("Configuration not saved."));
-      }
-      else if (menu[idx - 1].value_type == ValueType::LIST) {
-        list_params(main_menu, F("Main Menu"), 0);
-      }
-      else if (menu[idx - 1].value_type == ValueType::SERVO) {
-        unsigned long pin;
-        Serial.print(F("Servo pin number: "));
-        if (get_ulong(pin)) {
-          tests.servo(pin);
-        }
-      }
-      else if (menu[idx - 1].value_type == ValueType::MOTOR) {
-        unsigned long pin, freq;
-        Serial.print(F("Motor pin number: "));
-        if (get_ulong(pin)) {
-          Serial.print(F("Signal frequency: "));
-          if (get_ulong(freq)) {
-            tests.motor(pin, freq);
-          }
-        }
-      }
-      else if (menu[idx - 1].value_type == ValueType::CALIB) {
-        unsigned long pin;
-        Serial.print(F("Motor Calibration pin number: "));
-        if (get_ulong(pin)) {
-          tests.motor_calibration(pin);
-        }
-      }
-      else if (menu[idx - 1].value_type == ValueType::FLOAT) {
-        float val;
-        Serial.printf(F("%s [%s](%.5f): "), menu[idx - 1].caption, menu[idx - 1].name, *(float *) menu[idx - 1].ptr_running);
-        if (get_float(val)) {
-          *(float *) menu[idx - 1].ptr_running = val;
-          if (menu[idx - 1].ptr_config) {
-            *(float *) menu[idx - 1].ptr_config  = val;
-            some_parameter_changed = true;
-          }
-        }
+void
+Config::answered(bool yes)
+{
+  switch (action) {
+    case Action::EXIT:
+      if (yes && !save_refused()) start_save();
+      else {
+        console.println(F("Configuration has NOT been saved."));
+        close_menu();
       }
-      else if (menu[idx - 1].value_type == ValueType::ULONG) {
-        unsigned long val;
-        Serial.printf(F("%s [%s](%lu): "), menu[idx - 1].caption, menu[idx - 1].name, *(unsigned long *) menu[idx - 1].ptr_running);
-        if (get_ulong(val)) {
-          *(unsigned long *) menu[idx - 1].ptr_running = val;
-          if (menu[idx - 1].ptr_config) {
-            *(unsigned long *) menu[idx - 1].ptr_config  = val;
-            some_parameter_changed = true;
-          }
-        }
+      break;
+
+    case Action::SAVE:
+      if (yes && !save_refused()) start_save();
+      else {
+        console.println(F("Configuration not saved."));
+        show_menu();
       }
-      else if (menu[idx - 1].value_type == ValueType::SELECT) {
-        unsigned long val;
-        max_idx = show_select_entries(menu[idx - 1].select_entries, menu[idx - 1].caption);
-        Serial.printf(F("%s [%s](%lu: %s): "), 
-                      menu[idx - 1].caption, 
-                      menu[idx - 1].name,
-                      *(unsigned long *) menu[idx - 1].ptr_running, 
-                      menu[idx - 1].select_entries[*(unsigned long *) menu[idx - 1].ptr_running].caption);
-        if (get_ulong(val) && (val < max_idx)) {
-          *(unsigned long *) menu[idx - 1].ptr_running = val;
-          if (menu[idx - 1].ptr_config) {
-            *(unsigned long *) menu[idx - 1].ptr_config  = val;
-            some_parameter_changed = true;
-          }
-        }
+      break;
+
+    case Action::RESET:
+      if (yes) {
+        reset_config_to_defaults(main_menu, 0);
+        mark_dirty(ENTRIES_START, ENTRIES_END);
+        flight_params.publish();
+        console.println(F("Configuration reset to default values."));
+        some_parameter_changed = true;
       }
-    }
-    else if (level > 0) done = true;
+      else console.println(F("Reset not done."));
+      show_menu();
+      break;
+
+    default:
+      show_menu();
+      break;
   }
 }
 
 void 
-Config::show_main_menu() 
+Config::start_list()
 {
-  show_menu(main_menu, F("Main Menu"), 0);
+  list_menus[0]    = main_menu;
+  list_captions[0] = F("Main Menu");
+  list_first[0]    = true;
+  list_level       = 0;
+  state            = State::LIST;
+}
+
+// One parameter line per call, the menu tree walked with an explicit stack
+
+void 
+Config::list_next_param()
+{
+  while (true) {
+    MenuEntry * menu = list_menus[list_level];
+
+    if (menu->value_type == ValueType::END) {
+      if (list_level == 0) {
+        show_menu();
+        return;
+      }
+      list_level--;
+      continue;
+    }
+
+    list_menus[list_level]++;
+
+    if (menu->value_type == ValueType::MENU) {
+      if (list_level < (MAX_LEVELS - 1)) {
+        list_level++;
+        list_menus[list_level]    = (MenuEntry *) menu->ptr_running;
+        list_captions[list_level] = menu->caption;
+        list_first[list_level]    = true;
+      }
+      continue;
+    }
+
+    if ((menu->value_type != ValueType::FLOAT) &&
+        (menu->value_type != ValueType::ULONG) &&
+        (menu->value_type != ValueType::SELECT)) continue;
+
+    if (list_first[list_level]) {
+      list_first[list_level] = false;
+      console.printf(F("\n// %s\n\n"), list_captions[list_level]);
+    }
+
+    if (menu->value_type == ValueType::FLOAT) {
+      console.printf(F("%-15s = %10.5f  // %s\n"), 
+                     menu->name, 
+                     *(float *) menu->ptr_running, 
+                     menu->caption);
+    }
+    else if (menu->value_type == ValueType::ULONG) {
+      console.printf(F("%-15s = %10lu  // %s\n"), 
+                     menu->name, 
+                     *(unsigned long *) menu->ptr_running, 
+                     menu->caption);
+    }
+    else {
+      console.printf(F("%-15s = %10lu  // %s -> %s\n"), 
+                     menu->name, 
+                     *(unsigned long *) menu->ptr_running, 
+                     menu->caption, 
+                     menu->select_entries[*(unsigned long *) menu->ptr_running].caption);
+    }
+    return;
+  }
 }
@@ -8,18 +8,7 @@
 
 #include <cinttypes>
 
-#define RIGHT_ELEVATOR_CENTER  0.48
-#define LEFT_ELEVATOR_CENTER   0.46
-
-#define RIGHT_AILERON_CENTER   0.56
-#define RIGHT_AILERON_BOTTOM   0.95
-#define RIGHT_AILERON_45       0.87
-
-#define LEFT_AILERON_CENTER    0.55
-#define LEFT_AILERON_BOTTOM    0.05
-#define LEFT_AILERON_45        0.22
-
-#define FRONT_MOTOR_CENTER     0.57
+#include "params.h"
 
 #if DEBUGGING
   #define DEBUG(str) Serial.println(str); Serial.flush()
@@ -30,13 +19,27 @@
 #endif
 
 enum class ValueType : int8_t { 
-  END, ULONG, FLOAT, SELECT, MENU, RESET, SAVE, LIST, SERVO, MOTOR, CALIB, EXIT
+  END, ULONG, FLOAT, SELECT, MENU, RESET, SAVE, LIST, SERVO, MOTOR, CALIB, PROFILE, EXIT
 };  
 
 struct SelectEntry {
   const __FlashStringHelper * caption;
 };
 
+// A parameter of the registry (params.h). ULONG defaults and limits are exact up to 2^24.
+
+struct Param {
+  const char * name;
+  const char * caption;
+  ValueType    value_type;     // FLOAT or ULONG
+  uint16_t     offset;         // In ConfigData
+  void       * ptr_running;
+  float        default_value;
+  float        min;
+  float        max;
+  uint32_t     hash;           // param_hash(name)
+};
+
 struct MenuEntry {
   const __FlashStringHelper * caption;
   const __FlashStringHelper * name;
@@ -48,32 +51,135 @@ struct MenuEntry {
     unsigned long uval;
     float         fval;
   } value;
+  const Param               * param;      // Registry entry of a saved parameter, else nullptr
 };
 
+// The command line interface is a state machine advanced by run(), called once per loop
+// iteration: at most MAX_INPUT_BYTES received bytes are consumed per call and the menus are
+// displayed one line per call, through the console ring. The parameters can then be changed
+// while the flight loop runs. When no menu is open, the USB input lines are handed to the
+// command handler (telemetry commands), an empty line opens the main menu.
+//
+// The servo and motor tests are blocking: they are only available from setup(). EEPROM saves are
+// refused while armed (see SAVE_BYTES_PER_RUN).
+
 class Config
 {
-  private:
-    bool some_parameter_changed;
-
-    uint32_t  show_select_entries(SelectEntry * select_entries, const __FlashStringHelper * caption);
-    uint32_t         display_menu(MenuEntry   * menu,           const __FlashStringHelper * caption);
-    void                show_menu(MenuEntry   * menu,           const __FlashStringHelper * caption, int level);
-    void                  get_str(char * buff, int size, ValueType type);
-    bool                get_ulong(unsigned long & val);
-    bool                get_float(float & val);
-    bool                      ask(const __FlashStringHelper * question, bool default_value);
-    bool  load_config_from_eeprom();
-    void    save_config_to_eeprom();
-    void reset_config_to_defaults(MenuEntry * menu, int level);
-    void   copy_config_to_running(MenuEntry * menu, int level);
-    void              list_params(MenuEntry * menu, const __FlashStringHelper * caption, int level);
-
   public:
-    Config() : some_parameter_changed(false) { }
+    typedef void (* CommandHandler)(char * cmd);
+    typedef bool (* ArmedCheck)();
+
+    static const int MAX_LEVELS         = 4;
+    static const int MAX_INPUT_BYTES    = 4;   // Received bytes consumed per run()
+    // EEPROM bytes written per run(). On Teensy 4.x the EEPROM is emulated in flash: a write that
+    // fills a sector triggers a sector erase of tens of ms, interrupts disabled. This bounds the
+    // usual case only, which is why saves are refused while armed.
+
+    static const int SAVE_BYTES_PER_RUN = 8;
+    static const int SAVE_SCAN_PER_RUN  = 64;  // Record bytes compared per run()
+
+    Config() : some_parameter_changed(false), running(false), state(State::IDLE), level(0),
+               command_length(0), prev_char(0), command_handler(nullptr), armed_check(nullptr) { }
    ~Config() { }
 
     void setup();
-    void show_main_menu();
+    void run();
+    void open_main_menu();
+
+    void set_command_handler(CommandHandler handler) { command_handler = handler; }
+    void set_armed_check(ArmedCheck check)           { armed_check = check; }
+    inline bool menu_open() { return state != State::IDLE; }
+
+    // Registry parameter of that name, nullptr if none. Hash table lookup, built at compile time.
+
+    static const Param * find_param(const char * name);
+
+  private:
+    enum class State : uint8_t {
+      IDLE,      // Reading USB command lines
+      MENU,      // Displaying the current menu
+      CHOICE,    // Reading the menu entry number
+      SELECT,    // Displaying the choices of a SELECT parameter
+      VALUE,     // Reading a parameter new value
+      PIN,       // Reading a test pin number
+      FREQ,      // Reading a motor test frequency
+      ASK,       // Reading a yes/no answer
+      LIST,      // Listing all parameters
+      SAVE       // Writing the EEPROM
+    };
+
+    enum class Action : uint8_t { NONE, EXIT, SAVE, RESET };   // What follows an answer or a save
+
+    bool                        some_parameter_changed;
+    bool                        running;               // setup() done, the flight loop runs
+    State                       state;
+
+    MenuEntry                 * menus[MAX_LEVELS];
+    const __FlashStringHelper * captions[MAX_LEVELS];
+    int                         level;
+    int                         line;                  // Next line to display, -1: the title
+    uint32_t                    max_idx;
+    MenuEntry                 * entry;                 // Entry being changed
+
+    char                        input[20];
+    int                         input_pos;
+    bool                        input_dot;
+    ValueType                   input_type;
+    char                        answer;
+    bool                        default_answer;
+    Action                      action;
+    unsigned long               pin;
+
+    MenuEntry                 * list_menus[MAX_LEVELS];
+    const __FlashStringHelper * list_captions[MAX_LEVELS];
+    bool                        list_first[MAX_LEVELS];
+    int                         list_level;
+
+    uint8_t                     record;                // EEPROM record (0: A, 1: B) of the last save
+    uint32_t                    sequence;              // Its sequence number
+    uint32_t                    dirty_first[2];        // Per record, entry bytes [first, last) that
+    uint32_t                    dirty_last[2];         // may differ from the record content
+
+    uint8_t                     save_record;
+    uint8_t                     save_phase;            // 0: entries, 1: header, 2: CRC, 3: done
+    uint32_t                    save_pos;
+    uint32_t                    save_end;
+    uint32_t                    save_written;          // Bytes written by the current save
+    uint32_t                    save_start_us;
+    uint32_t                    save_max_us;           // Longest save_next_bytes() call
+
+    char                        command[80];
+    int                         command_length;
+    char                        prev_char;
+    CommandHandler              command_handler;
+    ArmedCheck                  armed_check;           // Saves refused while it returns true
+
+    int                  read_char();
+    void              read_command();
+    bool                 read_line();
+    bool               read_answer();
+    void               start_input(ValueType type);
+    void                       ask(const __FlashStringHelper * question, bool default_value, Action act);
+    void                 show_menu();
+    void        display_menu_line();
+    void      display_select_line();
+    void                    choose();
+    void                 set_value();
+    void                  run_test();
+    void                  answered(bool yes);
+    void             param_command(char * args);
+    bool                 set_param(const Param * param, const char * value);
+    void                start_list();
+    void           list_next_param();
+    bool                save_refused();
+    void                start_save();
+    void           save_next_bytes();
+    void                mark_dirty(uint32_t first, uint32_t last);
+    void                close_menu();
+    bool   load_config_from_eeprom();
+    bool           load_config_v12();
+    void reset_config_to_defaults(MenuEntry * menu, int level);
+    void   copy_config_to_running(MenuEntry * menu, int level);
 };
 
 #if __CONFIG__
@@ -0,0 +1,74 @@
+#pragma once
+
+// EEPROM Record of Version 12 for the dRehmFlight Flight Control Software
+//
+// The released firmware saved the configuration as a fixed layout record at EEPROM address 0:
+// one 4 bytes field per parameter, in the order below, followed by the version (12) and a CRC32
+// of the preceding bytes. Config::setup() converts such a record, once, to the tagged record
+// format. This list must not change.
+//
+//   FIELD(name, type)
+//
+// GPL 3.0
+
+#define CONFIG_V12_FIELDS(FIELD) \
+  FIELD(throttle_fs,                           ULONG) \
+  FIELD(aileron_fs,                            ULONG) \
+  FIELD(elevator_fs,                           ULONG) \
+  FIELD(rudder_fs,                             ULONG) \
+  FIELD(throttle_cut_fs,                       ULONG) \
+  FIELD(aux1_fs,                               ULONG) \
+  FIELD(B_madgwick,                            FLOAT) \
+  FIELD(B_accel,                               FLOAT) \
+  FIELD(B_gyro,                                FLOAT) \
+  FIELD(B_mag,                                 FLOAT) \
+  FIELD(MagErrorX,                             FLOAT) \
+  FIELD(MagErrorY,                             FLOAT) \
+  FIELD(MagErrorZ,                             FLOAT) \
+  FIELD(MagScaleX,                             FLOAT) \
+  FIELD(MagScaleY,                             FLOAT) \
+  FIELD(MagScaleZ,                             FLOAT) \
+  FIELD(i_limit,                               FLOAT) \
+  FIELD(maxRoll,                               FLOAT) \
+  FIELD(maxPitch,                              FLOAT) \
+  FIELD(maxYaw,                                FLOAT) \
+  FIELD(Kp_roll_angle,                         FLOAT) \
+  FIELD(Ki_roll_angle,                         FLOAT) \
+  FIELD(Kd_roll_angle,                         FLOAT) \
+  FIELD(B_loop_roll,                           FLOAT) \
+  FIELD(Kp_pitch_angle,                        FLOAT) \
+  FIELD(Ki_pitch_angle,                        FLOAT) \
+  FIELD(Kd_pitch_angle,                        FLOAT) \
+  FIELD(B_loop_pitch,                          FLOAT) \
+  FIELD(Kp_roll_rate,                          FLOAT) \
+  FIELD(Ki_roll_rate,                          FLOAT) \
+  FIELD(Kd_roll_rate,                          FLOAT) \
+  FIELD(Kp_pitch_rate,                         FLOAT) \
+  FIELD(Ki_pitch_rate,                         FLOAT) \
+  FIELD(Kd_pitch_rate,                         FLOAT) \
+  FIELD(Kp_yaw,                                FLOAT) \
+  FIELD(Ki_yaw,                                FLOAT) \
+  FIELD(Kd_yaw,                                FLOAT) \
+  FIELD(mx_fw_pitch_amount,                    FLOAT) \
+  FIELD(mx_fw_roll_amount,                     FLOAT) \
+  FIELD(mx_fw_front_motor_center_offset,       FLOAT) \
+  FIELD(mx_fw_left_aileron_center_offset,      FLOAT) \
+  FIELD(mx_fw_right_aileron_center_offset,     FLOAT) \
+  FIELD(mx_fw_right_elevator_center_offset,    FLOAT) \
+  FIELD(mx_fw_left_elevator_center_offset,     FLOAT) \
+  FIELD(mx_hover_front_roll_amount,            FLOAT) \
+  FIELD(mx_hover_front_motor_center_offset,    FLOAT) \
+  FIELD(mx_hover_right_elevator_center_offset, FLOAT) \
+  FIELD(mx_hover_left_elevator_center_offset,  FLOAT) \
+  FIELD(mx_hover_left_aileron_bottom_offset,   FLOAT) \
+  FIELD(mx_hover_right_aileron_bottom_offset,  FLOAT) \
+  FIELD(mx_trans_front_roll_amount,            FLOAT) \
+  FIELD(mx_trans_front_motor_center_offset,    FLOAT) \
+  FIELD(mx_trans_left_aileron_45_offset,       FLOAT) \
+  FIELD(mx_trans_right_aileron_45_offset,      FLOAT) \
+  FIELD(mx_trans_right_elevator_center_offset, FLOAT) \
+  FIELD(mx_trans_left_elevator_center_offset,  FLOAT) \
+  FIELD(mx_trans_pitch_rate_low,               FLOAT) \
+  FIELD(mx_trans_pitch_rate_high,              FLOAT) \
+  FIELD(mx_trans_pitch_to_over_duration,       FLOAT) \
+  FIELD(mx_trans_pitch_to_forward_duration,    FLOAT)
@@ -0,0 +1,24 @@
+// Double-Buffered Flight Parameters for the dRehmFlight Flight Control Software
+//
+// GPL 3.0
+
+#include "Arduino.h"
+
+#define __FLIGHT_PARAMS__ 1
+#include "flight_params.h"
+
+const FlightParams &
+FlightParamsBuffer::apply()
+{
+  if (pending) {
+    pending = false;
+
+    FlightParams * next = (active == &buffers[0]) ? &buffers[1] : &buffers[0];
+
+    *next  = edit;
+    active = next;   // The flip: a single pointer store
+    version++;
+  }
+
+  return *active;
+}
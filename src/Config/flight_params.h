@@ -0,0 +1,61 @@
+#pragma once
+
+// Double-Buffered Flight Parameters for the dRehmFlight Flight Control Software
+//
+// The controller gains and mixer values used by the flight control chain are grouped in the
+// FlightParams struct. The Config menus only change the edit copy, then call publish(). At the
+// start of each control iteration, apply() copies the edit copy to the buffer not in use and
+// makes it the active one, with a new version number. The control chain reads the active buffer
+// (get()) for the whole iteration: a gain set is never seen half updated, and there is no lock
+// on the control path, only a pointer read.
+//
+// The values of the edit copy are loaded from the EEPROM (or reset to their defaults) by
+// Config::setup(). The members of FlightParams are the FLIGHT parameters of the registry.
+//
+// GPL 3.0
+
+#include <cinttypes>
+
+#include "params.h"
+
+// The FLIGHT parameters of the registry (params.h), with their default value
+
+#define FLIGHT_PARAM_FLIGHT(type, name, def) PARAM_TYPE_##type name = def;
+#define FLIGHT_PARAM_GLOBAL(type, name, def)
+#define FLIGHT_PARAM(storage, type, name, caption, def, min, max) FLIGHT_PARAM_##storage(type, name, def)
+
+struct FlightParams {
+  ALL_PARAMS(FLIGHT_PARAM)
+};
+
+class FlightParamsBuffer
+{
+  public:
+    FlightParamsBuffer() : active(&buffers[0]), version(0), pending(false) { }
+   ~FlightParamsBuffer() { }
+
+    FlightParams edit;   // Changed by the Config menus only
+
+    // Config side: the edit copy is complete, to be used from the next control iteration
+
+    inline void publish() { pending = true; }
+
+    // Control side: called once at the start of an iteration, returns the set for the iteration
+
+    const FlightParams & apply();
+
+    inline const FlightParams & get()         const { return *active; }
+    inline uint32_t             get_version() const { return version; }
+
+  private:
+    FlightParams             buffers[2];
+    const FlightParams     * active;
+    volatile uint32_t        version;   // Incremented by every apply() of a published edit copy
+    volatile bool            pending;
+};
+
+#if __FLIGHT_PARAMS__
+  FlightParamsBuffer flight_params;
+#else
+  extern FlightParamsBuffer flight_params;
+#endif
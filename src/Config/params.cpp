@@ -0,0 +1,6 @@
+// Parameter Registry for the dRehmFlight Flight Control Software
+//
+// GPL 3.0
+
+#define __PARAMS__ 1
+#include "params.h"
@@ -0,0 +1,225 @@
+#pragma once
+
+// Parameter Registry for the dRehmFlight Flight Control Software
+//
+// Every parameter saved in EEPROM is declared once, in the lists below (one list per menu):
+//
+//   PARAM(storage, type, name, caption, default, min, max)
+//
+//   storage: FLIGHT: controller gains and mixer values, members of FlightParams (flight_params.h),
+//                    read by the control chain from the flight_params snapshot;
+//            GLOBAL: other parameters, global variables defined by params.cpp.
+//   type:    FLOAT (float) or ULONG (unsigned long).
+//   min/max: range accepted from the menus and the USB "p" command.
+//
+// Generated from these lists: the global variables and the FlightParams members with their
+// default value, the ParamId enum, and in config.cpp the configuration data (ConfigData, fields
+// in list order), the parameter table with the compile-time name hashes and the parameter lines
+// of the menus. The debugging parameters (Debug menu) are not saved and are not part of it.
+//
+// In EEPROM each parameter is an entry identified by the hash of its name: parameters can be
+// added, removed, moved or retyped without a new VERSION. Renaming one needs an entry in
+// PARAM_RENAMES (config.cpp), otherwise its saved value is lost.
+//
+// GPL 3.0
+
+#include <cinttypes>
+
+#define RIGHT_ELEVATOR_CENTER  0.48
+#define LEFT_ELEVATOR_CENTER   0.46
+
+#define RIGHT_AILERON_CENTER   0.56
+#define RIGHT_AILERON_BOTTOM   0.95
+#define RIGHT_AILERON_45       0.87
+
+#define LEFT_AILERON_CENTER    0.55
+#define LEFT_AILERON_BOTTOM    0.05
+#define LEFT_AILERON_45        0.22
+
+#define FRONT_MOTOR_CENTER     0.57
+
+// Menu "Controller Params"
+
+#define CTRL_PARAMS(PARAM) \
+  PARAM(FLIGHT, FLOAT, i_limit,        "Integrator Saturation Level", 25.0,     0.0, 100.0)
+
+// Menu "Controller Params/Roll"
+
+#define ROLL_PARAMS(PARAM) \
+  PARAM(FLIGHT, FLOAT, maxRoll,        "Max Angle",                   30.0,     0.0,  60.0) \
+  PARAM(FLIGHT, FLOAT, Kp_roll_angle,  "P-gain Angle Mode",           0.2,      0.0,  10.0) \
+  PARAM(FLIGHT, FLOAT, Ki_roll_angle,  "I-gain Angle Mode",           0.3,      0.0,  10.0) \
+  PARAM(FLIGHT, FLOAT, Kd_roll_angle,  "D-gain Angle Mode",           0.05,     0.0,   1.0) \
+  PARAM(FLIGHT, FLOAT, Kp_roll_rate,   "P-gain Rate Mode",            0.15,     0.0,  10.0) \
+  PARAM(FLIGHT, FLOAT, Ki_roll_rate,   "I-gain Rate Mode",            0.2,      0.0,  10.0) \
+  PARAM(FLIGHT, FLOAT, Kd_roll_rate,   "D-gain Rate Mode",            0.0002,   0.0,   1.0) \
+  PARAM(FLIGHT, FLOAT, B_loop_roll,    "Loop Damping",                0.9,      0.0,   1.0)
+
+// Menu "Controller Params/Pitch"
+
+#define PITCH_PARAMS(PARAM) \
+  PARAM(FLIGHT, FLOAT, maxPitch,       "Max Angle",                   30.0,     0.0,  60.0) \
+  PARAM(FLIGHT, FLOAT, Kp_pitch_angle, "P-gain Angle Mode",           0.2,      0.0,  10.0) \
+  PARAM(FLIGHT, FLOAT, Ki_pitch_angle, "I-gain Angle Mode",           0.3,      0.0,  10.0) \
+  PARAM(FLIGHT, FLOAT, Kd_pitch_angle, "D-gain Angle Mode",           0.05,     0.0,   1.0) \
+  PARAM(FLIGHT, FLOAT, Kp_pitch_rate,  "P-gain Rate Mode",            0.15,     0.0,  10.0) \
+  PARAM(FLIGHT, FLOAT, Ki_pitch_rate,  "I-gain Rate Mode",            0.2,      0.0,  10.0) \
+  PARAM(FLIGHT, FLOAT, Kd_pitch_rate,  "D-gain Rate Mode",            0.0002,   0.0,   1.0) \
+  PARAM(FLIGHT, FLOAT, B_loop_pitch,   "Loop Damping",                0.9,      0.0,   1.0)
+
+// Menu "Controller Params/Yaw"
+
+#define YAW_PARAMS(PARAM) \
+  PARAM(FLIGHT, FLOAT, maxYaw,         "Max Rate",                    160.0,    0.0, 720.0) \
+  PARAM(FLIGHT, FLOAT, Kp_yaw,         "P-gain",                      0.3,      0.0,  10.0) \
+  PARAM(FLIGHT, FLOAT, Ki_yaw,         "I-gain",                      0.05,     0.0,  10.0) \
+  PARAM(FLIGHT, FLOAT, Kd_yaw,         "D-gain",                      0.00015,  0.0,   1.0)
+
+// Menu "Mixer Params/Mixer Hover"
+
+#define HOVER_PARAMS(PARAM) \
+  PARAM(FLIGHT, FLOAT, mx_hover_left_aileron_bottom_offset,   "Left Aileron Bottom Offset",   LEFT_AILERON_BOTTOM,   0.0, 1.0) \
+  PARAM(FLIGHT, FLOAT, mx_hover_left_elevator_center_offset,  "Left Elevator Center Offset",  LEFT_ELEVATOR_CENTER,  0.0, 1.0) \
+  PARAM(FLIGHT, FLOAT, mx_hover_front_motor_center_offset,    "Front Motor Center Offset",    FRONT_MOTOR_CENTER,    0.0, 1.0) \
+  PARAM(FLIGHT, FLOAT, mx_hover_right_elevator_center_offset, "Right Elevator Center Offset", RIGHT_ELEVATOR_CENTER, 0.0, 1.0) \
+  PARAM(FLIGHT, FLOAT, mx_hover_right_aileron_bottom_offset,  "Right Aileron Bottom Offset",  RIGHT_AILERON_BOTTOM,  0.0, 1.0) \
+  PARAM(FLIGHT, FLOAT, mx_hover_front_roll_amount,            "Front Roll Amount",            0.65,                  0.0, 1.0)
+
+// Menu "Mixer Params/Mixer Transition"
+
+#define TRANS_PARAMS(PARAM) \
+  PARAM(FLIGHT, FLOAT, mx_trans_left_aileron_45_offset,       "Left Aileron 45 Offset",       LEFT_AILERON_45,       0.0,  1.0) \
+  PARAM(FLIGHT, FLOAT, mx_trans_left_elevator_center_offset,  "Left Elevator Center Offset",  LEFT_ELEVATOR_CENTER,  0.0,  1.0) \
+  PARAM(FLIGHT, FLOAT, mx_trans_front_motor_center_offset,    "Front Motor Center Offset",    FRONT_MOTOR_CENTER,    0.0,  1.0) \
+  PARAM(FLIGHT, FLOAT, mx_trans_right_aileron_45_offset,      "Right Aileron 45 Offset",      RIGHT_AILERON_45,      0.0,  1.0) \
+  PARAM(FLIGHT, FLOAT, mx_trans_right_elevator_center_offset, "Right Elevator Center Offset", RIGHT_ELEVATOR_CENTER, 0.0,  1.0) \
+  PARAM(FLIGHT, FLOAT, mx_trans_front_roll_amount,            "Front Roll Amount",            0.65,                  0.0,  1.0) \
+  PARAM(FLIGHT, FLOAT, mx_trans_pitch_rate_low,               "Pitch Rate Low",               0.1,                   0.0,  1.0) \
+  PARAM(FLIGHT, FLOAT, mx_trans_pitch_rate_high,              "Pitch Rate High",              0.3,                   0.0,  1.0) \
+  PARAM(FLIGHT, FLOAT, mx_trans_pitch_to_over_duration,       "Pitch to Hover Duration",      5.5,                   0.0, 60.0) \
+  PARAM(FLIGHT, FLOAT, mx_trans_pitch_to_forward_duration,    "Pitch to Forward Duration",    2.5,                   0.0, 60.0)
+
+// Menu "Mixer Params/Mixer Forward"
+
+#define FW_PARAMS(PARAM) \
+  PARAM(FLIGHT, FLOAT, mx_fw_pitch_amount,                    "Pitch Amount",                 0.5,                   0.0,  1.0) \
+  PARAM(FLIGHT, FLOAT, mx_fw_roll_amount,                     "Roll Amount",                  0.65,                  0.0,  1.0) \
+  PARAM(FLIGHT, FLOAT, mx_fw_left_aileron_center_offset,      "Left Aileron Center Offset",   LEFT_AILERON_CENTER,   0.0,  1.0) \
+  PARAM(FLIGHT, FLOAT, mx_fw_left_elevator_center_offset,     "Left Elevator Center Offset",  LEFT_ELEVATOR_CENTER,  0.0,  1.0) \
+  PARAM(FLIGHT, FLOAT, mx_fw_front_motor_center_offset,       "Front Motor Center Offset",    FRONT_MOTOR_CENTER,    0.0,  1.0) \
+  PARAM(FLIGHT, FLOAT, mx_fw_right_elevator_center_offset,    "Right Elevator Center Offset", RIGHT_ELEVATOR_CENTER, 0.0,  1.0) \
+  PARAM(FLIGHT, FLOAT, mx_fw_right_aileron_center_offset,     "Right Aileron Center Offset",  RIGHT_AILERON_CENTER,  0.0,  1.0)
+
+// Menu "Fail Safe Params": radio values used when bad receiver data is detected
+
+#define FAIL_SAFE_PARAMS(PARAM) \
+  PARAM(GLOBAL, ULONG, throttle_fs,      "Throttle",                  1000,  800, 2200) \
+  PARAM(GLOBAL, ULONG, aileron_fs,       "Aileron",                   1500,  800, 2200) \
+  PARAM(GLOBAL, ULONG, elevator_fs,      "Elevator",                  1500,  800, 2200) \
+  PARAM(GLOBAL, ULONG, rudder_fs,        "Rudder",                    1500,  800, 2200) \
+  PARAM(GLOBAL, ULONG, throttle_cut_fs,  "Throttle Cut",              2000,  800, 2200) \
+  PARAM(GLOBAL, ULONG, aux1_fs,          "Aux1",                      2000,  800, 2200)
+
+// Menu "Filter Params": defaults tuned for a 2kHz loop rate; biquad stages in Hz, 0 = disabled
+
+#define FILTER_PARAMS(PARAM) \
+  PARAM(GLOBAL, FLOAT, B_madgwick,       "Madgwick",                  0.04,  0.0,    1.0) \
+  PARAM(GLOBAL, FLOAT, B_accel,          "Accelerometer Low Pass",    0.14,  0.0,    1.0) \
+  PARAM(GLOBAL, FLOAT, B_gyro,           "Gyro Low Pass",             0.1,   0.0,    1.0) \
+  PARAM(GLOBAL, FLOAT, B_mag,            "Magnetometer Low Pass",     1.0,   0.0,    1.0) \
+  PARAM(GLOBAL, ULONG, motor_poles,      "Motor Poles",              14,     2,     64  ) \
+  PARAM(GLOBAL, FLOAT, rpm_notch_q,      "RPM Notch Q",               5.0,   0.1,   50.0) \
+  PARAM(GLOBAL, FLOAT, rpm_notch_min_hz, "RPM Notch Min Freq (Hz)",  80.0,   0.0, 1000.0) \
+  PARAM(GLOBAL, FLOAT, gyro_lpf_hz,      "Gyro Biquad LPF (Hz)",      0.0,   0.0, 1000.0) \
+  PARAM(GLOBAL, FLOAT, gyro_notch_hz,    "Gyro Notch Freq (Hz)",      0.0,   0.0, 1000.0) \
+  PARAM(GLOBAL, FLOAT, gyro_notch_q,     "Gyro Notch Q",              3.0,   0.1,   50.0) \
+  PARAM(GLOBAL, FLOAT, accel_lpf_hz,     "Accel Biquad LPF (Hz)",     0.0,   0.0, 1000.0) \
+  PARAM(GLOBAL, FLOAT, dterm_lpf_hz,     "D-Term LPF (Hz)",           0.0,   0.0, 1000.0) \
+  PARAM(GLOBAL, FLOAT, dyn_notch_q,      "Dyn Notch Q",               3.0,   0.1,   50.0) \
+  PARAM(GLOBAL, FLOAT, dyn_notch_min_hz, "Dyn Notch Min Freq (Hz)",  60.0,   0.0, 1000.0) \
+  PARAM(GLOBAL, FLOAT, dyn_notch_max_hz, "Dyn Notch Max Freq (Hz)", 600.0,   0.0, 2000.0)
+
+// Menu "Magnetometer Params": MPU9250 only, values given by calibrateMagnetometer()
+
+#define MAG_PARAMS(PARAM) \
+  PARAM(GLOBAL, FLOAT, MagErrorX,        "Error X",                   0.0, -1000.0, 1000.0) \
+  PARAM(GLOBAL, FLOAT, MagErrorY,        "Error Y",                   0.0, -1000.0, 1000.0) \
+  PARAM(GLOBAL, FLOAT, MagErrorZ,        "Error Z",                   0.0, -1000.0, 1000.0) \
+  PARAM(GLOBAL, FLOAT, MagScaleX,        "Scale X",                   1.0,     0.0,   10.0) \
+  PARAM(GLOBAL, FLOAT, MagScaleY,        "Scale Y",                   1.0,     0.0,   10.0) \
+  PARAM(GLOBAL, FLOAT, MagScaleZ,        "Scale Z",                   1.0,     0.0,   10.0)
+
+// Menu "IMU Offsets Params": MPU6050 offset registers (USE_MPU6050_DMP), values given by
+// calibrateIMUoffsets(), 0 keeps the factory trim
+
+#define IMU_OFFSETS_PARAMS(PARAM) \
+  PARAM(GLOBAL, FLOAT, AccOffsetX,       "Accel Offset X",            0.0, -32768.0, 32767.0) \
+  PARAM(GLOBAL, FLOAT, AccOffsetY,       "Accel Offset Y",            0.0, -32768.0, 32767.0) \
+  PARAM(GLOBAL, FLOAT, AccOffsetZ,       "Accel Offset Z",            0.0, -32768.0, 32767.0) \
+  PARAM(GLOBAL, FLOAT, GyroOffsetX,      "Gyro Offset X",             0.0, -32768.0, 32767.0) \
+  PARAM(GLOBAL, FLOAT, GyroOffsetY,      "Gyro Offset Y",             0.0, -32768.0, 32767.0) \
+  PARAM(GLOBAL, FLOAT, GyroOffsetZ,      "Gyro Offset Z",             0.0, -32768.0, 32767.0)
+
+// Menu "Blackbox Params": log one loop iteration out of blackbox_divider, 0 = recorder disabled
+
+#define BLACKBOX_PARAMS(PARAM) \
+  PARAM(GLOBAL, ULONG, blackbox_divider, "Loop Divider (0 = off)",    2,     0,   1000)
+
+// Menu "Telemetry Params": USB streams started at boot, see setupTelemetry(). Groups bit mask:
+// 1 gyro, 2 accel, 4 mag, 8 attitude, 16 quaternion, 32 des_state, 64 pid, 128 motors,
+// 256 servos, 512 radio, 1024 loop. Rate 0 = stream off
+
+#define TELEMETRY_PARAMS(PARAM) \
+  PARAM(GLOBAL, ULONG, telemetry_rate_0,   "Stream 0 Rate (Hz)",      0,     0,   1000) \
+  PARAM(GLOBAL, ULONG, telemetry_groups_0, "Stream 0 Groups Mask",    0,     0,   2047) \
+  PARAM(GLOBAL, ULONG, telemetry_rate_1,   "Stream 1 Rate (Hz)",      0,     0,   1000) \
+  PARAM(GLOBAL, ULONG, telemetry_groups_1, "Stream 1 Groups Mask",    0,     0,   2047)
+
+// All the parameters, in EEPROM entry order
+
+#define ALL_PARAMS(PARAM) \
+  CTRL_PARAMS(PARAM)      ROLL_PARAMS(PARAM)   PITCH_PARAMS(PARAM)       YAW_PARAMS(PARAM) \
+  HOVER_PARAMS(PARAM)     TRANS_PARAMS(PARAM)  FW_PARAMS(PARAM)          FAIL_SAFE_PARAMS(PARAM) \
+  FILTER_PARAMS(PARAM)    MAG_PARAMS(PARAM)    IMU_OFFSETS_PARAMS(PARAM) BLACKBOX_PARAMS(PARAM) \
+  TELEMETRY_PARAMS(PARAM)
+
+#define PARAM_TYPE_FLOAT float
+#define PARAM_TYPE_ULONG unsigned long
+
+// Parameter index in the parameter table (config.cpp)
+
+#define PARAM_ID(storage, type, name, caption, def, min, max) name,
+
+enum class ParamId : uint8_t { ALL_PARAMS(PARAM_ID) COUNT };
+
+#undef PARAM_ID
+
+// FNV-1a hash of a parameter name, evaluated at compile time for the parameter table
+
+constexpr uint32_t
+param_hash(const char * name)
+{
+  uint32_t hash = 2166136261UL;
+
+  while (*name) {
+    hash = (hash ^ (uint8_t) *name++) * 16777619UL;
+  }
+
+  return hash;
+}
+
+// The GLOBAL parameters, with their default value
+
+#define PARAM_GLOBAL_FLIGHT(type, name, def)
+#define PARAM_GLOBAL_GLOBAL(type, name, def) PARAM_GLOBAL_VARIABLE(PARAM_TYPE_##type, name, def)
+#define PARAM_GLOBAL(storage, type, name, caption, def, min, max) PARAM_GLOBAL_##storage(type, name, def)
+
+#if __PARAMS__
+  #define PARAM_GLOBAL_VARIABLE(ctype, name, def) ctype name = def;
+#else
+  #define PARAM_GLOBAL_VARIABLE(ctype, name, def) extern ctype name;
+#endif
+
+ALL_PARAMS(PARAM_GLOBAL)
+
+#undef PARAM_GLOBAL_VARIABLE
@@ -0,0 +1,79 @@
+// Non-blocking USB Console Output for the dRehmFlight Flight Control Software
+//
+// GPL 3.0
+
+#include <cstring>
+
+#define __CONSOLE__ 1
+#include "console.h"
+
+size_t
+Console::write(const uint8_t * buffer, size_t size)
+{
+  uint32_t fill = head - tail;
+
+  if ((fill + size) > RING_SIZE) {
+    dropped_writes++;
+    dropped_bytes += size;
+    return 0;
+  }
+
+  uint32_t pos   = head & (RING_SIZE - 1);
+  uint32_t first = min((uint32_t) size, RING_SIZE - pos);
+
+  memcpy(&ring[pos], buffer, first);
+  if (first < size) memcpy(ring, buffer + first, size - first);
+
+  head += size; // Published after the copy
+  fill += size;
+  if (fill > max_fill) max_fill = fill;
+
+  return size;
+}
+
+void
+Console::drain(uint32_t max_bytes)
+{
+  uint32_t fill = head - tail;
+  if (fill == 0) return;
+
+  int room = Serial.availableForWrite(); // Bytes accepted by the USB stack without waiting
+  if (room <= 0) return;
+
+  uint32_t count = min(min(fill, max_bytes), (uint32_t) room);
+  uint32_t pos   = tail & (RING_SIZE - 1);
+  uint32_t first = min(count, RING_SIZE - pos);
+
+  Serial.write(&ring[pos], first);
+  if (first < count) Serial.write(ring, count - first);
+
+  tail       += count;
+  sent_bytes += count;
+}
+
+void
+Console::flush_all()
+{
+  // Blocking: for use outside of the flight loop only. Gives up after a second without a USB host
+
+  uint32_t start = millis();
+
+  while ((head != tail) && ((millis() - start) < 1000)) drain();
+  Serial.flush();
+}
+
+void
+Console::reset_stats()
+{
+  dropped_writes = 0;
+  dropped_bytes  = 0;
+  max_fill       = 0;
+  sent_bytes     = 0;
+}
+
+void
+Console::show_stats()
+{
+  printf(F("Console: %lu bytes sent, %lu writes (%lu bytes) dropped, ring max %lu%%\n"),
+         sent_bytes, dropped_writes, dropped_bytes, (max_fill * 100) / RING_SIZE);
+}
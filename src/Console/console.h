@@ -0,0 +1,59 @@
+#pragma once
+
+// Non-blocking USB Console Output for the dRehmFlight Flight Control Software
+//
+// A Print class (print(), println(), printf(), write()) that copies the output to a RAM ring
+// buffer instead of writing to the USB serial port. The ring is drained by drain(), called once
+// per loop iteration, with at most the number of bytes the USB stack accepts without waiting
+// (Serial.availableForWrite()) and at most a fixed chunk size. A slow or absent USB host then
+// costs dropped output, never loop time.
+//
+// Drop policy: a write() that does not fit in the ring is dropped entirely (no partial lines
+// from a single write), counted in the overflow counters shown by show_stats().
+//
+// One producer (the main loop and the scheduler tasks, never an interrupt) and one consumer
+// (drain()): the head is only written by the producer, the tail by the consumer.
+//
+// GPL 3.0
+
+#include <cinttypes>
+
+#include "Arduino.h"
+
+class Console : public Print
+{
+  public:
+    static const uint32_t RING_SIZE  = 8192;   // Power of 2
+    static const uint32_t DRAIN_SIZE = 512;    // Max bytes sent to the USB port per drain() call
+
+    Console() : head(0), tail(0) { reset_stats(); }
+   ~Console() { }
+
+    virtual size_t write(uint8_t b) { return write(&b, 1); }
+    virtual size_t write(const uint8_t * buffer, size_t size);
+    virtual int    availableForWrite() { return RING_SIZE - (head - tail); }
+
+    using Print::write;
+
+    void drain(uint32_t max_bytes = DRAIN_SIZE);
+    void flush_all();
+
+    void reset_stats();
+    void show_stats();
+
+  private:
+    uint8_t           ring[RING_SIZE];
+    volatile uint32_t head;              // Total bytes written, wraps at 2^32
+    volatile uint32_t tail;              // Total bytes sent to the USB port
+
+    uint32_t dropped_writes;
+    uint32_t dropped_bytes;
+    uint32_t max_fill;
+    uint32_t sent_bytes;
+};
+
+#if __CONSOLE__
+  Console console;
+#else
+  extern Console console;
+#endif
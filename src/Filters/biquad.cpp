@@ -0,0 +1,66 @@
+// Second Order (Biquad) Filter for the dRehmFlight Flight Control Software
+//
+// GPL 3.0
+
+#include <cmath>
+
+#include "biquad.h"
+
+void
+Biquad::notch(float center_hz, float sample_hz, float q)
+{
+  float omega = 2.0f * (float) M_PI * center_hz / sample_hz;
+  float cs    = cosf(omega);
+  float alpha = sinf(omega) / (2.0f * q);
+  float a0    = 1.0f + alpha;
+
+  b0 = 1.0f / a0;
+  b1 = -2.0f * cs / a0;
+  b2 = b0;
+  a1 = b1;
+  a2 = (1.0f - alpha) / a0;
+}
+
+void
+Biquad::lowpass(float cutoff_hz, float sample_hz, float q)
+{
+  float omega = 2.0f * (float) M_PI * cutoff_hz / sample_hz;
+  float cs    = cosf(omega);
+  float alpha = sinf(omega) / (2.0f * q);
+  float a0    = 1.0f + alpha;
+
+  b0 = ((1.0f - cs) / 2.0f) / a0;
+  b1 = (1.0f - cs) / a0;
+  b2 = b0;
+  a1 = -2.0f * cs / a0;
+  a2 = (1.0f - alpha) / a0;
+}
+
+void
+Biquad::passthrough()
+{
+  b0 = 1.0f;
+  b1 = b2 = a1 = a2 = 0.0f;
+}
+
+void
+Biquad::copy_coefficients(const Biquad & other)
+{
+  b0 = other.b0;
+  b1 = other.b1;
+  b2 = other.b2;
+  a1 = other.a1;
+  a2 = other.a2;
+}
+
+void
+Biquad::get_coefficients(float * coeffs) const
+{
+  // CMSIS-DSP order { b0, b1, b2, a1, a2 }, with the feedback coefficients sign inverted
+
+  coeffs[0] =  b0;
+  coeffs[1] =  b1;
+  coeffs[2] =  b2;
+  coeffs[3] = -a1;
+  coeffs[4] = -a2;
+}
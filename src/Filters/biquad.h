@@ -0,0 +1,35 @@
+#pragma once
+
+// Second Order (Biquad) Filter for the dRehmFlight Flight Control Software
+//
+// Direct form 1, which tolerates coefficients being changed at every sample (RPM tracking
+// notch filters). Coefficients from the RBJ Audio EQ Cookbook, normalized by a0.
+//
+// GPL 3.0
+
+#include <cinttypes>
+
+class Biquad
+{
+  public:
+    Biquad() { passthrough(); reset(); }
+   ~Biquad() { }
+
+    void notch(float center_hz, float sample_hz, float q);
+    void lowpass(float cutoff_hz, float sample_hz, float q = 0.7071f);
+    void passthrough();
+    void copy_coefficients(const Biquad & other);
+    void get_coefficients(float * coeffs) const;
+    void reset() { x1 = x2 = y1 = y2 = 0.0f; }
+
+    inline float apply(float x) {
+      float y = b0 * x + b1 * x1 + b2 * x2 - a1 * y1 - a2 * y2;
+      x2 = x1; x1 = x;
+      y2 = y1; y1 = y;
+      return y;
+    }
+
+  private:
+    float b0, b1, b2, a1, a2;
+    float x1, x2, y1, y2;
+};
@@ -0,0 +1,57 @@
+// Cascaded Biquad Filter Bank for the dRehmFlight Flight Control Software
+//
+// GPL 3.0
+
+#include <cstring>
+
+#include "biquad.h"
+#include "biquad_bank.h"
+
+bool
+BiquadBank::add_lowpass(float cutoff_hz, float q)
+{
+  if ((stage_count >= MAX_STAGES) || (cutoff_hz <= 0.0f)) return false;
+
+  stages[stage_count++] = { StageType::LOWPASS, cutoff_hz, q };
+  return true;
+}
+
+bool
+BiquadBank::add_notch(float center_hz, float q)
+{
+  if ((stage_count >= MAX_STAGES) || (center_hz <= 0.0f) || (q <= 0.0f)) return false;
+
+  stages[stage_count++] = { StageType::NOTCH, center_hz, q };
+  return true;
+}
+
+void
+BiquadBank::configure(float sample_hz)
+{
+  // Stages too close to the Nyquist frequency are left out
+
+  Biquad biquad;
+  int    count = 0;
+
+  for (int i = 0; i < stage_count; i++) {
+    const Stage & stage = stages[i];
+
+    if (stage.freq_hz >= 0.45f * sample_hz) continue;
+
+    if (stage.type == StageType::LOWPASS) {
+      biquad.lowpass(stage.freq_hz, sample_hz, stage.q);
+    }
+    else {
+      biquad.notch(stage.freq_hz, sample_hz, stage.q);
+    }
+    biquad.get_coefficients(&coefficients[5 * count++]);
+  }
+
+  if (count != active_count) {
+    active_count = count;
+    for (int i = 0; i < AXES; i++) {
+      memset(state[i], 0, sizeof(state[i]));
+      arm_biquad_cascade_df1_init_f32(&instance[i], active_count, coefficients, state[i]);
+    }
+  }
+}
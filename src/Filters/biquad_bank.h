@@ -0,0 +1,61 @@
+#pragma once
+
+// Cascaded Biquad Filter Bank for the dRehmFlight Flight Control Software
+//
+// Up to MAX_STAGES low-pass and notch stages, defined in Hz and applied to each axis of a
+// 3-axis signal with the CMSIS-DSP arm_biquad_cascade_df1_f32() function. The axes share the
+// coefficients and have their own state. Stages are described with add_lowpass() / add_notch(),
+// then configure() computes the coefficients for the sample rate. It is called again when the
+// rate or a stage frequency changes: if the number of active stages stays the same, only the
+// coefficients are updated and the filter state is kept.
+//
+// GPL 3.0
+
+#include <cinttypes>
+#include <arm_math.h>
+
+class BiquadBank
+{
+  public:
+    static const int AXES       = 3;
+    static const int MAX_STAGES = 4;
+
+    BiquadBank() : stage_count(0), active_count(0) { }
+   ~BiquadBank() { }
+
+    void clear() { stage_count = 0; }
+    bool add_lowpass(float cutoff_hz, float q = 0.7071f);
+    bool add_notch(float center_hz, float q);
+    void configure(float sample_hz);
+
+    inline int get_active_count() const { return active_count; }
+
+    inline void apply(float v[AXES]) {
+      if (active_count == 0) return;
+      for (int i = 0; i < AXES; i++) arm_biquad_cascade_df1_f32(&instance[i], &v[i], &v[i], 1);
+    }
+
+    inline float apply(int axis, float x) {
+      if (active_count == 0) return x;
+      arm_biquad_cascade_df1_f32(&instance[axis], &x, &x, 1);
+      return x;
+    }
+
+  private:
+    enum class StageType : uint8_t { LOWPASS, NOTCH };
+
+    struct Stage {
+      StageType type;
+      float     freq_hz;
+      float     q;
+    };
+
+    Stage stages[MAX_STAGES];
+    int   stage_count;
+    int   active_count;                      // stages below the Nyquist limit, in the CMSIS instances
+
+    float coefficients[5 * MAX_STAGES];      // { b0, b1, b2, a1, a2 } per stage
+    float state[AXES][4 * MAX_STAGES];       // { x[n-1], x[n-2], y[n-1], y[n-2] } per stage
+
+    arm_biquad_casd_df1_inst_f32 instance[AXES];
+};
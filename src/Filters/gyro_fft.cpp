@@ -0,0 +1,146 @@
+// Gyro Spectrum Analyzer for the dRehmFlight Flight Control Software
+//
+// GPL 3.0
+
+#include <cmath>
+#include <cstring>
+
+#define __GYRO_FFT__ 1
+#include "gyro_fft.h"
+
+bool
+GyroFFT::configure(float sample_hz, float min_hz, float max_hz)
+{
+  if (!initialized) {
+    if (arm_rfft_fast_init_f32(&rfft, FFT_SIZE) != ARM_MATH_SUCCESS) return false;
+
+    for (int i = 0; i < FFT_SIZE; i++) {
+      window[i] = 0.5f * (1.0f - cosf(2.0f * (float) M_PI * i / (FFT_SIZE - 1)));
+    }
+    memset(samples,   0, sizeof(samples));
+    memset(magnitude, 0, sizeof(magnitude));
+    initialized = true;
+  }
+
+  // Bins 0 and FFT_SIZE / 2 - 1 are kept out, the parabolic interpolation needs both neighbours
+
+  bin_hz  = sample_hz / FFT_SIZE;
+  min_bin = (int) (min_hz / bin_hz);
+  max_bin = (int) (max_hz / bin_hz) + 1;
+
+  if (min_bin < 1)                 min_bin = 1;
+  if (max_bin > FFT_SIZE / 2 - 2)  max_bin = FFT_SIZE / 2 - 2;
+
+  return min_bin < max_bin;
+}
+
+bool
+GyroFFT::update()
+{
+  // Returns true when a new set of peaks is available
+
+  if (!initialized) return false;
+
+  if (step < AXES) {
+    transform(step++);
+    return false;
+  }
+
+  find_peaks();
+  step = 0;
+
+  return true;
+}
+
+void
+GyroFFT::transform(int axis)
+{
+  // The ring buffer is unrolled from the oldest sample while applying the window. The FFT output
+  // is packed: output[0] is the DC value, output[1] the Nyquist value, then the real and imaginary
+  // parts of the other bins.
+
+  const float * s   = samples[axis];
+  int           idx = head;
+
+  for (int i = 0; i < FFT_SIZE; i++) {
+    input[i] = s[idx] * window[i];
+    idx = (idx + 1) & (FFT_SIZE - 1);
+  }
+
+  arm_rfft_fast_f32(&rfft, input, output, 0);
+
+  if (axis == 0) {
+    arm_cmplx_mag_f32(output, magnitude, FFT_SIZE / 2);
+  }
+  else {
+    float mag[FFT_SIZE / 2];
+    arm_cmplx_mag_f32(output, mag, FFT_SIZE / 2);
+    arm_add_f32(magnitude, mag, magnitude, FFT_SIZE / 2);
+  }
+}
+
+void
+GyroFFT::find_peaks()
+{
+  // Local maxima of the searched range, the MAX_PEAKS highest are kept. No peak when the range
+  // is empty (configure() returned false).
+
+  if (min_bin >= max_bin) {
+    peak_count = 0;
+    return;
+  }
+
+  float mean = 0.0f;
+  for (int k = min_bin; k <= max_bin; k++) mean += magnitude[k];
+  mean /= (max_bin - min_bin + 1);
+
+  int   bins[MAX_PEAKS];
+  float mags[MAX_PEAKS];
+  int   count = 0;
+
+  for (int k = min_bin; k <= max_bin; k++) {
+    float m = magnitude[k];
+
+    if ((m < PEAK_MIN_RATIO * mean) || (m <= magnitude[k - 1]) || (m < magnitude[k + 1])) continue;
+
+    int pos = count;
+    while ((pos > 0) && (mags[pos - 1] < m)) pos--;
+    if (pos >= MAX_PEAKS) continue;
+
+    int last = (count < MAX_PEAKS) ? count++ : MAX_PEAKS - 1;
+    for (int j = last; j > pos; j--) {
+      bins[j] = bins[j - 1];
+      mags[j] = mags[j - 1];
+    }
+    bins[pos] = k;
+    mags[pos] = m;
+  }
+
+  // Parabolic interpolation between the neighbouring bins, then smoothing with the previous
+  // peak found within 20% of the new frequency
+
+  float new_hz[MAX_PEAKS];
+
+  for (int i = 0; i < count; i++) {
+    int   k     = bins[i];
+    float left  = magnitude[k - 1];
+    float right = magnitude[k + 1];
+    float denom = left - 2.0f * mags[i] + right;
+    float delta = (denom != 0.0f) ? 0.5f * (left - right) / denom : 0.0f;
+    float hz    = (k + delta) * bin_hz;
+
+    for (int j = 0; j < peak_count; j++) {
+      if (fabsf(peak_hz[j] - hz) < 0.2f * hz) {
+        hz = peak_hz[j] + PEAK_SMOOTHING * (hz - peak_hz[j]);
+        break;
+      }
+    }
+    new_hz[i] = hz;
+  }
+
+  for (int i = 0; i < count; i++) {
+    peak_hz[i]  = new_hz[i];
+    peak_mag[i] = mags[i] / AXES;
+  }
+  peak_count = count;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+// Gyro Spectrum Analyzer for the dRehmFlight Flight Control Software
+//
+// The last FFT_SIZE gyro samples of each axis are kept in a ring buffer filled by push() at the
+// loop rate. update() is called by a background task and does one step of the analysis per call:
+// the Hann windowed real FFT (CMSIS-DSP arm_rfft_fast_f32) of one axis, then the peak search on
+// the magnitudes summed over the three axes. Up to MAX_PEAKS peaks are tracked between min_hz and
+// max_hz, refined by parabolic interpolation and smoothed from one analysis to the next.
+//
+// GPL 3.0
+
+#include <cinttypes>
+#include <arm_math.h>
+
+class GyroFFT
+{
+  public:
+    static const int AXES      = 3;
+    static const int FFT_SIZE  = 256;  // 128ms window, 7.8Hz bins at 2kHz
+    static const int MAX_PEAKS = 3;
+
+    GyroFFT() : initialized(false), head(0), step(0), peak_count(0) { }
+   ~GyroFFT() { }
+
+    bool configure(float sample_hz, float min_hz, float max_hz);
+    bool update();
+
+    inline void push(const float gyro[AXES]) {
+      for (int i = 0; i < AXES; i++) samples[i][head] = gyro[i];
+      head = (head + 1) & (FFT_SIZE - 1);
+    }
+
+    inline int   get_peak_count()      const { return peak_count;        }
+    inline float get_peak_hz(int idx)  const { return peak_hz[idx];      }
+    inline float get_peak_mag(int idx) const { return peak_mag[idx];     }
+
+  private:
+    static constexpr float PEAK_SMOOTHING = 0.5f; // Low-pass factor applied to a peak found again
+    static constexpr float PEAK_MIN_RATIO = 2.0f; // Peaks must be this much above the mean magnitude
+
+    void transform(int axis);
+    void find_peaks();
+
+    arm_rfft_fast_instance_f32 rfft;
+    bool  initialized;
+
+    float samples[AXES][FFT_SIZE];  // Ring buffers, head is the oldest sample
+    int   head;
+    int   step;                     // Axis to transform next, AXES for the peak search
+
+    float window[FFT_SIZE];
+    float input[FFT_SIZE];
+    float output[FFT_SIZE];         // Packed complex spectrum
+    float magnitude[FFT_SIZE / 2];  // Summed over the axes
+
+    float bin_hz;
+    int   min_bin, max_bin;
+
+    float peak_hz[MAX_PEAKS];
+    float peak_mag[MAX_PEAKS];
+    int   peak_count;
+};
+
+#if __GYRO_FFT__
+  GyroFFT gyro_fft;
+#else
+  extern GyroFFT gyro_fft;
+#endif
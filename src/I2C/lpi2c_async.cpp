@@ -0,0 +1,145 @@
+// Asynchronous LPI2C1 Register Reads for the dRehmFlight Flight Control Software
+//
+// GPL 3.0
+
+#include "Arduino.h"
+
+#include "../Console/console.h"
+
+#define __LPI2C_ASYNC__ 1
+#include "lpi2c_async.h"
+
+// LPI2C master command words (MTDR[10:8])
+
+#define CMD_TRANSMIT  (0 << 8)
+#define CMD_RECEIVE   (1 << 8)
+#define CMD_STOP      (2 << 8)
+#define CMD_START     (4 << 8)
+
+#define MSR_ERRORS    (LPI2C_MSR_NDF | LPI2C_MSR_ALF | LPI2C_MSR_FEF | LPI2C_MSR_PLTF)
+
+// DMA destination, in DTCM (not cached): no cache maintenance needed
+
+static uint8_t rx_buffer[LPI2CAsync::MAX_LENGTH];
+
+void
+LPI2CAsync::setup()
+{
+  dma.begin();
+  dma.source(*(volatile uint8_t *) &LPI2C1_MRDR);
+  dma.triggerAtHardwareEvent(DMAMUX_SOURCE_LPI2C1);
+  dma.interruptAtCompletion();
+  dma.disableOnCompletion();
+  dma.attachInterrupt(dma_isr);
+
+  attachInterruptVector(IRQ_LPI2C1, lpi2c_isr);
+  NVIC_SET_PRIORITY(IRQ_LPI2C1, 32);
+  NVIC_ENABLE_IRQ(IRQ_LPI2C1);
+}
+
+bool
+LPI2CAsync::start_read(uint8_t dev_addr, uint8_t reg_addr, uint8_t * data, uint8_t length, Callback cb)
+{
+  if ((status == Status::BUSY) || (length == 0) || (length > MAX_LENGTH)) return false;
+  if (LPI2C1_MSR & LPI2C_MSR_BBF) return false; // Bus used by someone else
+
+  dest        = data;
+  dest_length = length;
+  callback    = cb;
+  status      = Status::BUSY;
+  started_at  = micros();
+  transfers++;
+
+  LPI2C1_MCR |= LPI2C_MCR_RTF | LPI2C_MCR_RRF;                 // Empty the FIFOs
+  LPI2C1_MSR  = LPI2C_MSR_EPF | LPI2C_MSR_SDF | MSR_ERRORS;     // Clear flags
+
+  dma.destinationBuffer(rx_buffer, length);
+  dma.enable();
+
+  LPI2C1_MDER = LPI2C_MDER_RDDE;
+  LPI2C1_MIER = MSR_ERRORS;
+
+  // The transmit FIFO is 4 words deep: the STOP command is queued as soon as the
+  // START command has been popped, which happens immediately on an idle bus.
+
+  LPI2C1_MTDR = CMD_START    | (dev_addr << 1);
+  LPI2C1_MTDR = CMD_TRANSMIT | reg_addr;
+  LPI2C1_MTDR = CMD_START    | (dev_addr << 1) | 1;
+  LPI2C1_MTDR = CMD_RECEIVE  | (length - 1);
+
+  uint32_t spin_start = ARM_DWT_CYCCNT;
+  while ((LPI2C1_MFSR & 0x07) >= 4) {
+    if ((ARM_DWT_CYCCNT - spin_start) > (F_CPU_ACTUAL / 100000)) break; // 10us, the error path takes over
+  }
+  LPI2C1_MTDR = CMD_STOP;
+
+  return true;
+}
+
+bool
+LPI2CAsync::wait(uint32_t timeout_us)
+{
+  while (status == Status::BUSY) {
+    if ((micros() - started_at) > timeout_us) {
+      noInterrupts();
+      if (status == Status::BUSY) {
+        timeouts++;
+        abort();
+        complete(false);
+      }
+      interrupts();
+    }
+  }
+
+  return status == Status::DONE;
+}
+
+void
+LPI2CAsync::abort()
+{
+  dma.disable();
+  LPI2C1_MDER = 0;
+  LPI2C1_MIER = 0;
+  LPI2C1_MCR |= LPI2C_MCR_RTF | LPI2C_MCR_RRF;
+  LPI2C1_MTDR = CMD_STOP; // Release the bus if still owned
+  LPI2C1_MSR  = MSR_ERRORS;
+}
+
+void
+LPI2CAsync::complete(bool ok)
+{
+  if (ok) memcpy(dest, rx_buffer, dest_length);
+  status = ok ? Status::DONE : Status::ERROR;
+  if (callback) callback(ok);
+}
+
+void
+LPI2CAsync::dma_isr()
+{
+  lpi2c_async.dma.clearInterrupt();
+  LPI2C1_MDER = 0;
+  LPI2C1_MIER = 0;
+  if (lpi2c_async.status == Status::BUSY) lpi2c_async.complete(true);
+  asm volatile ("dsb");
+}
+
+void
+LPI2CAsync::lpi2c_isr()
+{
+  uint32_t msr = LPI2C1_MSR;
+
+  if (msr & MSR_ERRORS) {
+    if (msr & LPI2C_MSR_NDF) lpi2c_async.nacks++;
+    lpi2c_async.errors++;
+    lpi2c_async.abort();
+    if (lpi2c_async.status == Status::BUSY) lpi2c_async.complete(false);
+  }
+  asm volatile ("dsb");
+}
+
+void
+LPI2CAsync::show_stats()
+{
+  console.printf(F("I2C async: %lu transfers, %lu errors (%lu NACK), %lu timeouts\n"),
+                transfers, errors, nacks, timeouts);
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+// Asynchronous LPI2C1 Register Reads for the dRehmFlight Flight Control Software
+//
+// Reads a block of registers of an I2C device without keeping the CPU busy. The whole
+// transaction (START + address, register, repeated START + address, receive, STOP) is
+// queued as LPI2C command words and the received bytes are moved to memory by DMA.
+// Completion is reported through a callback, called from the DMA interrupt.
+//
+// Errors (NACK, arbitration lost, FIFO error, pin low timeout) abort the transfer from
+// the LPI2C interrupt. A transfer taking longer than the timeout given to wait() is
+// aborted too, so that a stuck bus costs a bounded amount of time; the caller can then
+// fall back to a blocking read.
+//
+// The bus pins and clock are the ones configured by Wire.begin()/Wire.setClock(): the
+// Wire library can still be used when no asynchronous transfer is in progress.
+//
+// GPL 3.0
+
+#include <cinttypes>
+
+#include "Arduino.h"
+#include <DMAChannel.h>
+
+class LPI2CAsync
+{
+  public:
+    enum class Status : uint8_t { IDLE, BUSY, DONE, ERROR };
+
+    typedef void (* Callback)(bool ok);
+
+    static const uint8_t MAX_LENGTH = 32;
+
+    LPI2CAsync() : status(Status::IDLE), callback(nullptr), started_at(0),
+                   transfers(0), errors(0), nacks(0), timeouts(0) { }
+   ~LPI2CAsync() { }
+
+    void setup();
+    bool start_read(uint8_t dev_addr, uint8_t reg_addr, uint8_t * data, uint8_t length, Callback cb = nullptr);
+    bool wait(uint32_t timeout_us);
+    void release() { if (status != Status::BUSY) status = Status::IDLE; }
+
+    inline Status get_status() { return status; }
+    inline bool   idle()       { return status == Status::IDLE; }
+
+    void show_stats();
+
+  private:
+    volatile Status   status;
+    Callback          callback;
+    uint8_t         * dest;
+    uint8_t           dest_length;
+    uint32_t          started_at;
+    DMAChannel        dma;
+
+    uint32_t          transfers;
+    volatile uint32_t errors;
+    volatile uint32_t nacks;
+    uint32_t          timeouts;
+
+    void abort();
+    void complete(bool ok);
+
+    static void dma_isr();
+    static void lpi2c_isr();
+};
+
+#if __LPI2C_ASYNC__
+  LPI2CAsync lpi2c_async;
+#else
+  extern LPI2CAsync lpi2c_async;
+#endif
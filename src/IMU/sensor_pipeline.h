@@ -0,0 +1,122 @@
+#pragma once
+
+// Compile-time Specialized IMU Sensor Pipeline for the dRehmFlight Flight Control Software
+//
+// GPL 3.0
+//
+// The IMU driver and the full scale ranges are template parameters: the raw to physical units
+// scale factors are constexpr float multipliers and a range not supported by the driver fails
+// at compile time. The accelerometer scaling, bias removal and low-pass filter are folded in one
+// multiply-add per axis. The gyro chain is done in two stages (convert_gyro() and filter_gyro())
+// for the RPM notch filters to be applied in between.
+
+#include <cinttypes>
+
+enum class IMUDriver     : uint8_t { MPU6050, MPU6050_DMP, MPU9250 };
+
+// The enum values are the FS_SEL register values of both the MPU6050 and MPU9250
+
+enum class IMUGyroRange  : uint8_t { DPS_250, DPS_500, DPS_1000, DPS_2000 };
+enum class IMUAccelRange : uint8_t { G_2, G_4, G_8, G_16 };
+
+// Packed 6-axis block, as read from the sensor registers
+
+struct IMURawSample {
+  int16_t acc[3];
+  int16_t gyro[3];
+};
+
+// Sensitivities from the datasheets (LSB per deg/sec and LSB per G)
+
+template <IMUGyroRange R> struct IMUGyroRangeTraits;
+
+template <> struct IMUGyroRangeTraits<IMUGyroRange::DPS_250 > { static constexpr float LSB = 131.0f; };
+template <> struct IMUGyroRangeTraits<IMUGyroRange::DPS_500 > { static constexpr float LSB =  65.5f; };
+template <> struct IMUGyroRangeTraits<IMUGyroRange::DPS_1000> { static constexpr float LSB =  32.8f; };
+template <> struct IMUGyroRangeTraits<IMUGyroRange::DPS_2000> { static constexpr float LSB =  16.4f; };
+
+template <IMUAccelRange R> struct IMUAccelRangeTraits;
+
+template <> struct IMUAccelRangeTraits<IMUAccelRange::G_2 > { static constexpr float LSB = 16384.0f; };
+template <> struct IMUAccelRangeTraits<IMUAccelRange::G_4 > { static constexpr float LSB =  8192.0f; };
+template <> struct IMUAccelRangeTraits<IMUAccelRange::G_8 > { static constexpr float LSB =  4096.0f; };
+template <> struct IMUAccelRangeTraits<IMUAccelRange::G_16> { static constexpr float LSB =  2048.0f; };
+
+// Ranges each driver can be configured for
+
+template <IMUDriver D> struct IMUDriverTraits {
+  static constexpr bool supports(IMUGyroRange, IMUAccelRange) { return true; }
+};
+
+template <> struct IMUDriverTraits<IMUDriver::MPU6050_DMP> {
+  // The DMP firmware image integrates the gyro at 2000deg/sec and expects 1G = 16384
+  static constexpr bool supports(IMUGyroRange gyro, IMUAccelRange accel) {
+    return (gyro == IMUGyroRange::DPS_2000) && (accel == IMUAccelRange::G_2);
+  }
+};
+
+template <IMUDriver DRIVER, IMUGyroRange GYRO_RANGE, IMUAccelRange ACCEL_RANGE>
+class SensorPipeline
+{
+  static_assert(IMUDriverTraits<DRIVER>::supports(GYRO_RANGE, ACCEL_RANGE),
+                "Gyro or accelerometer full scale range not supported by the selected IMU driver");
+
+  public:
+    static constexpr uint8_t GYRO_FS_SEL  = (uint8_t) GYRO_RANGE;
+    static constexpr uint8_t ACCEL_FS_SEL = (uint8_t) ACCEL_RANGE;
+    static constexpr float   GYRO_SCALE   = 1.0f / IMUGyroRangeTraits<GYRO_RANGE>::LSB;   // deg/sec per LSB
+    static constexpr float   ACCEL_SCALE  = 1.0f / IMUAccelRangeTraits<ACCEL_RANGE>::LSB; // G's per LSB
+
+    SensorPipeline() {}
+   ~SensorPipeline() {}
+
+    // Biases are in G's and deg/sec. b_accel and b_gyro are the low-pass filters coefficients,
+    // from 0 (frozen) to 1 (no filtering). To be called again when one of them changes.
+
+    void setup(const float acc_bias[3], float b_accel, const float gyro_bias[3], float b_gyro) {
+      acc_keep  = 1.0f - b_accel;
+      acc_gain  = b_accel * ACCEL_SCALE;
+      gyro_keep = 1.0f - b_gyro;
+      gyro_gain = b_gyro;
+
+      for (int i = 0; i < 3; i++) {
+        acc_offset[i]  = b_accel * acc_bias[i];
+        gyro_offset[i] = gyro_bias[i];
+      }
+    }
+
+    // Scaled, bias corrected and low-pass filtered accelerometer (G's)
+
+    inline void process_accel(const IMURawSample & raw, float acc[3]) {
+      for (int i = 0; i < 3; i++) {
+        acc_state[i] = acc_state[i] * acc_keep + (raw.acc[i] * acc_gain - acc_offset[i]);
+        acc[i]       = acc_state[i];
+      }
+    }
+
+    // Scaled and bias corrected gyro (deg/sec)
+
+    inline void convert_gyro(const IMURawSample & raw, float gyro[3]) const {
+      for (int i = 0; i < 3; i++) gyro[i] = raw.gyro[i] * GYRO_SCALE - gyro_offset[i];
+    }
+
+    // Low-pass filtered gyro, in place
+
+    inline void filter_gyro(float gyro[3]) {
+      for (int i = 0; i < 3; i++) {
+        gyro_state[i] = gyro_state[i] * gyro_keep + gyro[i] * gyro_gain;
+        gyro[i]       = gyro_state[i];
+      }
+    }
+
+  private:
+    float acc_keep       = 1.0f;
+    float acc_gain       = 0.0f;
+    float acc_offset[3]  = { 0.0f, 0.0f, 0.0f };
+    float acc_state[3]   = { 0.0f, 0.0f, 0.0f };
+
+    float gyro_keep      = 1.0f;
+    float gyro_gain      = 0.0f;
+    float gyro_offset[3] = { 0.0f, 0.0f, 0.0f };
+    float gyro_state[3]  = { 0.0f, 0.0f, 0.0f };
+};
@@ -431,6 +431,92 @@ int MPU9250FIFO::enableFifo(bool accel,bool gyro,bool mag,bool temp) {
   return 1;
 }
 
+/* configures the FIFO for batch acquisition: gyro at 8 kHz (3600 Hz bandwidth) and accel,
+   12 bytes per sample. The magnetometer stays out of the FIFO, the MPU9250 I2C master reads it
+   every 32 samples (250 Hz) into the external sensor registers, see readMag() */
+int MPU9250FIFO::enableFifoBatch() {
+  // use low speed SPI for register setting
+  _useSPIHS = false;
+  if(writeRegister(CONFIG,GYRO_DLPF_3600) < 0){ // 8 kHz sample rate, SMPDIV is ignored
+    return -1;
+  }
+  if(writeRegister(I2C_SLV4_CTRL,31) < 0){ // slaves accessed every 1 + 31 samples
+    return -2;
+  }
+  if(writeRegister(I2C_MST_DELAY_CTRL,I2C_SLV0_DLY_EN) < 0){
+    return -3;
+  }
+  if(writeRegister(FIFO_EN,FIFO_ACCEL|FIFO_GYRO) < 0){
+    return -4;
+  }
+  if(writeRegister(USER_CTRL,FIFO_EN_BIT|I2C_MST_EN) < 0){
+    return -5;
+  }
+  _enFifoAccel = true;
+  _enFifoGyro = true;
+  _enFifoMag = false;
+  _enFifoTemp = false;
+  _fifoFrameSize = 12;
+  resetFifo();
+  return 1;
+}
+
+/* reads up to maxSamples samples from the FIFO as ax, ay, az, gx, gy, gz raw counts, returns the
+   number of samples read. A FIFO close to full has overflowed and lost its frame alignment:
+   it is reset and overflow is set */
+int MPU9250FIFO::readFifoBatch(int16_t* data, size_t maxSamples, bool* overflow) {
+  _useSPIHS = true; // use the high speed SPI for data readout
+  *overflow = false;
+  if (readRegisters(FIFO_COUNT, 2, _buffer) < 0) {
+    return -1;
+  }
+  _fifoSize = (((uint16_t) (_buffer[0]&0x1F)) <<8) + (((uint16_t) _buffer[1]));
+  if (_fifoSize > FIFO_SIZE - _fifoFrameSize) {
+    resetFifo();
+    *overflow = true;
+    return 0;
+  }
+  size_t samples = _fifoSize/_fifoFrameSize;
+  if (samples > maxSamples) {
+    samples = maxSamples;
+  }
+  // read whole samples, at most 21 (252 bytes) per transfer
+  uint8_t* bytes = (uint8_t*) data;
+  size_t remaining = samples*_fifoFrameSize;
+  while (remaining > 0) {
+    uint8_t count = (remaining > 252) ? 252 : remaining;
+    if (readRegisters(FIFO_READ, count, bytes) < 0) {
+      return -1;
+    }
+    bytes += count;
+    remaining -= count;
+  }
+  // big endian to int16, in place
+  for (size_t i = 0; i < samples*6; i++) {
+    uint8_t* p = (uint8_t*) &data[i];
+    data[i] = (((int16_t) p[0]) << 8) | p[1];
+  }
+  return samples;
+}
+
+/* reads the last magnetometer sample fetched by the MPU9250 I2C master, returns -1 on
+   magnetic sensor overflow */
+int MPU9250FIFO::readMag(int16_t* mx, int16_t* my, int16_t* mz) {
+  _useSPIHS = true; // use the high speed SPI for data readout
+  if (readRegisters(EXT_SENS_DATA_00, 7, _buffer) < 0) {
+    return -1;
+  }
+  *mx = (((int16_t)_buffer[1]) << 8) | _buffer[0];
+  *my = (((int16_t)_buffer[3]) << 8) | _buffer[2];
+  *mz = (((int16_t)_buffer[5]) << 8) | _buffer[4];
+  return (_buffer[6] & 0x08) ? -1 : 1; // ST2 HOFL
+}
+
+/* empties the FIFO, without the register read back delay of writeRegister() */
+void MPU9250FIFO::resetFifo() {
+  writeRegisterFast(USER_CTRL,FIFO_EN_BIT|I2C_MST_EN|FIFO_RST);
+}
+
 /* reads the most current data from MPU9250 and stores in buffer */
 int MPU9250::readSensor() {
   _useSPIHS = true; // use the high speed SPI for data readout
@@ -1012,9 +1098,7 @@ int MPU9250::readRegisters(uint8_t subAddress, uint8_t count, uint8_t* dest){
     digitalWriteFast(_csPin,LOW); // select the MPU9250 chip
 	delayNanoseconds(200);
     _spi->transfer(subAddress | SPI_READ); // specify the starting register address
-    for(uint8_t i = 0; i < count; i++){
-      dest[i] = _spi->transfer(0x00); // read the data
-    }
+    _spi->transfer(nullptr, dest, count); // read the data, as one block through the LPSPI FIFO
     digitalWriteFast(_csPin,HIGH); // deselect the MPU9250 chip
 	delayNanoseconds(200);
     _spi->endTransaction(); // end the transaction
@@ -1103,6 +1187,24 @@ int MPU9250::readRegisters(uint8_t subAddress, uint8_t count, uint8_t* dest){
 }
 #endif
 
+/* writes a byte to MPU9250 register given a register address and data, without delay and read back */
+void MPU9250::writeRegisterFast(uint8_t subAddress, uint8_t data){
+  if( _useSPI ){
+    _spi->beginTransaction(SPISettings(SPI_LS_CLOCK, MSBFIRST, SPI_MODE3)); // begin the transaction
+    digitalWrite(_csPin,LOW); // select the MPU9250 chip
+    _spi->transfer(subAddress); // write the register address
+    _spi->transfer(data); // write the data
+    digitalWrite(_csPin,HIGH); // deselect the MPU9250 chip
+    _spi->endTransaction(); // end the transaction
+  }
+  else{
+    _i2c->beginTransmission(_address); // open the device
+    _i2c->write(subAddress); // write the register address
+    _i2c->write(data); // write the data
+    _i2c->endTransmission();
+  }
+}
+
 /* writes a register to the AK8963 given a register address and data */
 int MPU9250::writeAK8963Register(uint8_t subAddress, uint8_t data){
   // set slave 0 to the AK8963 and set for write
@@ -260,6 +260,13 @@ class MPU9250{
     const uint8_t FIFO_MAG = 0x01;
     const uint8_t FIFO_COUNT = 0x72;
     const uint8_t FIFO_READ = 0x74;
+    const uint8_t FIFO_RST = 0x04;
+    const uint8_t FIFO_EN_BIT = 0x40;
+    const size_t FIFO_SIZE = 512;
+    const uint8_t GYRO_DLPF_3600 = 0x07;
+    const uint8_t I2C_SLV4_CTRL = 0x34;
+    const uint8_t I2C_MST_DELAY_CTRL = 0x67;
+    const uint8_t I2C_SLV0_DLY_EN = 0x01;
     // AK8963 registers
     const uint8_t AK8963_I2C_ADDR = 0x0C;
     const uint8_t AK8963_HXL = 0x03; 
@@ -274,6 +281,7 @@ class MPU9250{
     const uint8_t AK8963_WHO_AM_I = 0x00;
     // private functions
     int writeRegister(uint8_t subAddress, uint8_t data);
+    void writeRegisterFast(uint8_t subAddress, uint8_t data);
     int readRegisters(uint8_t subAddress, uint8_t count, uint8_t* dest);
     int writeAK8963Register(uint8_t subAddress, uint8_t data);
     int readAK8963Registers(uint8_t subAddress, uint8_t count, uint8_t* dest);
@@ -296,6 +304,11 @@ class MPU9250FIFO: public MPU9250 {
     void getFifoMagY_uT(size_t *size,float* data);
     void getFifoMagZ_uT(size_t *size,float* data);
     void getFifoTemperature_C(size_t *size,float* data);
+    // batch acquisition, raw counts in sensor axes
+    int enableFifoBatch();
+    int readFifoBatch(int16_t* data, size_t maxSamples, bool* overflow);
+    int readMag(int16_t* mx, int16_t* my, int16_t* mz);
+    void resetFifo();
   protected:
     // fifo
     bool _enFifoAccel,_enFifoGyro,_enFifoMag,_enFifoTemp;
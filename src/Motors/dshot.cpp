@@ -0,0 +1,323 @@
+// DShot150/300/600 Digital Motor Output for the dRehmFlight Flight Control Software
+//
+// GPL 3.0
+
+#include "Arduino.h"
+
+#define __DSHOT__ 1
+#include "dshot.h"
+
+enum DShotChannel : uint8_t { CHANNEL_X, CHANNEL_A, CHANNEL_B };
+
+struct DShotPinInfo {
+  uint8_t           pin;
+  IMXRT_FLEXPWM_t * flexpwm;
+  uint8_t           submodule;
+  DShotChannel      channel;
+  uint8_t           mux;         // IOMUXC alternate function selecting the FlexPWM output
+  uint8_t           dma_source;  // DMAMUX request raised by the submodule value registers reload
+};
+
+static const DShotPinInfo pin_info[] = {
+  { 0, &IMXRT_FLEXPWM1, 1, CHANNEL_X, 4, DMAMUX_SOURCE_FLEXPWM1_WRITE1 }, // AD_B0_03
+  { 1, &IMXRT_FLEXPWM1, 0, CHANNEL_X, 4, DMAMUX_SOURCE_FLEXPWM1_WRITE0 }, // AD_B0_02
+  { 2, &IMXRT_FLEXPWM4, 2, CHANNEL_A, 1, DMAMUX_SOURCE_FLEXPWM4_WRITE2 }, // EMC_04
+  { 4, &IMXRT_FLEXPWM2, 0, CHANNEL_A, 1, DMAMUX_SOURCE_FLEXPWM2_WRITE0 }, // EMC_06
+  { 5, &IMXRT_FLEXPWM2, 1, CHANNEL_A, 1, DMAMUX_SOURCE_FLEXPWM2_WRITE1 }, // EMC_08
+};
+
+// GCR 5 bits code to 4 bits value, 0xFF for invalid codes
+
+static const uint8_t gcr_decode[32] = {
+  0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x09, 0x0A, 0x0B, 0xFF, 0x0D, 0x0E, 0x0F,
+  0xFF, 0xFF, 0x02, 0x03, 0xFF, 0x05, 0x06, 0x07, 0xFF, 0x00, 0x08, 0x01, 0xFF, 0x04, 0x0C, 0xFF
+};
+
+// DMA source buffers, in OCRAM. The data cache is flushed before each transfer.
+
+DMAMEM static uint16_t dma_buffers[DShot::MAX_MOTORS][DShot::DMA_LENGTH] __attribute__((aligned(32)));
+
+bool
+DShot::attach(int pin)
+{
+  if (motor_count >= MAX_MOTORS) return false;
+
+  for (const DShotPinInfo & info : pin_info) {
+    if (info.pin == pin) {
+      motors[motor_count].info   = &info;
+      motors[motor_count].buffer = dma_buffers[motor_count];
+      motors[motor_count].busy   = false;
+      motors[motor_count].erpm   = 0;
+      motors[motor_count].telemetry_errors = 0;
+      motors[motor_count].edge_count       = 0;
+      motors[motor_count].listening        = false;
+      motor_count++;
+      return true;
+    }
+  }
+
+  return false;
+}
+
+bool
+DShot::begin(int rate_kbps, bool bidir)
+{
+  // FlexPWM submodules are clocked by the IPG clock (F_BUS_ACTUAL, 150MHz), without prescaler.
+  // Bit timings: 0 is high for 37.5% of the bit, 1 for 75%.
+
+  bit_length = F_BUS_ACTUAL / (rate_kbps * 1000UL);
+  t0h        = (bit_length * 3) / 8;
+  t1h        = (bit_length * 3) / 4;
+
+  bidirectional        = bidir;
+  telemetry_bit_cycles = (F_CPU_ACTUAL * 4UL) / (rate_kbps * 1000UL * 5UL);
+
+  for (int i = 0; i < motor_count; i++) {
+    Motor               & motor = motors[i];
+    const DShotPinInfo  & info  = *motor.info;
+    IMXRT_FLEXPWM_t     & pwm   = *info.flexpwm;
+    uint16_t              mask  = 1 << info.submodule;
+
+    for (int j = 0; j < DMA_LENGTH; j++) motor.buffer[j] = compare_value(motor, 0);
+    arm_dcache_flush(motor.buffer, sizeof(dma_buffers[0]));
+
+    // One PWM period per DShot bit, full cycle reload, line low when idle
+
+    pwm.MCTRL                    |= FLEXPWM_MCTRL_CLDOK(mask);
+    pwm.SM[info.submodule].CTRL2  = FLEXPWM_SMCTRL2_INDEP | FLEXPWM_SMCTRL2_WAITEN | FLEXPWM_SMCTRL2_DBGEN;
+    pwm.SM[info.submodule].CTRL   = FLEXPWM_SMCTRL_FULL | FLEXPWM_SMCTRL_PRSC(0);
+    pwm.SM[info.submodule].INIT   = 0;
+    pwm.SM[info.submodule].VAL1   = bit_length - 1;
+    pwm.SM[info.submodule].VAL2   = 0;
+    pwm.SM[info.submodule].VAL4   = 0;
+    pwm.SM[info.submodule].OCTRL  = bidirectional ? (FLEXPWM_SMOCTRL_POLA | FLEXPWM_SMOCTRL_POLB | FLEXPWM_SMOCTRL_POLX) : 0;
+
+    volatile uint16_t * value_register;
+
+    switch (info.channel) {
+      case CHANNEL_X:
+        pwm.SM[info.submodule].VAL0 = compare_value(motor, 0);
+        pwm.OUTEN |= FLEXPWM_OUTEN_PWMX_EN(mask);
+        value_register = &pwm.SM[info.submodule].VAL0;
+        break;
+      case CHANNEL_A:
+        pwm.SM[info.submodule].VAL3 = compare_value(motor, 0);
+        pwm.OUTEN |= FLEXPWM_OUTEN_PWMA_EN(mask);
+        value_register = &pwm.SM[info.submodule].VAL3;
+        break;
+      default:
+        pwm.SM[info.submodule].VAL5 = compare_value(motor, 0);
+        pwm.OUTEN |= FLEXPWM_OUTEN_PWMB_EN(mask);
+        value_register = &pwm.SM[info.submodule].VAL5;
+        break;
+    }
+
+    pwm.MCTRL |= FLEXPWM_MCTRL_LDOK(mask) | FLEXPWM_MCTRL_RUN(mask);
+
+    *(portConfigRegister(info.pin)) = info.mux;
+
+    // One 16 bits value written per FlexPWM reload request, for the whole frame
+
+    motor.dma.begin();
+    motor.dma.sourceBuffer(motor.buffer, sizeof(dma_buffers[0]));
+    motor.dma.destination(*value_register);
+    motor.dma.triggerAtHardwareEvent(info.dma_source);
+    motor.dma.interruptAtCompletion();
+    motor.dma.disableOnCompletion();
+
+    switch (i) {
+      case 0:  motor.dma.attachInterrupt(dma_isr_0); break;
+      case 1:  motor.dma.attachInterrupt(dma_isr_1); break;
+      case 2:  motor.dma.attachInterrupt(dma_isr_2); break;
+      default: motor.dma.attachInterrupt(dma_isr_3); break;
+    }
+  }
+
+  return motor_count > 0;
+}
+
+uint16_t
+DShot::compare_value(const Motor & motor, uint16_t high)
+{
+  // The X output is set on VAL0 and cleared at the end of the period (VAL1), A and B outputs
+  // are set at the start of the period (VAL2/VAL4) and cleared on VAL3/VAL5.
+
+  return (motor.info->channel == CHANNEL_X) ? (bit_length - 1) - high : high;
+}
+
+int
+DShot::motor_index(int pin)
+{
+  for (int i = 0; i < motor_count; i++) {
+    if (motors[i].info->pin == pin) return i;
+  }
+  return -1;
+}
+
+void
+DShot::write(int pin, uint16_t value, bool telemetry)
+{
+  int idx = motor_index(pin);
+  if ((idx < 0) || motors[idx].busy) return;
+
+  Motor & motor = motors[idx];
+
+  if (value > THROTTLE_MAX) value = THROTTLE_MAX;
+
+  uint16_t packet = (value << 1) | (telemetry ? 1 : 0);
+  uint16_t crc    = (packet ^ (packet >> 4) ^ (packet >> 8));
+  if (bidirectional) crc = ~crc; // Inverted CRC asks the ESC for an eRPM answer
+  crc &= 0x0F;
+  uint16_t frame  = (packet << 4) | crc;
+
+  for (int j = 0; j < FRAME_BITS; j++) {
+    motor.buffer[j] = compare_value(motor, (frame & (0x8000 >> j)) ? t1h : t0h);
+  }
+  // buffer[FRAME_BITS..DMA_LENGTH - 1] stay at the idle value set by begin()
+
+  arm_dcache_flush(motor.buffer, sizeof(dma_buffers[0]));
+}
+
+void
+DShot::send()
+{
+  if (busy()) return; // Previous frames still being shifted out
+
+  for (int i = 0; i < motor_count; i++) {
+    if (bidirectional) {
+      // Stop listening to the ESC, decode its answer and give the pin back to the FlexPWM
+
+      if (motors[i].listening) {
+        detachInterrupt(motors[i].info->pin);
+        if (!decode_telemetry(motors[i])) motors[i].telemetry_errors++;
+        motors[i].listening = false;
+        *(portConfigRegister(motors[i].info->pin)) = motors[i].info->mux;
+      }
+    }
+    motors[i].busy = true;
+    motors[i].dma.enable();
+  }
+
+  // Start all the transfers together: from now on, every submodule reload requests the next bit value
+
+  for (int i = 0; i < motor_count; i++) {
+    motors[i].info->flexpwm->SM[motors[i].info->submodule].DMAEN = FLEXPWM_SMDMAEN_VALDE;
+  }
+}
+
+bool
+DShot::decode_telemetry(Motor & motor)
+{
+  // Edge intervals, in telemetry bits, give the position of the transitions of the line.
+  // A transition is a 1 of the GCR code (the first one being the start bit). The bits
+  // following the last edge up to the 21st have no transition.
+
+  int      count = motor.edge_count;
+  uint32_t value = 0;
+  int      bits  = 0;
+
+  if (count < 2) return false; // No answer
+
+  for (int i = 1; i < count; i++) {
+    uint32_t len = (motor.edges[i] - motor.edges[i - 1] + (telemetry_bit_cycles >> 1)) / telemetry_bit_cycles;
+    if ((len == 0) || (len > 4)) return false;
+
+    value <<= len;
+    value  |= 1 << (len - 1);
+    bits   += len;
+  }
+
+  if (bits >= 21) return false;
+
+  int fill = 21 - bits; // Last edge and the bits following it
+  value <<= fill;
+  value  |= 1 << (fill - 1);
+
+  // 4 x 5 bits GCR codes (start bit dropped) to 16 bits: 12 bits period + 4 bits CRC
+
+  uint32_t gcr     = value & 0xFFFFF;
+  uint32_t decoded = 0;
+
+  for (int shift = 15; shift >= 0; shift -= 5) {
+    uint8_t nibble = gcr_decode[(gcr >> shift) & 0x1F];
+    if (nibble == 0xFF) return false;
+    decoded = (decoded << 4) | nibble;
+  }
+
+  if (((decoded ^ (decoded >> 4) ^ (decoded >> 8) ^ (decoded >> 12)) & 0x0F) != 0x0F) return false;
+
+  // eeem mmmm mmmm: electrical revolution period in us, mantissa << exponent
+
+  uint32_t period = ((decoded >> 4) & 0x1FF) << (decoded >> 13);
+
+  motor.erpm = ((period == 0) || (period >= (0x1FFUL << 7))) ? 0 : 60000000UL / period;
+
+  return true;
+}
+
+uint32_t
+DShot::get_erpm(int pin)
+{
+  int idx = motor_index(pin);
+  return (idx < 0) ? 0 : motors[idx].erpm;
+}
+
+uint32_t
+DShot::get_telemetry_errors(int pin)
+{
+  int idx = motor_index(pin);
+  return (idx < 0) ? 0 : motors[idx].telemetry_errors;
+}
+
+bool
+DShot::busy()
+{
+  for (int i = 0; i < motor_count; i++) {
+    if (motors[i].busy) return true;
+  }
+  return false;
+}
+
+void
+DShot::dma_complete(int idx)
+{
+  Motor & motor = dshot.motors[idx];
+
+  motor.dma.clearInterrupt();
+  motor.info->flexpwm->SM[motor.info->submodule].DMAEN = 0;
+
+  if (dshot.bidirectional) {
+    // The line is left high by the inverted idle value: take it over to listen to the ESC
+
+    motor.edge_count = 0;
+    motor.listening  = true;
+    pinMode(motor.info->pin, INPUT_PULLUP);
+    switch (idx) {
+      case 0:  attachInterrupt(motor.info->pin, edge_isr_0, CHANGE); break;
+      case 1:  attachInterrupt(motor.info->pin, edge_isr_1, CHANGE); break;
+      case 2:  attachInterrupt(motor.info->pin, edge_isr_2, CHANGE); break;
+      default: attachInterrupt(motor.info->pin, edge_isr_3, CHANGE); break;
+    }
+  }
+
+  motor.busy = false;
+}
+
+void
+DShot::edge_capture(int idx)
+{
+  uint32_t now   = ARM_DWT_CYCCNT;
+  Motor  & motor = dshot.motors[idx];
+
+  if (motor.edge_count < MAX_EDGES) motor.edges[motor.edge_count++] = now;
+}
+
+void DShot::dma_isr_0() { dma_complete(0); }
+void DShot::dma_isr_1() { dma_complete(1); }
+void DShot::dma_isr_2() { dma_complete(2); }
+void DShot::dma_isr_3() { dma_complete(3); }
+
+void DShot::edge_isr_0() { edge_capture(0); }
+void DShot::edge_isr_1() { edge_capture(1); }
+void DShot::edge_isr_2() { edge_capture(2); }
+void DShot::edge_isr_3() { edge_capture(3); }
@@ -0,0 +1,99 @@
+#pragma once
+
+// DShot150/300/600 Digital Motor Output for the dRehmFlight Flight Control Software
+//
+// Each motor pin is driven by its own FlexPWM submodule, running at the DShot bit rate.
+// The 16 bits of a DShot frame (11 bits throttle, 1 bit telemetry request, 4 bits CRC) are
+// translated once per loop into a table of compare values (one per bit, long high time for
+// a 1, short high time for a 0). A DMA channel per motor, triggered by the FlexPWM reload,
+// copies the compare values into the submodule value register, one per bit period. All
+// motors are started together by send(), which returns immediately: the frames are shifted
+// out by the DMA engine without any CPU involvement.
+//
+// Supported motor pins: 0, 1, 2, 4, 5 (at most one pin per FlexPWM submodule).
+//
+// Bidirectional DShot: the signal is inverted (idle high) and the ESC answers each frame,
+// about 30us after it, with its eRPM on the same wire (21 bits GCR encoded at 5/4 of the
+// DShot bit rate). Once a frame has been sent, the pin is turned into an input and the
+// time of each edge of the answer is captured from the cycle counter by a pin interrupt.
+// The answer is decoded by the next send(), before the pin is given back to the FlexPWM.
+// DShot300 is recommended: at DShot600, edges 1.3us apart on all motors are close to the
+// pin interrupt latency and some answers will be lost (counted as telemetry errors).
+//
+// GPL 3.0
+
+#include <cinttypes>
+
+#include "Arduino.h"
+#include <DMAChannel.h>
+
+struct DShotPinInfo;
+
+class DShot
+{
+  public:
+    static const int      MAX_MOTORS   =    4;
+    static const int      FRAME_BITS   =   16;
+    static const int      DMA_LENGTH   = FRAME_BITS + 2; // Two trailing idle bits to leave the line low
+    static const int      MAX_EDGES    =   24;           // Telemetry answer: start edge + at most 21 transitions
+
+    static const uint16_t THROTTLE_MIN =   48;           // Values 1..47 are ESC commands
+    static const uint16_t THROTTLE_MAX = 2047;
+    static const uint16_t MOTOR_STOP   =    0;
+
+    DShot() : motor_count(0), bit_length(0), t0h(0), t1h(0), bidirectional(false), telemetry_bit_cycles(0) { }
+   ~DShot() { }
+
+    bool attach(int pin);
+    bool begin(int rate_kbps, bool bidir = false);
+    void write(int pin, uint16_t value, bool telemetry = false);
+    void send();
+    bool busy();
+
+    // Bidirectional DShot only. Values from the last valid answer of the ESC.
+
+    uint32_t get_erpm(int pin);
+    uint32_t get_telemetry_errors(int pin);
+
+  private:
+    struct Motor {
+      const DShotPinInfo * info;
+      DMAChannel                  dma;
+      uint16_t                  * buffer;
+      volatile bool               busy;
+      volatile uint32_t           edges[MAX_EDGES]; // Cycle counter at each edge of the telemetry answer
+      volatile uint8_t            edge_count;
+      bool                        listening;        // Pin is an input, waiting for the telemetry answer
+      uint32_t                    erpm;
+      uint32_t                    telemetry_errors;
+    };
+
+    Motor    motors[MAX_MOTORS];
+    int      motor_count;
+    uint16_t bit_length;  // FlexPWM counts per bit
+    uint16_t t0h, t1h;    // FlexPWM counts of the high part of a 0 and a 1 bit
+    bool     bidirectional;
+    uint32_t telemetry_bit_cycles;
+
+    int      motor_index(int pin);
+    uint16_t compare_value(const Motor & motor, uint16_t high);
+    bool     decode_telemetry(Motor & motor);
+
+    static void dma_isr_0();
+    static void dma_isr_1();
+    static void dma_isr_2();
+    static void dma_isr_3();
+    static void dma_complete(int idx);
+
+    static void edge_isr_0();
+    static void edge_isr_1();
+    static void edge_isr_2();
+    static void edge_isr_3();
+    static void edge_capture(int idx);
+};
+
+#if __DSHOT__
+  DShot dshot;
+#else
+  extern DShot dshot;
+#endif
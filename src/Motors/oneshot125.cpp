@@ -0,0 +1,35 @@
+// OneShot125 Hardware Motor Output for the dRehmFlight Flight Control Software
+//
+// GPL 3.0
+
+#include "Arduino.h"
+
+#define __ONESHOT125__ 1
+#include "oneshot125.h"
+
+void
+OneShot125::attach(int pin)
+{
+  analogWriteFrequency(pin, FREQUENCY);
+
+  // No pulse at all until the first command is received from the main loop
+
+  write(pin, 0);
+}
+
+void
+OneShot125::write(int pin, int pulse_us)
+{
+  if (pulse_us < 0) pulse_us = 0;
+
+  uint32_t duty = (((uint64_t) pulse_us * FREQUENCY) << RESOLUTION) / 1000000UL;
+
+  // The analogWrite() resolution is shared with other libraries (PWMServo), so it
+  // is restored once the duty cycle has been latched.
+
+  noInterrupts();
+  uint32_t old_resolution = analogWriteResolution(RESOLUTION);
+  analogWrite(pin, duty);
+  analogWriteResolution(old_resolution);
+  interrupts();
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+// OneShot125 Hardware Motor Output for the dRehmFlight Flight Control Software
+//
+// The 125..250us OneShot125 pulses are generated by the i.MX RT1062 FlexPWM/QuadTimer
+// module attached to each motor pin (through the Teensy core analogWrite() support).
+// write() only computes the new duty cycle and latches it in the timer registers. The
+// new pulse length is used by the hardware from the start of the next PWM period, so
+// the call returns immediately and the pulse width has no software jitter.
+//
+// GPL 3.0
+
+#include <cinttypes>
+
+class OneShot125
+{
+  public:
+    static const int FREQUENCY  = 2000; // Pulses per second, period must leave room for a 250us pulse
+    static const int RESOLUTION =   15; // analogWrite() resolution in bits (~15ns steps at 2kHz)
+
+    OneShot125() { }
+   ~OneShot125() { }
+
+    void attach(int pin);
+    void write(int pin, int pulse_us);
+};
+
+#if __ONESHOT125__
+  OneShot125 oneshot125;
+#else
+  extern OneShot125 oneshot125;
+#endif
@@ -0,0 +1,129 @@
+// Loop Stages Profiler for the dRehmFlight Flight Control Software
+//
+// GPL 3.0
+
+#include "Arduino.h"
+
+#include "../Console/console.h"
+
+#define __PROFILER__ 1
+#include "profiler.h"
+
+static const char * stage_names[] = {
+  "getIMUdata",
+  "Madgwick",
+  "getDesState",
+  "Controller",
+  "controlMixer",
+  "scaleCommands",
+  "commandMotors",
+  "commandServos",
+  "getCommands",
+  "USB Output",
+  "Control Loop"
+};
+
+void
+Profiler::setup()
+{
+  // The cycle counter is normally started by the Teensy core, make sure of it
+
+  ARM_DEMCR     |= ARM_DEMCR_TRCENA;
+  ARM_DWT_CTRL  |= ARM_DWT_CTRL_CYCCNTENA;
+
+  reset();
+}
+
+void
+Profiler::reset()
+{
+  for (int i = 0; i < (int) ProfileStage::COUNT; i++) {
+    StageStats & s = stats[i];
+    s.count = 0;
+    s.min   = UINT32_MAX;
+    s.max   = 0;
+    s.sum   = 0;
+    memset(s.histogram, 0, sizeof(s.histogram));
+  }
+}
+
+int
+Profiler::bucket_of(uint32_t cycles)
+{
+  // Values 0..3 get their own bucket. Above, each octave is split in 4 equal buckets.
+
+  if (cycles < BUCKETS_PER_OCTAVE) return cycles;
+
+  int msb    = 31 - __builtin_clz(cycles);
+  int bucket = ((msb - 1) * BUCKETS_PER_OCTAVE) + ((cycles >> (msb - 2)) & (BUCKETS_PER_OCTAVE - 1));
+
+  return (bucket < BUCKET_COUNT) ? bucket : BUCKET_COUNT - 1;
+}
+
+uint32_t
+Profiler::bucket_limit(int bucket)
+{
+  // Upper bound (exclusive) of a bucket, in cycles
+
+  bucket++;
+  if (bucket < BUCKETS_PER_OCTAVE) return bucket;
+
+  int msb = (bucket / BUCKETS_PER_OCTAVE) + 1;
+  int sub =  bucket % BUCKETS_PER_OCTAVE;
+
+  return (uint32_t) (BUCKETS_PER_OCTAVE + sub) << (msb - 2);
+}
+
+void
+Profiler::record(ProfileStage stage, uint32_t cycles)
+{
+  StageStats & s = stats[(int) stage];
+
+  s.count++;
+  s.sum += cycles;
+  if (cycles < s.min) s.min = cycles;
+  if (cycles > s.max) s.max = cycles;
+  s.histogram[bucket_of(cycles)]++;
+}
+
+uint32_t
+Profiler::percentile(const StageStats & s, int pct)
+{
+  uint32_t target = ((uint64_t) s.count * pct + 99) / 100;
+  uint32_t total  = 0;
+
+  for (int i = 0; i < BUCKET_COUNT; i++) {
+    total += s.histogram[i];
+    if (total >= target) {
+      uint32_t limit = bucket_limit(i);
+      return (limit < s.max) ? limit : s.max;
+    }
+  }
+
+  return s.max;
+}
+
+void
+Profiler::show()
+{
+  const float cycles_per_us = F_CPU_ACTUAL / 1000000.0;
+
+  console.printf(F("\n%-14s %10s %9s %9s %9s %9s\n"), "Stage", "Count", "Min(us)", "Avg(us)", "Max(us)", "P99(us)");
+
+  for (int i = 0; i < (int) ProfileStage::COUNT; i++) {
+    const StageStats & s = stats[i];
+
+    if (s.count == 0) {
+      console.printf(F("%-14s %10s\n"), stage_names[i], "-");
+    }
+    else {
+      console.printf(F("%-14s %10lu %9.2f %9.2f %9.2f %9.2f\n"),
+                    stage_names[i],
+                    s.count,
+                    s.min / cycles_per_us,
+                    (float) s.sum / s.count / cycles_per_us,
+                    s.max / cycles_per_us,
+                    percentile(s, 99) / cycles_per_us);
+    }
+  }
+}
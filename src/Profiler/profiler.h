@@ -0,0 +1,68 @@
+#pragma once
+
+// Loop Stages Profiler for the dRehmFlight Flight Control Software
+//
+// Every instrumented stage of the main loop is timed with the Cortex-M7 DWT cycle counter.
+// For each stage, min/max/sum and a logarithmic histogram (4 buckets per octave) are kept in
+// RAM, from which the average and the 99th percentile are computed when the report is shown.
+//
+// GPL 3.0
+
+#include <cinttypes>
+
+#include "Arduino.h"
+
+#ifndef PROFILING
+  #define PROFILING 1
+#endif
+
+enum class ProfileStage : uint8_t {
+  IMU, FUSION, DES_STATE, CONTROL, MIXER, SCALE, MOTORS, SERVOS, RADIO, PRINT, LOOP, COUNT
+};
+
+class Profiler
+{
+  public:
+    static const int BUCKETS_PER_OCTAVE = 4;
+    static const int OCTAVES            = 26; // Up to 2^26 cycles (~110ms at 600MHz)
+    static const int BUCKET_COUNT       = OCTAVES * BUCKETS_PER_OCTAVE;
+
+    Profiler() { reset(); }
+   ~Profiler() { }
+
+    void setup();
+    void reset();
+    void show();
+
+    inline uint32_t start() { return ARM_DWT_CYCCNT; }
+    inline void     stop(ProfileStage stage, uint32_t start_cycles) { record(stage, ARM_DWT_CYCCNT - start_cycles); }
+
+    void record(ProfileStage stage, uint32_t cycles);
+
+  private:
+    struct StageStats {
+      uint32_t count;
+      uint32_t min;
+      uint32_t max;
+      uint64_t sum;
+      uint32_t histogram[BUCKET_COUNT];
+    };
+
+    StageStats stats[(int) ProfileStage::COUNT];
+
+    static int      bucket_of(uint32_t cycles);
+    static uint32_t bucket_limit(int bucket);
+    uint32_t        percentile(const StageStats & s, int pct);
+};
+
+#if PROFILING
+  #define PROFILE(stage, statement) { uint32_t _prof_start = profiler.start(); statement; profiler.stop(stage, _prof_start); }
+#else
+  #define PROFILE(stage, statement) { statement; }
+#endif
+
+#if __PROFILER__
+  Profiler profiler;
+#else
+  extern Profiler profiler;
+#endif
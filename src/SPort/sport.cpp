@@ -0,0 +1,192 @@
+// FrSky S.Port (Smart Port) Telemetry Sensor for the dRehmFlight Flight Control Software
+//
+// GPL 3.0
+
+#include <cstring>
+
+#include "Arduino.h"
+
+#include "../Console/console.h"
+
+#define __SPORT__ 1
+#include "sport.h"
+
+#define START_BYTE    0x7E
+#define STUFF_BYTE    0x7D
+#define STUFF_XOR     0x20
+#define DATA_FRAME    0x10
+
+#define UART_CLOCK    24000000  // LPUART clock set by the Teensy core (24MHz oscillator)
+
+// RXINV is a configuration bit of the STAT register, kept by every write clearing a flag
+
+#define STAT_CONFIG   LPUART_STAT_RXINV
+#define CTRL_IDLE     (LPUART_CTRL_LOOPS | LPUART_CTRL_RSRC | LPUART_CTRL_TXINV | LPUART_CTRL_TE | \
+                       LPUART_CTRL_RE | LPUART_CTRL_RIE)
+#define CTRL_SENDING  (LPUART_CTRL_LOOPS | LPUART_CTRL_RSRC | LPUART_CTRL_TXINV | LPUART_CTRL_TE | \
+                       LPUART_CTRL_TXDIR | LPUART_CTRL_TIE)
+
+void
+SPort::setup(uint8_t id)
+{
+  physical_id = id;
+
+  // Oversampling ratio (4 to 32) giving the closest baud rate
+
+  uint32_t best_osr = 16, best_sbr = 1, best_error = UINT32_MAX;
+
+  for (uint32_t osr = 4; osr <= 32; osr++) {
+    uint32_t sbr = (UART_CLOCK + (BAUD_RATE * osr / 2)) / (BAUD_RATE * osr);
+    if ((sbr == 0) || (sbr > 8191)) continue;
+    uint32_t baud  = UART_CLOCK / (sbr * osr);
+    uint32_t error = (baud > BAUD_RATE) ? baud - BAUD_RATE : BAUD_RATE - baud;
+    if (error < best_error) {
+      best_error = error;
+      best_osr   = osr;
+      best_sbr   = sbr;
+    }
+  }
+
+  CCM_CCGR5 |= CCM_CCGR5_LPUART7(CCM_CCGR_ON);
+
+  // Pin 29 (GPIO_EMC_31) as LPUART7_TX, read back by the receiver in single wire mode (SION).
+  // The pull-down keeps the inverted line idle while no one drives it.
+
+  IOMUXC_SW_MUX_CTL_PAD_GPIO_EMC_31 = 2 | 0x10;
+  IOMUXC_SW_PAD_CTL_PAD_GPIO_EMC_31 = IOMUXC_PAD_SRE | IOMUXC_PAD_DSE(3) | IOMUXC_PAD_SPEED(3) |
+                                      IOMUXC_PAD_PKE | IOMUXC_PAD_PUE | IOMUXC_PAD_PUS(0);
+  IOMUXC_LPUART7_TX_SELECT_INPUT    = 1;
+
+  LPUART7_CTRL = 0;
+  LPUART7_BAUD = LPUART_BAUD_OSR(best_osr - 1) | LPUART_BAUD_SBR(best_sbr) |
+                 ((best_osr < 8) ? LPUART_BAUD_BOTHEDGE : 0);
+  LPUART7_FIFO = 0;                     // One interrupt per byte, the poll is answered on its last byte
+  LPUART7_STAT = STAT_CONFIG | LPUART_STAT_OR | LPUART_STAT_NF | LPUART_STAT_FE | LPUART_STAT_PF;
+
+  attachInterruptVector(IRQ_LPUART7, isr);
+  NVIC_SET_PRIORITY(IRQ_LPUART7, 64);
+  NVIC_ENABLE_IRQ(IRQ_LPUART7);
+
+  LPUART7_CTRL = CTRL_IDLE;
+}
+
+void
+SPort::set_value(uint16_t data_id, int32_t value)
+{
+  uint8_t index;
+
+  for (index = 0; index < count; index++) {
+    if (values[index].data_id == data_id) break;
+  }
+  if (index >= MAX_VALUES) return;
+
+  Value  & v    = values[index];
+  bool     add  = index == count;
+  uint8_t  buf  = add ? 0 : v.current ^ 1;
+
+  uint8_t raw[7] = { (uint8_t) data_id, (uint8_t) (data_id >> 8),
+                     (uint8_t) value, (uint8_t) (value >> 8), (uint8_t) (value >> 16), (uint8_t) (value >> 24) };
+
+  // Checksum: sum of the bytes after 0x7E, carries folded back, complemented
+
+  uint16_t crc = DATA_FRAME;
+  for (int i = 0; i < 6; i++) {
+    crc += raw[i];
+    crc  = (crc + (crc >> 8)) & 0xFF;
+  }
+  raw[6] = 0xFF - crc;
+
+  uint8_t * frame = v.frame[buf];
+  uint8_t   len   = 0;
+
+  frame[len++] = DATA_FRAME;
+  for (int i = 0; i < 7; i++) {
+    if ((raw[i] == START_BYTE) || (raw[i] == STUFF_BYTE)) {
+      frame[len++] = STUFF_BYTE;
+      frame[len++] = raw[i] ^ STUFF_XOR;
+    }
+    else {
+      frame[len++] = raw[i];
+    }
+  }
+  v.length[buf] = len;
+
+  // Published once complete: the interrupt only reads the current frame of the first count values
+
+  if (add) {
+    v.data_id = data_id;
+    v.current = 0;
+    count     = count + 1;
+  }
+  else {
+    v.current = buf;
+  }
+}
+
+void
+SPort::reply()
+{
+  if (count == 0) return;
+
+  if (next >= count) next = 0;
+
+  Value   & v   = values[next++];
+  uint8_t   buf = v.current;
+
+  tx_length = v.length[buf];
+  memcpy(tx_buffer, v.frame[buf], tx_length);
+
+  // Receiver off while driving the line, the first byte is sent right away
+
+  LPUART7_CTRL = CTRL_SENDING;
+  LPUART7_DATA = tx_buffer[0];
+  tx_pos       = 1;
+  replies++;
+}
+
+void
+SPort::isr()
+{
+  uint32_t stat = LPUART7_STAT;
+  uint32_t ctrl = LPUART7_CTRL;
+
+  if (stat & LPUART_STAT_OR) {
+    LPUART7_STAT = STAT_CONFIG | LPUART_STAT_OR;
+    sport.overruns++;
+  }
+
+  if ((ctrl & LPUART_CTRL_RE) && (stat & LPUART_STAT_RDRF)) {
+    uint8_t c = LPUART7_DATA;
+
+    if (c == START_BYTE) {
+      sport.after_start = true;
+    }
+    else if (sport.after_start) {
+      sport.after_start = false;
+      if (c == sport.physical_id) {
+        sport.polls++;
+        sport.reply();
+      }
+    }
+  }
+  else if ((ctrl & LPUART_CTRL_TIE) && (stat & LPUART_STAT_TDRE)) {
+    if (sport.tx_pos < sport.tx_length) {
+      LPUART7_DATA = sport.tx_buffer[sport.tx_pos++];
+    }
+    else {
+      LPUART7_CTRL = (ctrl & ~LPUART_CTRL_TIE) | LPUART_CTRL_TCIE;  // Wait for the last stop bit
+    }
+  }
+  else if ((ctrl & LPUART_CTRL_TCIE) && (stat & LPUART_STAT_TC)) {
+    LPUART7_CTRL = CTRL_IDLE;                                         // Line released, listening again
+  }
+
+  asm volatile ("dsb");
+}
+
+void
+SPort::show_stats()
+{
+  console.printf(F("S.Port: %lu polls, %lu replies, %lu overruns, %u values\n"),
+                polls, replies, overruns, count);
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+// FrSky S.Port (Smart Port) Telemetry Sensor for the dRehmFlight Flight Control Software
+//
+// Emulates one S.Port sensor on LPUART7 (Serial7 TX pin 29, wired to the receiver S.Port pin),
+// 57600 baud, inverted signal, single wire half-duplex. The receiver polls every sensor ID in
+// turn with 0x7E <physical ID>; the sensor must answer its own ID right away with an 8 bytes
+// data frame (0x10, data ID, 32 bits value, checksum).
+//
+// Everything on the wire is done by the LPUART7 interrupt: the poll is recognized on the
+// received byte and the reply starts from the same interrupt, from frames serialized (byte
+// stuffing and checksum included) beforehand by set_value(). Each value has two frame buffers:
+// set_value() writes the one not in use and then flips the index, the interrupt copies the
+// current one. The main loop never touches the UART.
+//
+// One value is sent per poll, in turn. A value is answered from its first set_value() on.
+//
+// GPL 3.0
+
+#include <cinttypes>
+
+#include "Arduino.h"
+
+class SPort
+{
+  public:
+    static const uint8_t  MAX_VALUES   = 12;
+    static const uint8_t  FRAME_SIZE   = 16;      // 0x10 + 7 bytes, each one stuffed at worst
+    static const uint32_t BAUD_RATE    = 57600;
+    static const uint8_t  SENSOR_ID    = 0x1B;    // Physical ID byte (ID 28, with its check bits)
+
+    // Data IDs. The 0x5100 - 0x52FF DIY range shows up as new sensors in OpenTX/EdgeTX
+
+    enum DataId : uint16_t {
+      CURRENT   = 0x0200,    // Battery current, 0.1A
+      VFAS      = 0x0210,    // Battery voltage, 0.01V
+      FUEL      = 0x0600,    // Battery capacity left, percent
+      ROLL      = 0x5100,    // 0.1 degree
+      PITCH     = 0x5101,    // 0.1 degree
+      YAW       = 0x5102,    // 0.1 degree
+      VTOL_MODE = 0x5110,    // VtolMode value
+      LOOP_RATE = 0x5111,    // Hz
+      FAILSAFE  = 0x5112     // Flags
+    };
+
+    SPort() : count(0), next(0), after_start(false), tx_length(0), tx_pos(0),
+              polls(0), replies(0), overruns(0) { }
+   ~SPort() { }
+
+    void setup(uint8_t physical_id = SENSOR_ID);
+    void set_value(uint16_t data_id, int32_t value);
+
+    void show_stats();
+
+  private:
+    struct Value {
+      uint16_t         data_id;
+      uint8_t          frame[2][FRAME_SIZE];
+      uint8_t          length[2];
+      volatile uint8_t current;                   // Frame buffer the interrupt sends
+    };
+
+    Value             values[MAX_VALUES];
+    volatile uint8_t  count;
+    uint8_t           next;
+    uint8_t           physical_id;
+
+    bool              after_start;
+    uint8_t           tx_buffer[FRAME_SIZE];
+    uint8_t           tx_length;
+    uint8_t           tx_pos;
+
+    volatile uint32_t polls;
+    volatile uint32_t replies;
+    volatile uint32_t overruns;
+
+    void reply();
+
+    static void isr();
+};
+
+#if __SPORT__
+  SPort sport;
+#else
+  extern SPort sport;
+#endif
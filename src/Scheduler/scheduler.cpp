@@ -0,0 +1,116 @@
+// Cooperative Multi-Rate Task Scheduler for the dRehmFlight Flight Control Software
+//
+// GPL 3.0
+
+#include "Arduino.h"
+
+#include "../Console/console.h"
+
+#define __SCHEDULER__ 1
+#include "scheduler.h"
+
+bool
+Scheduler::add_task(const char * name, TaskFunction function, uint32_t period, uint8_t priority, uint32_t deadline)
+{
+  if (task_count >= MAX_TASKS) return false;
+
+  // Insert the task in priority order. Tasks of the same priority keep their registration order.
+
+  int idx = task_count;
+  while ((idx > 0) && (tasks[idx - 1].priority > priority)) {
+    tasks[idx] = tasks[idx - 1];
+    idx--;
+  }
+
+  Task & task = tasks[idx];
+
+  task.name           = name;
+  task.function       = function;
+  task.period         = period;
+  task.priority       = priority;
+  task.deadline       = deadline;
+  task.next_run       = micros();
+  task.last_runtime   = 0;
+  task.avg_runtime    = 0;
+  task.max_runtime    = 0;
+  task.run_count      = 0;
+  task.deferred_count = 0;
+  task.late_count     = 0;
+
+  task_count++;
+
+  return true;
+}
+
+void
+Scheduler::run(uint32_t slack_end)
+{
+  uint32_t now = micros();
+
+  for (int i = 0; i < task_count; i++) {
+    Task & task = tasks[i];
+
+    int32_t lateness = (int32_t) (now - task.next_run);
+    if (lateness < 0) continue; // Not due yet
+
+    int32_t slack = (int32_t) (slack_end - now);
+    bool    late  = (uint32_t) lateness >= task.deadline;
+
+    if (!late && ((int32_t) task.avg_runtime > slack)) {
+      task.deferred_count++;
+      continue;
+    }
+
+    if (late) task.late_count++;
+
+    task.function();
+
+    uint32_t end = micros();
+
+    task.last_runtime = end - now;
+    task.avg_runtime  = (task.run_count == 0) ? task.last_runtime : ((task.avg_runtime * 7) + task.last_runtime) >> 3;
+    if (task.last_runtime > task.max_runtime) task.max_runtime = task.last_runtime;
+    task.run_count++;
+
+    // Keep the task phase-locked on its period, but don't try to catch up on missed runs
+
+    task.next_run += task.period;
+    if ((int32_t) (end - task.next_run) >= 0) task.next_run = end + task.period;
+
+    now = end;
+  }
+}
+
+void
+Scheduler::reset_stats()
+{
+  // run_count and avg_runtime are kept: the average is the slack estimate of the task, and a
+  // zero run_count would restart it from the last run only
+
+  for (int i = 0; i < task_count; i++) {
+    tasks[i].max_runtime    = 0;
+    tasks[i].deferred_count = 0;
+    tasks[i].late_count     = 0;
+  }
+}
+
+void
+Scheduler::show_stats()
+{
+  console.printf(F("\n%-12s %4s %8s %8s %8s %8s %10s %8s %8s\n"),
+                "Task", "Prio", "Period", "Deadline", "Avg(us)", "Max(us)", "Runs", "Deferred", "Late");
+
+  for (int i = 0; i < task_count; i++) {
+    const Task & task = tasks[i];
+    console.printf(F("%-12s %4u %8lu %8lu %8lu %8lu %10lu %8lu %8lu\n"),
+                  task.name,
+                  task.priority,
+                  task.period,
+                  task.deadline,
+                  task.avg_runtime,
+                  task.max_runtime,
+                  task.run_count,
+                  task.deferred_count,
+                  task.late_count);
+  }
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+// Cooperative Multi-Rate Task Scheduler for the dRehmFlight Flight Control Software
+//
+// The flight control chain (IMU, fusion, PID, mixer, actuators) is run by loop() on every
+// iteration. All other activities are registered here as tasks with their own period. They are
+// run in priority order in the slack time left before the next control iteration. A task that
+// would not fit in the remaining slack is deferred, unless it is already late by more than its
+// deadline, in which case it is run anyway.
+//
+// GPL 3.0
+
+#include <cinttypes>
+
+typedef void (* TaskFunction)();
+
+struct Task {
+  const char   * name;
+  TaskFunction   function;
+  uint32_t       period;         // Time between two runs (microseconds)
+  uint8_t        priority;       // 0 is the highest priority
+  uint32_t       deadline;       // Allowed lateness before the task is forced to run (microseconds)
+  uint32_t       next_run;       // micros() value at which the task is due
+  uint32_t       last_runtime;   // Measured execution time of the last run (microseconds)
+  uint32_t       avg_runtime;    // Average execution time, used to check if the task fits in the slack
+  uint32_t       max_runtime;
+  uint32_t       run_count;
+  uint32_t       deferred_count; // Number of times the task was due but postponed for lack of slack
+  uint32_t       late_count;     // Number of runs started after their deadline
+};
+
+class Scheduler
+{
+  public:
+    static const int MAX_TASKS = 8;
+
+    Scheduler() : task_count(0) { }
+   ~Scheduler() { }
+
+    bool add_task(const char * name, TaskFunction function, uint32_t period, uint8_t priority, uint32_t deadline);
+    void run(uint32_t slack_end);
+    void reset_stats();
+    void show_stats();
+
+    inline int          get_task_count()     const { return task_count; }
+    inline const Task & get_task(int idx)    const { return tasks[idx]; }
+
+  private:
+    Task tasks[MAX_TASKS]; // Kept sorted by priority
+    int  task_count;
+};
+
+#if __SCHEDULER__
+  Scheduler scheduler;
+#else
+  extern Scheduler scheduler;
+#endif
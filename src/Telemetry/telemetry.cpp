@@ -0,0 +1,209 @@
+// Telemetry Streams for the dRehmFlight Flight Control Software
+//
+// GPL 3.0
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#include "../Console/console.h"
+
+#define __TELEMETRY__ 1
+#include "telemetry.h"
+
+static const char * group_names[] = {
+  "gyro", "accel", "mag", "attitude", "quaternion", "des_state", "pid", "motors", "servos", "radio", "loop"
+};
+
+static_assert(sizeof(group_names) / sizeof(group_names[0]) == (int) TelemetryGroup::COUNT,
+              "group_names[] must follow TelemetryGroup");
+
+bool
+Telemetry::add(const char * name, TelemetryGroup group, const void * value, Type type)
+{
+  if (field_count >= MAX_FIELDS) return false;
+
+  fields[field_count++] = { name, value, group, type };
+
+  return true;
+}
+
+bool Telemetry::add_field(const char * name, TelemetryGroup group, const float         * value) { return add(name, group, value, Type::FLOAT);  }
+bool Telemetry::add_field(const char * name, TelemetryGroup group, const int           * value) { return add(name, group, value, Type::INT32);  }
+bool Telemetry::add_field(const char * name, TelemetryGroup group, const unsigned long * value) { return add(name, group, value, Type::UINT32); }
+
+void
+Telemetry::set_stream(int stream, uint32_t rate_hz, uint32_t group_mask)
+{
+  uint64_t field_mask = 0;
+
+  for (int i = 0; i < field_count; i++) {
+    if (group_mask & (1UL << (int) fields[i].group)) field_mask |= 1ULL << i;
+  }
+
+  set_stream_fields(stream, rate_hz, field_mask);
+}
+
+void
+Telemetry::set_stream_fields(int stream, uint32_t rate_hz, uint64_t field_mask)
+{
+  if ((stream < 0) || (stream >= MAX_STREAMS)) return;
+
+  Stream & s = streams[stream];
+
+  if ((rate_hz == 0) || (field_mask == 0)) {
+    s.period = 0;
+    return;
+  }
+
+  s.fields   = field_mask;
+  s.period   = 1000000UL / min(rate_hz, (uint32_t) MAX_RATE);
+  s.next_run = micros();
+  s.announce = true;
+}
+
+void
+Telemetry::run()
+{
+  uint32_t now = micros();
+
+  for (int i = 0; i < MAX_STREAMS; i++) {
+    Stream & s = streams[i];
+
+    if ((s.period == 0) || ((int32_t) (now - s.next_run) < 0)) continue;
+
+    send(i);
+
+    // No catching up: a stream late by more than one period skips the missed lines
+    s.next_run += s.period;
+    if ((int32_t) (now - s.next_run) >= 0) s.next_run = now + s.period;
+  }
+}
+
+void
+Telemetry::send(int stream)
+{
+  // The whole line is built, then written at once
+
+  static char line[MAX_FIELDS * 14 + 8];
+
+  Stream & s   = streams[stream];
+  int      len = 0;
+
+  if (s.announce) {
+    len = snprintf(line, sizeof(line), "S%d:", stream);
+    for (int i = 0; i < field_count; i++) {
+      if (s.fields & (1ULL << i)) len += snprintf(line + len, sizeof(line) - len, "%s,", fields[i].name);
+    }
+    line[len - 1] = '\n';
+    console.write((const uint8_t *) line, len);
+    s.announce = false;
+  }
+
+  len = snprintf(line, sizeof(line), "S%d", stream);
+
+  for (int i = 0; i < field_count; i++) {
+    if (!(s.fields & (1ULL << i))) continue;
+
+    const Field & f = fields[i];
+    line[len++] = ',';
+
+    switch (f.type) {
+      case Type::FLOAT: {
+        // Fixed point, 3 decimals: much faster than printf("%f"). Clamped to +-2e6 so that the
+        // conversion stays in the int32_t range, NaN is sent as "nan".
+        float v = *(const float *) f.value;
+        if (std::isnan(v)) {
+          memcpy(line + len, "nan", 3);
+          len += 3;
+          break;
+        }
+        v = (v > 2.0e6f) ? 2.0e6f : ((v < -2.0e6f) ? -2.0e6f : v);
+        int32_t m = (int32_t) (v * 1000.0f + (v < 0 ? -0.5f : 0.5f));
+        if (m < 0) { line[len++] = '-'; m = -m; }
+        len += snprintf(line + len, sizeof(line) - len, "%ld.%03ld", m / 1000, m % 1000);
+        break;
+      }
+      case Type::INT32:
+        len += snprintf(line + len, sizeof(line) - len, "%d",  *(const int *) f.value);
+        break;
+      case Type::UINT32:
+        len += snprintf(line + len, sizeof(line) - len, "%lu", *(const unsigned long *) f.value);
+        break;
+    }
+  }
+
+  line[len++] = '\n';
+  console.write((const uint8_t *) line, len);
+}
+
+void
+Telemetry::execute(char * cmd)
+{
+  if (cmd[0] != 't') return;
+
+  if (cmd[1] == 0) {
+    show();
+    return;
+  }
+
+  // t<n> <rate> <name> <name>...
+
+  char   * p      = nullptr;
+  int      stream = strtol(cmd + 1, &p, 10);
+
+  if ((p == cmd + 1) || (stream < 0) || (stream >= MAX_STREAMS)) {
+    console.printf(F("Telemetry: stream number expected, 0 to %d: %s\n"), MAX_STREAMS - 1, cmd);
+    return;
+  }
+
+  uint32_t rate   = strtoul(p, &p, 10);
+  uint64_t mask   = 0;
+
+  for (char * name = strtok(p, " ,"); name; name = strtok(nullptr, " ,")) {
+    bool found = false;
+    for (int g = 0; g < (int) TelemetryGroup::COUNT; g++) {
+      if (strcmp(name, group_names[g]) == 0) {
+        for (int i = 0; i < field_count; i++) {
+          if ((int) fields[i].group == g) mask |= 1ULL << i;
+        }
+        found = true;
+      }
+    }
+    for (int i = 0; i < field_count; i++) {
+      if (strcmp(name, fields[i].name) == 0) {
+        mask |= 1ULL << i;
+        found = true;
+      }
+    }
+    if (!found) {
+      console.printf(F("Telemetry: unknown field or group: %s\n"), name);
+      return;
+    }
+  }
+
+  set_stream_fields(stream, rate, mask);
+}
+
+void
+Telemetry::show()
+{
+  console.println(F("Telemetry groups (Config mask bit: name: fields):"));
+  for (int g = 0; g < (int) TelemetryGroup::COUNT; g++) {
+    console.printf(F("  %2d: %-10s:"), g, group_names[g]);
+    for (int i = 0; i < field_count; i++) {
+      if ((int) fields[i].group == g) console.printf(F(" %s"), fields[i].name);
+    }
+    console.println();
+  }
+
+  for (int i = 0; i < MAX_STREAMS; i++) {
+    if (streams[i].period == 0) {
+      console.printf(F("Stream %d: off\n"), i);
+    }
+    else {
+      console.printf(F("Stream %d: %lu Hz, %d fields\n"), i, 1000000UL / streams[i].period,
+                    __builtin_popcountll(streams[i].fields));
+    }
+  }
+}
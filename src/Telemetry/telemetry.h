@@ -0,0 +1,78 @@
+#pragma once
+
+// Telemetry Streams for the dRehmFlight Flight Control Software
+//
+// The flight variables that can be sent over USB are registered once with add_field(), in
+// groups (gyro, attitude, PID, ...). Up to MAX_STREAMS streams run at the same time, each one
+// sending its own set of fields at its own rate. A stream line is "S<n>,<value>,<value>,...",
+// preceded by a "S<n>:<name>,<name>,..." line when the stream is (re)configured.
+//
+// run() is called by a scheduler task: the lines are built and sent in the loop slack time,
+// after the flight control chain, one line per due stream at most. The runtime commands
+// received on the USB port are read by the Config command line and handed to execute():
+//
+//   t                          list the fields, groups and streams
+//   t<n> <rate> <names>        stream n at rate Hz with the fields or groups named (0 Hz: off)
+//
+// GPL 3.0
+
+#include <cinttypes>
+
+#include "Arduino.h"
+
+enum class TelemetryGroup : uint8_t {
+  GYRO, ACCEL, MAG, ATTITUDE, QUATERNION, DES_STATE, PID, MOTORS, SERVOS, RADIO, LOOP, COUNT
+};
+
+class Telemetry
+{
+  public:
+    static const int MAX_FIELDS  = 64;
+    static const int MAX_STREAMS = 4;
+    static const int MAX_RATE    = 1000;   // Hz, the rate of the scheduler task calling run()
+
+    enum class Type : uint8_t { FLOAT, INT32, UINT32 };
+
+    Telemetry() : field_count(0) { }
+   ~Telemetry() { }
+
+    bool add_field(const char * name, TelemetryGroup group, const float         * value);
+    bool add_field(const char * name, TelemetryGroup group, const int           * value);
+    bool add_field(const char * name, TelemetryGroup group, const unsigned long * value);
+
+    // Field set from a bit mask of groups (bit n: TelemetryGroup n), as kept by the Config class
+
+    void set_stream(int stream, uint32_t rate_hz, uint32_t group_mask);
+    void run();
+    void show();
+    void execute(char * cmd);
+
+  private:
+    struct Field {
+      const char     * name;
+      const void     * value;
+      TelemetryGroup   group;
+      Type             type;
+    };
+
+    struct Stream {
+      uint64_t fields;       // Bit n: fields[n]
+      uint32_t period;       // Microseconds, 0: stream off
+      uint32_t next_run;
+      bool     announce;     // Send the field names line first
+    };
+
+    Field    fields[MAX_FIELDS];
+    int      field_count;
+    Stream   streams[MAX_STREAMS] = {};
+
+    bool add(const char * name, TelemetryGroup group, const void * value, Type type);
+    void set_stream_fields(int stream, uint32_t rate_hz, uint64_t field_mask);
+    void send(int stream);
+};
+
+#if __TELEMETRY__
+  Telemetry telemetry;
+#else
+  extern Telemetry telemetry;
+#endif
@@ -0,0 +1,50 @@
+#pragma once
+
+// TelemetryViewer Binary Packets for the dRehmFlight Flight Control Software
+//
+// Packet layout for the TelemetryViewer "Binary" packet type: a 0xAA sync word, the float32 values
+// (little endian, as stored by the Cortex-M7, so they are copied without any conversion) and a
+// "uint16 Checksum LSB First": the sum of the payload taken as little endian 16 bits words. The
+// values are put directly in the packet buffer, no text formatting is done. The matching
+// TelemetryViewer settings are in TelemetryViewBinary.txt.
+//
+// GPL 3.0
+
+#include <cinttypes>
+#include <cstring>
+
+class TelemetryPacket
+{
+  public:
+    static const uint8_t SYNC_WORD  = 0xAA;
+    static const int     MAX_VALUES = 24;
+
+    TelemetryPacket() : count(0) { buffer[0] = SYNC_WORD; }
+   ~TelemetryPacket() { }
+
+    inline void begin() { count = 0; }
+
+    inline void add(float value) {
+      if (count < MAX_VALUES) memcpy(&buffer[1 + count++ * sizeof(float)], &value, sizeof(float));
+    }
+
+    // Appends the checksum, returns the packet size
+
+    inline int finish() {
+      int      size = count * sizeof(float);
+      uint16_t sum  = 0;
+
+      for (int i = 1; i <= size; i += 2) sum += buffer[i] | (buffer[i + 1] << 8);
+
+      buffer[1 + size] = sum & 0xFF;
+      buffer[2 + size] = sum >> 8;
+
+      return size + 3;
+    }
+
+    inline const uint8_t * get_data() const { return buffer; }
+
+  private:
+    uint8_t buffer[1 + MAX_VALUES * sizeof(float) + 2];
+    int     count;
+};
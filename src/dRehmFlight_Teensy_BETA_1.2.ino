@@ -63,6 +63,41 @@ RcGroups 'jihlein' - IMU implementation overhaul + SBUS implementation
 //#define ACCEL_8G
 //#define ACCEL_16G
 
+//Uncomment only one motor output protocol
+#define USE_ONESHOT125_PWM        //default: OneShot125 pulses generated by the FlexPWM/QuadTimer hardware
+//#define USE_ONESHOT125_BITBANG  //OneShot125 pulses generated in software, busy-waits up to 250us per loop
+//#define USE_DSHOT600            //DShot digital frames shifted out by DMA, 600kbit/s (~27us per frame)
+//#define USE_DSHOT300            //DShot, 300kbit/s (~53us per frame)
+//#define USE_DSHOT150            //DShot, 150kbit/s (~107us per frame)
+
+//Uncomment to get the motors RPM from bidirectional DShot (BLHeli_32/Bluejay ESC, DShot300 recommended) and notch it out of the gyro
+//#define USE_DSHOT_BIDIR
+
+//Uncomment to analyze the gyro spectrum in the background and place notch filters on its three main vibration peaks
+//#define USE_GYRO_FFT
+
+//Uncomment to record the flight to the Teensy 4.1 built-in SD card while armed (see blackbox_divider)
+//#define USE_BLACKBOX
+
+//Uncomment to send attitude, vtol_mode, loop rate and failsafe state to the transmitter as a FrSky S.Port sensor (receiver S.Port pin wired to pin 29)
+//#define USE_SPORT
+
+//Uncomment to pace the main loop on the IMU data-ready interrupt instead of loopRate() (IMU INT output wired to imuIntPin)
+//#define USE_IMU_DATA_READY
+
+//Uncomment to read the MPU6050 through DMA while the CPU runs the flight control chain (LPI2C1, pins 18/19)
+//#define USE_MPU6050_ASYNC
+
+//Uncomment to drain the MPU6050 gyro FIFO every loop: 4kHz gyro samples, anti-aliasing filter, decimated to the loop rate
+//#define USE_MPU6050_FIFO
+
+//Uncomment to read the MPU9250 FIFO in batches every loop: 8kHz gyro samples, anti-aliasing filter, magnetometer fused at 100Hz
+//#define USE_MPU9250_FIFO
+
+//Uncomment to take the attitude from the MPU6050 DMP quaternions (100Hz) instead of running Madgwick6DOF() on the Teensy
+//Requires GYRO_2000DPS and ACCEL_2G (DMP firmware settings), gyro and accel registers are then updated at 200Hz
+//#define USE_MPU6050_DMP
+
 
 
 //========================================================================================================================//
@@ -76,75 +111,175 @@ RcGroups 'jihlein' - IMU implementation overhaul + SBUS implementation
 #include <PWMServo.h> //commanding any extra actuators, installed with teensyduino installer
 
 #include "Config/config.h"    // GT
+#include "Config/flight_params.h"
+#include "Console/console.h"
+#include "Scheduler/scheduler.h"
+#include "Profiler/profiler.h"
+#include "Filters/biquad_bank.h"
+#include "Telemetry/telemetry_packet.h"
+#include "Telemetry/telemetry.h"
 
 #if defined USE_SBUS_RX
   #include "SBUS/SBUS.h"   //sBus interface
 #endif
 
+#if defined USE_DSHOT600
+  #define USE_DSHOT
+  #define DSHOT_RATE 600
+#elif defined USE_DSHOT300
+  #define USE_DSHOT
+  #define DSHOT_RATE 300
+#elif defined USE_DSHOT150
+  #define USE_DSHOT
+  #define DSHOT_RATE 150
+#endif
+
+#if defined USE_DSHOT
+  #include "Motors/dshot.h"
+  #define MOTOR_COMMAND_MIN  DShot::THROTTLE_MIN  //DShot throttle range is 48 - 2047
+  #define MOTOR_COMMAND_MAX  DShot::THROTTLE_MAX
+  #define MOTOR_COMMAND_STOP DShot::MOTOR_STOP    //DShot command 0: motor stopped
+#elif defined USE_ONESHOT125_PWM || defined USE_ONESHOT125_BITBANG
+  #if defined USE_ONESHOT125_PWM
+    #include "Motors/oneshot125.h"
+  #endif
+  #define MOTOR_COMMAND_MIN  125                  //OneShot125 pulse length is 125 - 250us
+  #define MOTOR_COMMAND_MAX  250
+  #define MOTOR_COMMAND_STOP 120
+#else
+  #error No motor output protocol defined...
+#endif
+
+#if defined USE_GYRO_FFT
+  #include "Filters/biquad.h"
+  #include "Filters/gyro_fft.h"
+#endif
+
+#if defined USE_BLACKBOX
+  #include "Blackbox/blackbox.h"
+  #include "Blackbox/blackbox_format.h"
+#endif
+
+#if defined USE_SPORT
+  #include "SPort/sport.h"
+#endif
+
+#if defined USE_DSHOT_BIDIR
+  #if !defined USE_DSHOT
+    #error USE_DSHOT_BIDIR requires one of USE_DSHOT600, USE_DSHOT300 or USE_DSHOT150...
+  #endif
+  #include "Filters/biquad.h"
+#endif
+
 #if defined USE_MPU6050_I2C
-  #include "MPU6050/MPU6050.h"
+  #if defined USE_MPU6050_DMP
+    #include "MPU6050/MPU6050_6Axis_MotionApps_V6_12.h" //DMP firmware image and packet decoding, this file only
+  #else
+    #include "MPU6050/MPU6050.h"
+  #endif
   MPU6050 mpu6050;
+  #if defined USE_MPU6050_ASYNC
+    #include "I2C/lpi2c_async.h"
+    #define IMU_ASYNC_TIMEOUT 400 //microseconds, a 14 bytes read takes ~190us at 1MHz
+  #endif
+  #if defined USE_MPU6050_FIFO || defined USE_MPU6050_DMP
+    #define IMU_FIFO_SIZE       1024    //bytes
+  #endif
+  #if defined USE_MPU6050_DMP
+    #if defined USE_MPU6050_ASYNC || defined USE_MPU6050_FIFO || defined USE_IMU_DATA_READY
+      #error USE_MPU6050_DMP cannot be used with USE_MPU6050_ASYNC, USE_MPU6050_FIFO or USE_IMU_DATA_READY...
+    #endif
+    #define IMU_DMP_PERIOD      10000   //microseconds, DMP quaternion output rate is 100Hz
+  #endif
+  #if defined USE_MPU9250_FIFO
+    #error USE_MPU9250_FIFO requires USE_MPU9250_SPI...
+  #endif
 #elif defined USE_MPU9250_SPI
   #include "MPU9250/MPU9250.h"
-  MPU9250 mpu9250(SPI2,36);
+  #if defined USE_MPU9250_FIFO
+    MPU9250FIFO mpu9250(SPI2,36);
+    #define IMU_MAG_PERIOD 10000 //microseconds, AK8963 100Hz output rate
+  #else
+    MPU9250 mpu9250(SPI2,36);
+  #endif
+  #if defined USE_MPU6050_ASYNC || defined USE_MPU6050_FIFO || defined USE_MPU6050_DMP
+    #error USE_MPU6050_ASYNC, USE_MPU6050_FIFO and USE_MPU6050_DMP require USE_MPU6050_I2C...
+  #endif
 #else
   #error No MPU defined... 
 #endif
 
+#if defined USE_MPU6050_FIFO || defined USE_MPU9250_FIFO
+  #define USE_IMU_FIFO
+  #if defined USE_IMU_DATA_READY || defined USE_MPU6050_ASYNC
+    #error IMU FIFO modes cannot be used with USE_IMU_DATA_READY or USE_MPU6050_ASYNC...
+  #endif
+  #include "Filters/biquad.h"
+  #if defined USE_MPU6050_FIFO
+    #define IMU_FIFO_RATE_DIV    1      //8kHz with the DLPF off, divided by 2: the FIFO is read by blocking I2C transfers
+    #define IMU_FIFO_SAMPLE_RATE 4000.0 //gyro output rate
+  #else
+    #define IMU_FIFO_SAMPLE_RATE 8000.0 //gyro output rate at 3600Hz bandwidth
+  #endif
+  #define IMU_FIFO_AA_CUTOFF    500.0 //anti-aliasing low-pass cutoff (Hz), below the Nyquist frequency of the 2kHz loop
+  #define IMU_FIFO_MAX_SAMPLES  32    //samples drained per loop, 4ms worth at 8kHz
+#endif
+
 
 
 //========================================================================================================================//
 
 
 
-//Setup gyro and accel full scale value selection and scale factor
+//Setup gyro and accel full scale value selection and scale factor, resolved at compile time by the sensor pipeline type
 
-#if defined USE_MPU6050_I2C
-  #define GYRO_FS_SEL_250    MPU6050_GYRO_FS_250
-  #define GYRO_FS_SEL_500    MPU6050_GYRO_FS_500
-  #define GYRO_FS_SEL_1000   MPU6050_GYRO_FS_1000
-  #define GYRO_FS_SEL_2000   MPU6050_GYRO_FS_2000
-  #define ACCEL_FS_SEL_2     MPU6050_ACCEL_FS_2
-  #define ACCEL_FS_SEL_4     MPU6050_ACCEL_FS_4
-  #define ACCEL_FS_SEL_8     MPU6050_ACCEL_FS_8
-  #define ACCEL_FS_SEL_16    MPU6050_ACCEL_FS_16
+#include "IMU/sensor_pipeline.h"
+
+#if defined USE_MPU6050_DMP
+  #define IMU_DRIVER IMUDriver::MPU6050_DMP
+#elif defined USE_MPU6050_I2C
+  #define IMU_DRIVER IMUDriver::MPU6050
 #elif defined USE_MPU9250_SPI
-  #define GYRO_FS_SEL_250    mpu9250.GYRO_RANGE_250DPS
-  #define GYRO_FS_SEL_500    mpu9250.GYRO_RANGE_500DPS
-  #define GYRO_FS_SEL_1000   mpu9250.GYRO_RANGE_1000DPS                                                        
-  #define GYRO_FS_SEL_2000   mpu9250.GYRO_RANGE_2000DPS
-  #define ACCEL_FS_SEL_2     mpu9250.ACCEL_RANGE_2G
-  #define ACCEL_FS_SEL_4     mpu9250.ACCEL_RANGE_4G
-  #define ACCEL_FS_SEL_8     mpu9250.ACCEL_RANGE_8G
-  #define ACCEL_FS_SEL_16    mpu9250.ACCEL_RANGE_16G
+  #define IMU_DRIVER IMUDriver::MPU9250
 #endif
-  
+
 #if defined GYRO_250DPS
-  #define GYRO_SCALE GYRO_FS_SEL_250
-  #define GYRO_SCALE_FACTOR 131.0
+  #define IMU_GYRO_RANGE IMUGyroRange::DPS_250
 #elif defined GYRO_500DPS
-  #define GYRO_SCALE GYRO_FS_SEL_500
-  #define GYRO_SCALE_FACTOR 65.5
+  #define IMU_GYRO_RANGE IMUGyroRange::DPS_500
 #elif defined GYRO_1000DPS
-  #define GYRO_SCALE GYRO_FS_SEL_1000
-  #define GYRO_SCALE_FACTOR 32.8
+  #define IMU_GYRO_RANGE IMUGyroRange::DPS_1000
 #elif defined GYRO_2000DPS
-  #define GYRO_SCALE GYRO_FS_SEL_2000
-  #define GYRO_SCALE_FACTOR 16.4
+  #define IMU_GYRO_RANGE IMUGyroRange::DPS_2000
+#else
+  #error No full scale gyro range defined...
 #endif
 
 #if defined ACCEL_2G
-  #define ACCEL_SCALE ACCEL_FS_SEL_2
-  #define ACCEL_SCALE_FACTOR 16384.0
+  #define IMU_ACCEL_RANGE IMUAccelRange::G_2
 #elif defined ACCEL_4G
-  #define ACCEL_SCALE ACCEL_FS_SEL_4
-  #define ACCEL_SCALE_FACTOR 8192.0
+  #define IMU_ACCEL_RANGE IMUAccelRange::G_4
 #elif defined ACCEL_8G
-  #define ACCEL_SCALE ACCEL_FS_SEL_8
-  #define ACCEL_SCALE_FACTOR 4096.0
+  #define IMU_ACCEL_RANGE IMUAccelRange::G_8
 #elif defined ACCEL_16G
-  #define ACCEL_SCALE ACCEL_FS_SEL_16
-  #define ACCEL_SCALE_FACTOR 2048.0
+  #define IMU_ACCEL_RANGE IMUAccelRange::G_16
+#else
+  #error No full scale accelerometer range defined...
+#endif
+
+typedef SensorPipeline<IMU_DRIVER, IMU_GYRO_RANGE, IMU_ACCEL_RANGE> IMUPipeline;
+
+//Setup IMU sample clock used when the loop is paced by the data-ready interrupt
+
+#if defined USE_IMU_DATA_READY
+  #if defined USE_MPU6050_I2C
+    #define IMU_SAMPLE_RATE_DIV   3    //8kHz gyro output rate (DLPF off) / (1 + 3) = 2kHz
+    #define IMU_SAMPLE_RATE    2000.0
+  #elif defined USE_MPU9250_SPI
+    #define IMU_SAMPLE_RATE_DIV   0    //1kHz internal rate (DLPF 184Hz) / (1 + 0) = 1kHz
+    #define IMU_SAMPLE_RATE    1000.0
+  #endif
+  #define IMU_DATA_READY_TIMEOUT 2000  //microseconds without a data-ready interrupt before the loop runs anyway
 #endif
 
 
@@ -161,95 +296,12 @@ RcGroups 'jihlein' - IMU implementation overhaul + SBUS implementation
 unsigned long USB_output    = 0; // GT No USB debugging output by default
 unsigned long receiver_only = 0; // Gt If = 1 all other functions are not being used in the loop
 
-//Radio failsafe values for every channel in the event that bad reciever data is detected. Recommended defaults:
-unsigned long     throttle_fs = 1000; //thro
-unsigned long      aileron_fs = 1500; //ail
-unsigned long     elevator_fs = 1500; //elev
-unsigned long       rudder_fs = 1500; //rudd
-unsigned long throttle_cut_fs = 1500; //gear, lower than 1600 = throttle cut
-unsigned long         aux1_fs = 2000; //aux1
-
-//Filter parameters - Defaults tuned for 2kHz loop rate; Do not touch unless you know what you are doing:
-float B_madgwick     =   0.04;  //Madgwick filter parameter
-float B_accel        =   0.14;  //Accelerometer LP filter paramter, (MPU6050 default: 0.14. MPU9250 default: 0.2)
-float B_gyro         =   0.1;   //Gyro LP filter paramter, (MPU6050 default: 0.1. MPU9250 default: 0.17)
-float B_mag          =   1.0;   //Magnetometer LP filter parameter
-
-//Magnetometer calibration parameters - if using MPU9250, uncomment calibrateMagnetometer() in void setup() to get these values, else just ignore these
-float MagErrorX      =   0.0;
-float MagErrorY      =   0.0; 
-float MagErrorZ      =   0.0;
-float MagScaleX      =   1.0;
-float MagScaleY      =   1.0;
-float MagScaleZ      =   1.0;
-
-//Controller parameters (take note of defaults before modifying!): 
-float i_limit        =  25.0;     //Integrator saturation level, mostly for safety (default 25.0)
-float maxRoll        =  30.0;     //Max roll angle in degrees for angle mode (maximum 60 degrees), deg/sec for rate mode 
-float maxPitch       =  30.0;     //Max pitch angle in degrees for angle mode (maximum 60 degrees), deg/sec for rate mode
-float maxYaw         = 160.0;     //Max yaw rate in deg/sec
-
-float Kp_roll_angle  =   0.2;     //Roll P-gain - angle mode 
-float Ki_roll_angle  =   0.3;     //Roll I-gain - angle mode
-float Kd_roll_angle  =   0.05;    //Roll D-gain - angle mode (if using controlANGLE2(), has no effect. Use B_loop_roll)
-float B_loop_roll    =   0.9;     //Roll damping term for controlANGLE2(), lower is more damping (must be between 0 to 1)
-float Kp_pitch_angle =   0.2;     //Pitch P-gain - angle mode
-float Ki_pitch_angle =   0.3;     //Pitch I-gain - angle mode
-float Kd_pitch_angle =   0.05;    //Pitch D-gain - angle mode (if using controlANGLE2(), has no effect. Use B_loop_pitch)
-float B_loop_pitch   =   0.9;     //Pitch damping term for controlANGLE2(), lower is more damping (must be between 0 to 1)
+//Saved parameters (failsafe values, filters, magnetometer and IMU offsets, blackbox, telemetry streams, controller gains
+//and mixer values): see Config/params.h, where each one is declared once with its default value and range
 
-float Kp_roll_rate   =   0.15;    //Roll P-gain - rate mode
-float Ki_roll_rate   =   0.2;     //Roll I-gain - rate mode
-float Kd_roll_rate   =   0.0002;  //Roll D-gain - rate mode (be careful when increasing too high, motors will begin to overheat!)
-float Kp_pitch_rate  =   0.15;    //Pitch P-gain - rate mode
-float Ki_pitch_rate  =   0.2;     //Pitch I-gain - rate mode
-float Kd_pitch_rate  =   0.0002;  //Pitch D-gain - rate mode (be careful when increasing too high, motors will begin to overheat!)
-
-float Kp_yaw         =   0.3;     //Yaw P-gain
-float Ki_yaw         =   0.05;    //Yaw I-gain
-float Kd_yaw         =   0.00015; //Yaw D-gain (be careful when increasing too high, motors will begin to overheat!)
-
-// Mixer Forward Flight Parameter
-
-float mx_fw_pitch_amount                    = 0.5;
-float mx_fw_roll_amount                     = 0.65;
-
-// float mx_front_pitch_amount = 0.5;
-float mx_fw_front_motor_center_offset       = 0.5;
-
-float  mx_fw_left_aileron_center_offset     = LEFT_AILERON_CENTER;
-float mx_fw_right_aileron_center_offset     = RIGHT_AILERON_CENTER;
-
-float mx_fw_right_elevator_center_offset    = RIGHT_ELEVATOR_CENTER;
-float  mx_fw_left_elevator_center_offset    = LEFT_ELEVATOR_CENTER;
-
-// Mixer Hover Flight Parameter
-
-float mx_hover_front_roll_amount            = 0.65;
-float mx_hover_front_motor_center_offset    = FRONT_MOTOR_CENTER;
-
-float mx_hover_right_elevator_center_offset = RIGHT_ELEVATOR_CENTER;
-float  mx_hover_left_elevator_center_offset = LEFT_ELEVATOR_CENTER;
-
-float  mx_hover_left_aileron_bottom_offset  = LEFT_AILERON_BOTTOM;
-float mx_hover_right_aileron_bottom_offset  = RIGHT_AILERON_BOTTOM;
-
-// Mixer Transition Flight Parameters
-
-float mx_trans_front_roll_amount            = 0.65;
-float mx_trans_front_motor_center_offset    = FRONT_MOTOR_CENTER;
-
-float  mx_trans_left_aileron_45_offset      = LEFT_AILERON_45;
-float mx_trans_right_aileron_45_offset      = RIGHT_AILERON_45;
-
-float mx_trans_right_elevator_center_offset = RIGHT_ELEVATOR_CENTER;
-float  mx_trans_left_elevator_center_offset = LEFT_ELEVATOR_CENTER;
-
-float mx_trans_pitch_rate_low               = 0.1;
-float mx_trans_pitch_rate_high              = 0.3;
-
-float mx_trans_pitch_to_over_duration       = 5.5;
-float mx_trans_pitch_to_forward_duration    = 2.5;
+//The control chain reads the controller parameters and mixer values from the flight_params snapshot of the current
+//iteration (fp.Kp_roll_angle, ...), the Config menus change flight_params.edit: see Config/flight_params.h
+float Kp_pitch_rate_faded;        //Pitch P-gain - rate mode in use: fp.Kp_pitch_rate, faded by controlMixer() in transition
 
 //========================================================================================================================//
 //                                           RX Channels Identification                                                   //                           
@@ -290,7 +342,11 @@ const int ch5Pin    = 21; //gear (throttle cut)
 const int ch6Pin    = 22; //aux1 (free aux channel)
 const int PPM_Pin   = 23;
 
-//OneShot125 ESC pin outputs:
+//IMU data-ready interrupt input (MPU6050/MPU9250 INT pin), only used with USE_IMU_DATA_READY:
+
+const int imuIntPin = 40;
+
+//OneShot125/DShot ESC pin outputs (DShot: pins 0, 1, 2, 4 and 5 only):
 
 const int leftAileronMotorPin   =  0; // Left Aileron motor
 const int frontMotorPin         =  1; // Front motor
@@ -321,9 +377,40 @@ PWMServo leftElevatorServo;
 //General stuff
 float         dt;
 unsigned long current_time,  prev_time;
-unsigned long print_counter, serial_counter;
+unsigned long serial_counter;
 unsigned long blink_counter, blink_delay;
 bool          blinkAlternate;
+bool          failSafeActive = false;             //radio commands replaced by the failsafe values
+
+#if defined USE_IMU_DATA_READY
+  volatile unsigned long imu_samples_pending = 0; //incremented by imuDataReadyISR() for every fresh IMU sample
+  unsigned long          imu_missed_interrupts = 0; //data-ready timeouts, the loop ran without a fresh sample
+#endif
+
+#if defined USE_IMU_FIFO
+  Biquad        gyro_aa_filter[3];             //anti-aliasing low-pass, run at the FIFO sample rate
+  int16_t       gyro_fifo_last[3];             //last decimated gyro sample, reused if the FIFO is empty
+  unsigned long imu_fifo_samples   = 0;        //gyro samples drained since the last stats print
+  unsigned long imu_fifo_reads     = 0;        //FIFO bursts since the last stats print
+  unsigned long imu_fifo_overflows = 0;        //FIFO resets after an overflow, samples were lost
+#endif
+
+#if defined USE_MPU9250_FIFO
+  unsigned long mag_read_time = 0;             //last magnetometer read
+  bool          mag_fresh     = false;         //a new magnetometer sample is available for the attitude fusion
+#endif
+
+#if defined USE_MPU6050_DMP
+  uint16_t      dmp_packet_size;               //bytes, as configured by dmpInitialize()
+  unsigned long dmp_packet_time    = 0;        //last quaternion read
+  unsigned long dmp_packets        = 0;        //quaternions read since the last stats print
+  unsigned long dmp_fifo_overflows = 0;        //FIFO resets after an overflow
+#endif
+
+#if defined USE_MPU6050_ASYNC
+  uint8_t       imu_async_buffer[14];          //ACCEL_XOUT_H to GYRO_ZOUT_L, filled by DMA
+  volatile bool imu_blocking_read = false;     //the Wire library owns the bus, no DMA read can be started
+#endif
 
 //Radio comm:
 unsigned long throttle_pwm,      aileron_pwm,      elevator_pwm,      rudder_pwm,     throttle_cut_pwm, aux1_pwm;
@@ -338,9 +425,7 @@ unsigned long throttle_pwm_prev, aileron_pwm_prev, elevator_pwm_prev, rudder_pwm
 
 //IMU:
 float AccX,          AccY,       AccZ;
-float AccX_prev,     AccY_prev,  AccZ_prev;
 float GyroX,         GyroY,      GyroZ;
-float GyroX_prev,    GyroY_prev, GyroZ_prev;
 float MagX,          MagY,       MagZ;
 float MagX_prev,     MagY_prev,  MagZ_prev;
 
@@ -349,6 +434,79 @@ float roll_IMU,      pitch_IMU,  yaw_IMU;
 float roll_IMU_prev, pitch_IMU_prev;
 float AccErrorX, AccErrorY, AccErrorZ, GyroErrorX, GyroErrorY, GyroErrorZ;
 
+IMUPipeline imu_pipeline; //raw samples to filtered G's and deg/sec, see setupIMUPipeline()
+
+//Biquad filter banks, see setupFilterBanks():
+BiquadBank    gyro_filter, accel_filter, dterm_filter;
+float         filter_sample_hz;                //loop rate the coefficients were computed for
+unsigned long loop_counter = 0;                //control loop iterations, to measure the loop rate
+
+//Motors RPM (bidirectional DShot telemetry) and the gyro notch filters tracking them:
+float front_motor_rpm, right_aileron_motor_rpm, left_aileron_motor_rpm;
+
+#if defined USE_DSHOT_BIDIR
+  const int RPM_NOTCH_HARMONICS = 2;                 //fundamental + 2nd harmonic of each motor
+  Biquad    rpm_notch[3][RPM_NOTCH_HARMONICS][3];    //motor, harmonic, gyro axis
+#endif
+
+#if defined USE_GYRO_FFT
+  Biquad    dyn_notch[GyroFFT::MAX_PEAKS][3];        //peak, gyro axis
+#endif
+
+#if defined USE_BLACKBOX
+  IMURawSample imu_raw;                              //last raw sensor values, as read by getIMUdata()
+
+  //Logged fields, in the order blackboxLog() fills them. The scale gives the resolution (100: 0.01 degree),
+  //the predictor what an inter frame is the difference with (see Blackbox/blackbox_format.h)
+  const BlackboxField blackbox_fields[] = {
+    { "time_us",                  1.0f, BlackboxPredictor::LINEAR   }, //micros() at the start of the iteration
+    { "loop_us",                  1.0f, BlackboxPredictor::PREVIOUS }, //dt
+    { "exec_us",                  1.0f, BlackboxPredictor::PREVIOUS }, //flight control chain execution time
+    { "vtol_mode",                1.0f, BlackboxPredictor::PREVIOUS },
+    { "flags",                    1.0f, BlackboxPredictor::PREVIOUS }, //bit 0: SBUS failsafe, bit 1: SBUS lost frame
+    { "acc_raw_x",                1.0f, BlackboxPredictor::PREVIOUS },
+    { "acc_raw_y",                1.0f, BlackboxPredictor::PREVIOUS },
+    { "acc_raw_z",                1.0f, BlackboxPredictor::PREVIOUS },
+    { "gyro_raw_x",               1.0f, BlackboxPredictor::PREVIOUS },
+    { "gyro_raw_y",               1.0f, BlackboxPredictor::PREVIOUS },
+    { "gyro_raw_z",               1.0f, BlackboxPredictor::PREVIOUS },
+    { "roll_IMU",               100.0f, BlackboxPredictor::LINEAR   },
+    { "pitch_IMU",              100.0f, BlackboxPredictor::LINEAR   },
+    { "yaw_IMU",                100.0f, BlackboxPredictor::LINEAR   },
+    { "thro_des",              1000.0f, BlackboxPredictor::PREVIOUS },
+    { "roll_des",               100.0f, BlackboxPredictor::PREVIOUS },
+    { "pitch_des",              100.0f, BlackboxPredictor::PREVIOUS },
+    { "yaw_des",                100.0f, BlackboxPredictor::PREVIOUS },
+    { "error_roll",             100.0f, BlackboxPredictor::LINEAR   },
+    { "error_pitch",            100.0f, BlackboxPredictor::LINEAR   },
+    { "error_yaw",              100.0f, BlackboxPredictor::LINEAR   },
+    { "integral_roll",          100.0f, BlackboxPredictor::LINEAR   },
+    { "integral_pitch",         100.0f, BlackboxPredictor::LINEAR   },
+    { "integral_yaw",           100.0f, BlackboxPredictor::LINEAR   },
+    { "derivative_roll",         10.0f, BlackboxPredictor::PREVIOUS },
+    { "derivative_pitch",        10.0f, BlackboxPredictor::PREVIOUS },
+    { "derivative_yaw",          10.0f, BlackboxPredictor::PREVIOUS },
+    { "roll_PID",             10000.0f, BlackboxPredictor::PREVIOUS },
+    { "pitch_PID",            10000.0f, BlackboxPredictor::PREVIOUS },
+    { "yaw_PID",              10000.0f, BlackboxPredictor::PREVIOUS },
+    { "throttle_pwm",             1.0f, BlackboxPredictor::PREVIOUS },
+    { "aileron_pwm",              1.0f, BlackboxPredictor::PREVIOUS },
+    { "elevator_pwm",             1.0f, BlackboxPredictor::PREVIOUS },
+    { "rudder_pwm",               1.0f, BlackboxPredictor::PREVIOUS },
+    { "throttle_cut_pwm",         1.0f, BlackboxPredictor::PREVIOUS },
+    { "aux1_pwm",                 1.0f, BlackboxPredictor::PREVIOUS },
+    { "front_motor",              1.0f, BlackboxPredictor::PREVIOUS }, //*_command_PWM
+    { "right_aileron_motor",      1.0f, BlackboxPredictor::PREVIOUS },
+    { "left_aileron_motor",       1.0f, BlackboxPredictor::PREVIOUS },
+    { "front_motor_servo",        1.0f, BlackboxPredictor::PREVIOUS },
+    { "right_aileron_servo",      1.0f, BlackboxPredictor::PREVIOUS },
+    { "left_aileron_servo",       1.0f, BlackboxPredictor::PREVIOUS },
+    { "right_elevator_servo",     1.0f, BlackboxPredictor::PREVIOUS },
+    { "left_elevator_servo",      1.0f, BlackboxPredictor::PREVIOUS }
+  };
+  const int BLACKBOX_FIELD_COUNT = sizeof(blackbox_fields) / sizeof(blackbox_fields[0]);
+#endif
+
 float q0 = 1.0f; //initialize quaternion for madgwick filter
 float q1 = 0.0f;
 float q2 = 0.0f;
@@ -383,13 +541,30 @@ void setup() {
   delay(3000); //3 second delay for plugging in battery before IMU calibration begins, feel free to comment this out to reduce boot time
 
   config.setup();  // GT
+  applyFlightParams(); //parameter set loaded by config.setup()
+  config.set_armed_check([]() { return throttle_cut_pwm >= 1600; }); //no EEPROM save while armed, see throttleCut()
 
   //Initialize all pins
   pinMode(                  13, OUTPUT); //pin 13 LED blinker on board, do not modify 
 
-  pinMode(       frontMotorPin, OUTPUT);
-  pinMode(rightAileronMotorPin, OUTPUT);
-  pinMode( leftAileronMotorPin, OUTPUT);
+  #if defined USE_DSHOT
+    dshot.attach(       frontMotorPin);
+    dshot.attach(rightAileronMotorPin);
+    dshot.attach( leftAileronMotorPin);
+    #if defined USE_DSHOT_BIDIR
+      dshot.begin(DSHOT_RATE, true);
+    #else
+      dshot.begin(DSHOT_RATE);
+    #endif
+  #elif defined USE_ONESHOT125_PWM
+    oneshot125.attach(       frontMotorPin);
+    oneshot125.attach(rightAileronMotorPin);
+    oneshot125.attach( leftAileronMotorPin);
+  #else
+    pinMode(       frontMotorPin, OUTPUT);
+    pinMode(rightAileronMotorPin, OUTPUT);
+    pinMode( leftAileronMotorPin, OUTPUT);
+  #endif
 
   frontMotorTiltServo.attach(frontMotorTiltServoPin, 900, 2100); //pin, min PWM value, max PWM value
     rightAileronServo.attach(  rightAileronServoPin, 900, 2100);
@@ -436,11 +611,11 @@ void setup() {
     
     delay(10);
 
-    //Arm OneShot125 motors
+    //Arm motors
 
-            front_motor_command_PWM = 125; //command OneShot125 ESC from 125 to 250us pulse length
-    right_aileron_motor_command_PWM = 125;
-     left_aileron_motor_command_PWM = 125;
+            front_motor_command_PWM = MOTOR_COMMAND_MIN; //command OneShot125 ESC from 125 to 250us pulse length, DShot ESC from 48 to 2047
+    right_aileron_motor_command_PWM = MOTOR_COMMAND_MIN;
+     left_aileron_motor_command_PWM = MOTOR_COMMAND_MIN;
 
     // commandMotors(); // Don't do it!!! This is not working with HlHeli_32 v32.6
     
@@ -450,11 +625,60 @@ void setup() {
     calibrateAttitude(); //helps to warm up IMU and Madgwick filter before finally entering main loop
   }
 
+  #if defined USE_MPU6050_ASYNC
+    lpi2c_async.setup(); //after the last blocking IMU read of the calibration
+  #endif
+
+  #if defined USE_IMU_DATA_READY
+    //From now on the IMU sample clock paces the main loop
+    if (receiver_only == 0) {
+      pinMode(imuIntPin, INPUT);
+      attachInterrupt(digitalPinToInterrupt(imuIntPin), imuDataReadyISR, RISING);
+    }
+  #endif
+
+  //Register background tasks, run in the slack time left by the flight control chain
+  //               name           function        period   prio  deadline (microseconds)
+  scheduler.add_task("Radio",      radioTask,        5000,    0,     5000); //SBUS frames every 7-14ms, failsafe must never starve
+  scheduler.add_task("Filters",    filterTask,     100000,    1,   100000); //follow the loop rate with the biquad coefficients
+  #if defined USE_GYRO_FFT
+    scheduler.add_task("Gyro FFT", fftTask,          5000,    1,    20000); //one axis transform per run, new peaks every 20ms
+  #endif
+  scheduler.add_task("USB Output", usbOutputTask,   10000,    2,    40000); //100Hz debug output
+  scheduler.add_task("Telemetry",  telemetryTask,    1000,    2,     8000); //telemetry streams (up to 1kHz), 500Hz binary Telemetry View
+  scheduler.add_task("LED",        loopBlink,       50000,    3,   200000);
+  #if defined USE_BLACKBOX
+    scheduler.add_task("Blackbox", blackboxTask,     1000,    4,    20000); //drains the ring to the SD card, 2KB per run max
+  #endif
+  #if defined USE_SPORT
+    scheduler.add_task("S.Port",   sportTask,       50000,    3,   200000); //new frames for the S.Port interrupt, sent when polled
+  #endif
+
+  setupTelemetry();
+
+  #if defined USE_BLACKBOX
+    blackbox_encoder.setup(blackbox_fields, BLACKBOX_FIELD_COUNT, 32); //intra frame every 32 frames
+    blackbox.setup(); //log file created and preallocated now, recording starts when armed
+  #endif
+
+  #if defined USE_SPORT
+    sport.setup(); //replies to the receiver polls from now on, values available after the first sportTask() run
+  #endif
+
+  //Start loop stages profiling from a clean state
+  profiler.setup();
+
   //Indicate entering main loop with 3 quick blinks
   setupBlink(3, 160, 70); //numBlinks, upTime (ms), downTime (ms)
 
   //If using MPU9250 IMU, uncomment for one-time magnetometer calibration (may need to repeat for new locations)
   //calibrateMagnetometer(); //generates magentometer error and scale factors
+
+  //If using USE_MPU6050_DMP, uncomment for one-time offsets calibration, vehicle level and still
+  //calibrateIMUoffsets(); //generates the MPU6050 accelerometer and gyro offset registers values
+
+  //If using USE_MPU6050_DMP, uncomment to compare the DMP attitude with Madgwick6DOF() (CPU time and latency)
+  //benchmarkAttitude();
 }
 
 //========================================================================================================================//
@@ -462,68 +686,103 @@ void setup() {
 //========================================================================================================================//
                                                   
 void loop() {
-  prev_time    = current_time;      
-  current_time = micros();      
-  dt           = (current_time - prev_time) / 1000000.0;
-
-  loopBlink(); //indicate we are in main loop with short blink every 1.5 seconds
+  #if defined USE_IMU_DATA_READY
+    if (receiver_only == 0) {
+      unsigned long samples = waitIMUdataReady(); //sleeps until the IMU signals a fresh sample
+
+      prev_time    = current_time;
+      current_time = micros();
+      if (samples > 0) {
+        dt = samples / IMU_SAMPLE_RATE;               //time elapsed on the IMU sample clock
+      }
+      else {
+        dt = (current_time - prev_time) / 1000000.0;  //IMU silent: time elapsed, mostly the wait timeout
+      }
+    }
+    else {
+      prev_time    = current_time;      
+      current_time = micros();      
+      dt           = (current_time - prev_time) / 1000000.0;
+    }
+  #else
+    prev_time    = current_time;      
+    current_time = micros();      
+    dt           = (current_time - prev_time) / 1000000.0;
+  #endif
 
-  //Print data at 100hz (uncomment one at a time for troubleshooting) - SELECT ONE:
+  if (receiver_only == 0) {
+    uint32_t loop_start = profiler.start();
+    loop_counter++;
 
-  switch (USB_output) {  // GT
-    case  1: printTelemetryView(); break;
-    case  2: printRadioData();     break; //radio pwm values (expected: 1000 to 2000)
-    case  3: printDesiredState();  break; //prints desired vehicle state commanded in either degrees or deg/sec (expected: +/- maxAXIS for roll, pitch, yaw; 0 to 1 for throttle)
-    case  4: printGyroData();      break; //prints filtered gyro data direct from IMU (expected: ~ -250 to 250, 0 at rest)
-    case  5: printAccelData();     break; //prints filtered accelerometer data direct from IMU (expected: ~ -2 to 2; x,y 0 when level, z 1 when level)
-    case  6: printMagData();       break; //prints filtered magnetometer data direct from IMU (expected: ~ -300 to 300)
-    case  7: printRollPitchYaw();  break; //prints roll, pitch, and yaw angles in degrees from Madgwick filter (expected: degrees, 0 when level)
-    case  8: printPIDoutput();     break; //prints computed stabilized PID variables from controller and desired setpoint (expected: ~ -1 to 1)
-    case  9: printMotorCommands(); break; //prints the values being written to the motors (expected: 120 to 250)
-    case 10: printServoCommands(); break; //prints the values being written to the servos (expected: 0 to 180)
-    case 11: printLoopRate();      break; //prints the time between loops in microseconds (expected: microseconds between loop iterations)
-    default:                       break;
-  }
+    //Parameters changed through the Config menus since the last iteration are used from now on
+    applyFlightParams();
 
-  if (receiver_only == 0) {
     //Get vehicle state
-    getIMUdata(); //pulls raw gyro, accelerometer, and magnetometer data from IMU and LP filters to remove noise
+    PROFILE(ProfileStage::IMU, getIMUdata()); //pulls raw gyro, accelerometer, and magnetometer data from IMU and LP filters to remove noise
 
     //updates roll_IMU, pitch_IMU, and yaw_IMU (degrees)
 
-    #if defined USE_MPU6050_I2C 
-      Madgwick6DOF(GyroX, -GyroY, -GyroZ, -AccX, AccY, AccZ, dt); 
+    #if defined USE_MPU6050_DMP
+      PROFILE(ProfileStage::FUSION, getDMPattitude());
+    #elif defined USE_MPU6050_I2C 
+      PROFILE(ProfileStage::FUSION, Madgwick6DOF(GyroX, -GyroY, -GyroZ, -AccX, AccY, AccZ, dt)); 
+    #elif defined USE_MPU9250_FIFO
+      if (mag_fresh) { //magnetometer fused at its own 100Hz rate only
+        PROFILE(ProfileStage::FUSION, Madgwick(GyroX, -GyroY, -GyroZ, -AccX, AccY, AccZ, MagY, -MagX, MagZ, dt));
+      }
+      else {
+        PROFILE(ProfileStage::FUSION, Madgwick6DOF(GyroX, -GyroY, -GyroZ, -AccX, AccY, AccZ, dt));
+      }
     #else
-      Madgwick(GyroX, -GyroY, -GyroZ, -AccX, AccY, AccZ, MagY, -MagX, MagZ, dt);
+      PROFILE(ProfileStage::FUSION, Madgwick(GyroX, -GyroY, -GyroZ, -AccX, AccY, AccZ, MagY, -MagX, MagZ, dt));
     #endif
     
     //Compute desired state
-    getDesState(); //convert raw commands to normalized values based on saturated control limits
+    PROFILE(ProfileStage::DES_STATE, getDesState()); //convert raw commands to normalized values based on saturated control limits
     
     //PID Controller - SELECT ONE:
-    controlANGLE(); //stabilize on angle setpoint
-    //controlANGLE2(); //stabilize on angle setpoint using cascaded method 
-    //controlRATE(); //stabilize on rate setpoint
+    PROFILE(ProfileStage::CONTROL, controlANGLE()); //stabilize on angle setpoint
+    //PROFILE(ProfileStage::CONTROL, controlANGLE2()); //stabilize on angle setpoint using cascaded method 
+    //PROFILE(ProfileStage::CONTROL, controlRATE()); //stabilize on rate setpoint
 
     //Actuator mixing and scaling to PWM values
-    controlMixer(); //mixes PID outputs to scaled actuator commands -- custom mixing assignments done here
-    scaleCommands(); //scales motor commands to 125 to 250 range (oneshot125 protocol) and servo PWM commands to 0 to 180 (for servo library)
+    PROFILE(ProfileStage::MIXER, controlMixer()); //mixes PID outputs to scaled actuator commands -- custom mixing assignments done here
+    PROFILE(ProfileStage::SCALE, scaleCommands()); //scales motor commands to 125 to 250 range (oneshot125 protocol) or 48 to 2047 (DShot) and servo PWM commands to 0 to 180 (for servo library)
 
     //Throttle cut check
     throttleCut(); //directly sets motor commands to low based on state of ch5
 
     //Command actuators
-    commandMotors(); //sends command pulses to each motor pin using OneShot125 protocol
+    PROFILE(ProfileStage::MOTORS, commandMotors()); //sends command pulses to each motor pin using OneShot125 or DShot protocol
+
+    PROFILE(ProfileStage::SERVOS, commandServos());
 
-    commandServos();
+    profiler.stop(ProfileStage::LOOP, loop_start);
+
+    #if defined USE_BLACKBOX
+      blackboxLog((ARM_DWT_CYCCNT - loop_start) / (F_CPU_ACTUAL / 1000000)); //copy to the RAM ring only, the SD card is written by blackboxTask()
+    #endif
   }
-      
-  //Get vehicle commands for next loop iteration
-  getCommands(); //pulls current available radio commands
-  failSafe(); //prevent failures in event of bad receiver connection, defaults to failsafe values assigned in setup
+
+  //Run due background tasks (radio, USB output, LED) in the time left before the next iteration
+  #if defined USE_IMU_DATA_READY
+    scheduler.run(current_time + (unsigned long) (1000000.0 / IMU_SAMPLE_RATE) - 20); //next data-ready interrupt, minus wake-up margin
+  #else
+    scheduler.run(current_time + 1000000 / 2050);
+  #endif
+
+  //USB command line: a few received bytes or one menu line per iteration (see Config/config.h)
+  config.run();
+
+  //Send a bounded chunk of the debug and telemetry output, never waiting for the USB host
+  console.drain();
 
   //Regulate loop rate
-  loopRate(2050); //do not exceed 2000Hz, all filter parameters tuned to 2000Hz by default
+  #if defined USE_IMU_DATA_READY
+    if (receiver_only != 0) loopRate(2050);
+  #else
+    loopRate(2050); //do not exceed 2000Hz, all filter parameters tuned to 2000Hz by default
+  #endif
 }
 
 
@@ -552,8 +811,48 @@ void IMUinit() {
     //From the reset state all registers should be 0x00, so we should be at
     //max sample rate with digital low pass filter(s) off.  All we need to
     //do is set the desired fullscale ranges
-    mpu6050.setFullScaleGyroRange(GYRO_SCALE);
-    mpu6050.setFullScaleAccelRange(ACCEL_SCALE);
+    mpu6050.setFullScaleGyroRange(IMUPipeline::GYRO_FS_SEL);
+    mpu6050.setFullScaleAccelRange(IMUPipeline::ACCEL_FS_SEL);
+
+    #if defined USE_IMU_DATA_READY
+      //Fixed sample clock and a 50us active high INT pulse for every new sample
+      mpu6050.setRate(IMU_SAMPLE_RATE_DIV);
+      mpu6050.setInterruptMode(false);  //active high
+      mpu6050.setInterruptDrive(false); //push-pull
+      mpu6050.setInterruptLatch(false); //50us pulse
+      mpu6050.setIntDataReadyEnabled(true);
+    #endif
+
+    #if defined USE_MPU6050_FIFO
+      //4kHz gyro sample rate, only the gyro axes go to the FIFO (accelerometer is read directly, 1kHz)
+      mpu6050.setDLPFMode(MPU6050_DLPF_BW_256);
+      mpu6050.setRate(IMU_FIFO_RATE_DIV);
+      mpu6050.setXGyroFIFOEnabled(true);
+      mpu6050.setYGyroFIFOEnabled(true);
+      mpu6050.setZGyroFIFOEnabled(true);
+      mpu6050.setFIFOEnabled(true);
+      mpu6050.resetFIFO();
+    #endif
+
+    #if defined USE_MPU6050_DMP
+      //Resets the MPU6050 and loads the DMP firmware: 2000deg/s, 2g, 200Hz sample rate, DLPF 188Hz, quaternions to the FIFO
+      if (mpu6050.dmpInitialize() != 0) {
+        Serial.println("MPU6050 DMP firmware loading unsuccessful");
+        while(1) {}
+      }
+
+      //Calibration offsets, see calibrateIMUoffsets()
+      if (AccOffsetX  != 0.0) mpu6050.setXAccelOffset((int16_t) AccOffsetX);
+      if (AccOffsetY  != 0.0) mpu6050.setYAccelOffset((int16_t) AccOffsetY);
+      if (AccOffsetZ  != 0.0) mpu6050.setZAccelOffset((int16_t) AccOffsetZ);
+      if (GyroOffsetX != 0.0) mpu6050.setXGyroOffset((int16_t) GyroOffsetX);
+      if (GyroOffsetY != 0.0) mpu6050.setYGyroOffset((int16_t) GyroOffsetY);
+      if (GyroOffsetZ != 0.0) mpu6050.setZGyroOffset((int16_t) GyroOffsetZ);
+
+      dmp_packet_size = mpu6050.dmpGetFIFOPacketSize();
+      mpu6050.setDMPEnabled(true);
+      mpu6050.resetFIFO();
+    #endif
     
   #elif defined USE_MPU9250_SPI
     int status = mpu9250.begin();    
@@ -569,15 +868,219 @@ void IMUinit() {
     //From the reset state all registers should be 0x00, so we should be at
     //max sample rate with digital low pass filter(s) off.  All we need to
     //do is set the desired fullscale ranges
-    mpu9250.setGyroRange(GYRO_SCALE);
-    mpu9250.setAccelRange(ACCEL_SCALE);
+    mpu9250.setGyroRange((MPU9250::GyroRange) IMUPipeline::GYRO_FS_SEL);
+    mpu9250.setAccelRange((MPU9250::AccelRange) IMUPipeline::ACCEL_FS_SEL);
     mpu9250.setMagCalX(MagErrorX, MagScaleX);
     mpu9250.setMagCalY(MagErrorY, MagScaleY);
     mpu9250.setMagCalZ(MagErrorZ, MagScaleZ);
     mpu9250.setSrd(0); //sets gyro and accel read to 1khz, magnetometer read to 100hz
+
+    #if defined USE_IMU_DATA_READY
+      mpu9250.setSrd(IMU_SAMPLE_RATE_DIV);
+      mpu9250.enableDataReadyInterrupt(); //50us INT pulse for every new sample
+    #endif
+
+    #if defined USE_MPU9250_FIFO
+      //8kHz gyro and accelerometer samples to the FIFO, magnetometer read aside at its own rate
+      mpu9250.enableFifoBatch();
+    #endif
+  #endif
+
+  #if defined USE_IMU_FIFO
+    for (int i = 0; i < 3; i++) gyro_aa_filter[i].lowpass(IMU_FIFO_AA_CUTOFF, IMU_FIFO_SAMPLE_RATE);
+  #endif
+
+  #if defined USE_IMU_DATA_READY
+    setupFilterBanks(IMU_SAMPLE_RATE);
+  #else
+    setupFilterBanks(2000.0); //nominal loop rate, then tracked by filterTask()
+  #endif
+}
+
+#if defined USE_IMU_DATA_READY
+
+void imuDataReadyISR() {
+  //DESCRIPTION: IMU INT pin rising edge, a fresh sample is available in the IMU data registers
+  /*
+   * With USE_MPU6050_ASYNC, the DMA read of the sample is started from here and the loop is woken up by its completion
+   * (imuReadComplete()). If the previous sample has not been consumed yet (loop overrun), it is kept and counted.
+   */
+  #if defined USE_MPU6050_ASYNC
+    if (imu_blocking_read || !lpi2c_async.idle() ||
+        !lpi2c_async.start_read(MPU6050_DEFAULT_ADDRESS, MPU6050_RA_ACCEL_XOUT_H, imu_async_buffer, 14, imuReadComplete)) {
+      imu_samples_pending++;
+    }
+  #else
+    imu_samples_pending++;
   #endif
 }
 
+#if defined USE_MPU6050_ASYNC
+void imuReadComplete(bool ok) {
+  //DESCRIPTION: DMA read of an IMU sample completed (ok) or aborted, called from interrupt
+  imu_samples_pending++; //on error, getIMUdata() falls back to a blocking read
+}
+#endif
+
+unsigned long waitIMUdataReady() {
+  //DESCRIPTION: Wait for the next IMU data-ready interrupt and return the number of samples produced since the last call
+  /*
+   * The core is put to sleep (wfi) between interrupts instead of spinning on micros(). Interrupts are masked while checking
+   * the counter so that a data-ready edge arriving just before the wfi instruction still wakes the core up. If the IMU stays
+   * silent for IMU_DATA_READY_TIMEOUT microseconds (INT pin not wired, IMU lockup), 0 is returned: the loop runs anyway, with
+   * dt measured by micros(), so that radio failsafe and throttle cut are still processed.
+   */
+  unsigned long samples;
+  unsigned long wait_start = micros();
+
+  noInterrupts();
+  while ((imu_samples_pending == 0) && ((micros() - wait_start) < IMU_DATA_READY_TIMEOUT)) {
+    asm volatile("wfi");
+    interrupts();
+    noInterrupts();
+  }
+  samples             = imu_samples_pending;
+  imu_samples_pending = 0;
+  interrupts();
+
+  if (samples == 0) imu_missed_interrupts++;
+
+  return samples;
+}
+
+#endif
+
+#if defined USE_MPU6050_ASYNC
+void getMotion6Async(int16_t * ax, int16_t * ay, int16_t * az, int16_t * gx, int16_t * gy, int16_t * gz) {
+  //DESCRIPTION: Get the IMU sample read by DMA, start the next read
+  /*
+   * With USE_IMU_DATA_READY, the read was started by imuDataReadyISR() and is normally complete when the loop wakes up.
+   * Without it, the reads are pipelined: the read of the next sample is started here and runs on the bus while the
+   * CPU goes through the fusion, controller and mixer on this one; the sample is one loop old when used.
+   * The wait for the transfer is bounded by IMU_ASYNC_TIMEOUT. On error or timeout (or before the first read), the
+   * sample is read with the blocking I2Cdev path instead.
+   */
+  if (lpi2c_async.wait(IMU_ASYNC_TIMEOUT)) {
+    *ax = (((int16_t) imu_async_buffer[ 0]) << 8) | imu_async_buffer[ 1];
+    *ay = (((int16_t) imu_async_buffer[ 2]) << 8) | imu_async_buffer[ 3];
+    *az = (((int16_t) imu_async_buffer[ 4]) << 8) | imu_async_buffer[ 5];
+    *gx = (((int16_t) imu_async_buffer[ 8]) << 8) | imu_async_buffer[ 9];
+    *gy = (((int16_t) imu_async_buffer[10]) << 8) | imu_async_buffer[11];
+    *gz = (((int16_t) imu_async_buffer[12]) << 8) | imu_async_buffer[13];
+  }
+  else {
+    imu_blocking_read = true;
+    mpu6050.getMotion6(ax, ay, az, gx, gy, gz);
+    imu_blocking_read = false;
+  }
+  lpi2c_async.release();
+
+  #if !defined USE_IMU_DATA_READY
+    lpi2c_async.start_read(MPU6050_DEFAULT_ADDRESS, MPU6050_RA_ACCEL_XOUT_H, imu_async_buffer, 14);
+  #endif
+}
+#endif
+
+#if defined USE_IMU_FIFO
+void decimateGyroFIFO(const int16_t * samples, int count, int stride, int16_t * gx, int16_t * gy, int16_t * gz) {
+  //DESCRIPTION: Anti-aliasing filter and decimation of a batch of gyro samples read from the IMU FIFO
+  /*
+   * Every gyro sample produced at IMU_FIFO_SAMPLE_RATE goes through the anti-aliasing low-pass filter, the loop only keeps
+   * the last filtered value (decimation). Compared to a single snapshot per loop, prop noise above the loop Nyquist frequency
+   * is attenuated instead of being folded back into the control bandwidth. samples points to the X axis of the first gyro
+   * sample, stride is the distance between two samples (int16 words). With an empty batch the last value is returned.
+   */
+  if (count > 0) {
+    float filtered[3];
+    for (int i = 0; i < count; i++) {
+      const int16_t * sample = &samples[i * stride];
+      for (int axis = 0; axis < 3; axis++) filtered[axis] = gyro_aa_filter[axis].apply(sample[axis]);
+    }
+    for (int axis = 0; axis < 3; axis++) gyro_fifo_last[axis] = lroundf(filtered[axis]);
+
+    imu_fifo_samples += count;
+    imu_fifo_reads++;
+  }
+
+  *gx = gyro_fifo_last[0];
+  *gy = gyro_fifo_last[1];
+  *gz = gyro_fifo_last[2];
+}
+#endif
+
+#if defined USE_MPU6050_FIFO
+void getMotion6FIFO(int16_t * ax, int16_t * ay, int16_t * az, int16_t * gx, int16_t * gy, int16_t * gz) {
+  //DESCRIPTION: Drain the gyro samples queued in the MPU6050 FIFO since the last loop, read the accelerometer
+  /*
+   * Only whole samples are read, a sample being written while the count is read stays for the next loop. A FIFO close to
+   * full has overflowed (it is not a multiple of the sample size): it is reset and the overflow counted.
+   *
+   * The count, the FIFO burst and the accelerometer are three blocking I2C reads, ~9us per byte at 1MHz plus the
+   * addressing of each transfer: they take most of the IMU stage of the Loop Profile output, which should be checked
+   * against the loop period. The gyro runs at 4kHz (IMU_FIFO_RATE_DIV) so that a burst is 2 samples (12 bytes) per loop
+   * at 2kHz instead of 4 at 8kHz.
+   */
+  uint8_t  fifo_buffer[IMU_FIFO_MAX_SAMPLES * 6];
+  int16_t  gyro_batch[IMU_FIFO_MAX_SAMPLES * 3];
+  int      samples = 0;
+  uint16_t count   = mpu6050.getFIFOCount();
+
+  if (count > (IMU_FIFO_SIZE - 6)) {
+    mpu6050.resetFIFO();
+    imu_fifo_overflows++;
+  }
+  else {
+    samples = min(count / 6, IMU_FIFO_MAX_SAMPLES);
+
+    if (samples > 0) mpu6050.getFIFOBytes(fifo_buffer, samples * 6);
+    for (int i = 0; i < samples * 3; i++) {
+      gyro_batch[i] = (((int16_t) fifo_buffer[i * 2]) << 8) | fifo_buffer[i * 2 + 1];
+    }
+  }
+
+  decimateGyroFIFO(gyro_batch, samples, 3, gx, gy, gz);
+
+  mpu6050.getAcceleration(ax, ay, az);
+}
+#endif
+
+#if defined USE_MPU9250_FIFO
+void getMotion9FIFO(int16_t * ax, int16_t * ay, int16_t * az, int16_t * gx, int16_t * gy, int16_t * gz, int16_t * mx, int16_t * my, int16_t * mz) {
+  //DESCRIPTION: Read the batch of samples queued in the MPU9250 FIFO since the last loop, and the magnetometer when due
+  /*
+   * Each FIFO sample holds the accelerometer and gyro (ax, ay, az, gx, gy, gz). The gyro samples go through
+   * decimateGyroFIFO(), the accelerometer samples of the batch are averaged. The magnetometer is only read every
+   * IMU_MAG_PERIOD microseconds, its output rate: mag_fresh tells the loop to run the 9DOF attitude fusion with it.
+   */
+  int16_t batch[IMU_FIFO_MAX_SAMPLES * 6];
+  bool    overflow;
+  int     samples = mpu9250.readFifoBatch(batch, IMU_FIFO_MAX_SAMPLES, &overflow);
+
+  if (overflow) imu_fifo_overflows++;
+
+  if (samples > 0) {
+    long sum[3] = { 0, 0, 0 };
+    for (int i = 0; i < samples; i++) {
+      for (int axis = 0; axis < 3; axis++) sum[axis] += batch[i * 6 + axis];
+    }
+    *ax = sum[0] / samples;
+    *ay = sum[1] / samples;
+    *az = sum[2] / samples;
+  }
+  else {
+    mpu9250.getMotion6(ax, ay, az, gx, gy, gz); //empty or reset FIFO: accelerometer from the data registers
+  }
+
+  decimateGyroFIFO(&batch[3], max(samples, 0), 6, gx, gy, gz);
+
+  mag_fresh = false;
+  if ((current_time - mag_read_time) >= IMU_MAG_PERIOD) {
+    mag_read_time = current_time;
+    mag_fresh     = mpu9250.readMag(mx, my, mz) > 0;
+  }
+}
+#endif
+
 void getIMUdata() {
   //DESCRIPTION: Request full dataset from IMU and LP filter gyro, accelerometer, and magnetometer data
   /*
@@ -587,55 +1090,75 @@ void getIMUdata() {
    * off everything past 80Hz, but if your loop rate is not fast enough, the low pass filter will cause a lag in
    * the readings. The filter parameters B_gyro and B_accel are set to be good for a 2kHz loop rate. Finally,
    * the constant errors found in calculate_IMU_error() on startup are subtracted from the accelerometer and gyro readings.
+   * With USE_DSHOT_BIDIR, the gyro goes through the RPM notch filters (see updateRPMfilter()) before the low-pass filter:
+   * the motors noise being removed at its source frequencies, B_gyro can be raised for less phase lag.
    */
-  int16_t AcX,AcY,AcZ,GyX,GyY,GyZ;
+  IMURawSample raw;
   #if defined USE_MPU9250_SPI
     int16_t MgX,MgY,MgZ;
   #endif
 
-  #if defined USE_MPU6050_I2C
-    mpu6050.getMotion6(&AcX, &AcY, &AcZ, &GyX, &GyY, &GyZ);
+  #if defined USE_MPU6050_ASYNC
+    getMotion6Async(&raw.acc[0], &raw.acc[1], &raw.acc[2], &raw.gyro[0], &raw.gyro[1], &raw.gyro[2]);
+  #elif defined USE_MPU6050_FIFO
+    getMotion6FIFO(&raw.acc[0], &raw.acc[1], &raw.acc[2], &raw.gyro[0], &raw.gyro[1], &raw.gyro[2]);
+  #elif defined USE_MPU6050_I2C
+    mpu6050.getMotion6(&raw.acc[0], &raw.acc[1], &raw.acc[2], &raw.gyro[0], &raw.gyro[1], &raw.gyro[2]);
+  #elif defined USE_MPU9250_FIFO
+    getMotion9FIFO(&raw.acc[0], &raw.acc[1], &raw.acc[2], &raw.gyro[0], &raw.gyro[1], &raw.gyro[2], &MgX, &MgY, &MgZ);
   #elif defined USE_MPU9250_SPI
-    mpu9250.getMotion9(&AcX, &AcY, &AcZ, &GyX, &GyY, &GyZ, &MgX, &MgY, &MgZ);
+    mpu9250.getMotion9(&raw.acc[0], &raw.acc[1], &raw.acc[2], &raw.gyro[0], &raw.gyro[1], &raw.gyro[2], &MgX, &MgY, &MgZ);
   #endif
 
-  //Accelerometer
-  AccX = AcX / ACCEL_SCALE_FACTOR; //G's
-  AccY = AcY / ACCEL_SCALE_FACTOR;
-  AccZ = AcZ / ACCEL_SCALE_FACTOR;
-  
-  //Correct the outputs with the calculated error values
-  AccX = AccX - AccErrorX;
-  AccY = AccY - AccErrorY;
-  AccZ = AccZ - AccErrorZ;
-  
-  //LP filter accelerometer data
-  AccX = (1.0 - B_accel) * AccX_prev + B_accel*AccX;
-  AccY = (1.0 - B_accel) * AccY_prev + B_accel*AccY;
-  AccZ = (1.0 - B_accel) * AccZ_prev + B_accel*AccZ;
-  AccX_prev = AccX;
-  AccY_prev = AccY;
-  AccZ_prev = AccZ;
-
-  //Gyro
-  GyroX = GyX / GYRO_SCALE_FACTOR; //deg/sec
-  GyroY = GyY / GYRO_SCALE_FACTOR;
-  GyroZ = GyZ / GYRO_SCALE_FACTOR;
-  
-  //Correct the outputs with the calculated error values
-  GyroX = GyroX - GyroErrorX;
-  GyroY = GyroY - GyroErrorY;
-  GyroZ = GyroZ - GyroErrorZ;
-  
-  //LP filter gyro data
-  GyroX = (1.0 - B_gyro) * GyroX_prev + B_gyro*GyroX;
-  GyroY = (1.0 - B_gyro) * GyroY_prev + B_gyro*GyroY;
-  GyroZ = (1.0 - B_gyro) * GyroZ_prev + B_gyro*GyroZ;
-  GyroX_prev = GyroX;
-  GyroY_prev = GyroY;
-  GyroZ_prev = GyroZ;
+  #if defined USE_BLACKBOX
+    imu_raw = raw;
+  #endif
+
+  float acc[3], gyro[3];
+
+  //Accelerometer: scaled to G's, corrected with the calculated error values and LP filtered in one step
+  imu_pipeline.process_accel(raw, acc);
+  accel_filter.apply(acc);
+  AccX = acc[0];
+  AccY = acc[1];
+  AccZ = acc[2];
+
+  //Gyro: scaled to deg/sec and corrected with the calculated error values
+  imu_pipeline.convert_gyro(raw, gyro);
+
+  #if defined USE_DSHOT_BIDIR
+    //Notch filter gyro data at each motor rotation frequency and harmonics
+    for (int m = 0; m < 3; m++) {
+      for (int h = 0; h < RPM_NOTCH_HARMONICS; h++) {
+        gyro[0] = rpm_notch[m][h][0].apply(gyro[0]);
+        gyro[1] = rpm_notch[m][h][1].apply(gyro[1]);
+        gyro[2] = rpm_notch[m][h][2].apply(gyro[2]);
+      }
+    }
+  #endif
+
+  #if defined USE_GYRO_FFT
+    //Spectrum analysis of the gyro left after the RPM notches, notch filters on the peaks found (see fftTask())
+    gyro_fft.push(gyro);
+    for (int p = 0; p < GyroFFT::MAX_PEAKS; p++) {
+      gyro[0] = dyn_notch[p][0].apply(gyro[0]);
+      gyro[1] = dyn_notch[p][1].apply(gyro[1]);
+      gyro[2] = dyn_notch[p][2].apply(gyro[2]);
+    }
+  #endif
+
+  //Biquad low-pass and notch filters (filter_menu parameters), then LP filter gyro data
+  gyro_filter.apply(gyro);
+  imu_pipeline.filter_gyro(gyro);
+  GyroX = gyro[0];
+  GyroY = gyro[1];
+  GyroZ = gyro[2];
 
   #if defined USE_MPU9250_SPI
+    #if defined USE_MPU9250_FIFO
+      if (!mag_fresh) return; //keep the last magnetometer values
+    #endif
+
     //Magnetometer
     MagX = MgX/6.0; //uT
     MagY = MgY/6.0;
@@ -661,44 +1184,51 @@ void calculate_IMU_error() {
    * accelerometer values AccX, AccY, AccZ, GyroX, GyroY, GyroZ in getIMUdata(). This eliminates drift in the
    * measurement. 
    */
-  int16_t AcX,AcY,AcZ,GyX,GyY,GyZ;
+  IMURawSample raw;
   #if defined USE_MPU9250_SPI
     int16_t MgX,MgY,MgZ;
   #endif
 
+  int32_t acc_sum[3]  = { 0, 0, 0 };
+  int32_t gyro_sum[3] = { 0, 0, 0 };
+
   //Read IMU values 12000 times
   int c = 0;
   while (c < 12000) {
     #if defined USE_MPU6050_I2C
-      mpu6050.getMotion6(&AcX, &AcY, &AcZ, &GyX, &GyY, &GyZ);
+      mpu6050.getMotion6(&raw.acc[0], &raw.acc[1], &raw.acc[2], &raw.gyro[0], &raw.gyro[1], &raw.gyro[2]);
     #elif defined USE_MPU9250_SPI
-      mpu9250.getMotion9(&AcX, &AcY, &AcZ, &GyX, &GyY, &GyZ, &MgX, &MgY, &MgZ);
+      mpu9250.getMotion9(&raw.acc[0], &raw.acc[1], &raw.acc[2], &raw.gyro[0], &raw.gyro[1], &raw.gyro[2], &MgX, &MgY, &MgZ);
     #endif
     
-    AccX  = AcX / ACCEL_SCALE_FACTOR;
-    AccY  = AcY / ACCEL_SCALE_FACTOR;
-    AccZ  = AcZ / ACCEL_SCALE_FACTOR;
-    GyroX = GyX / GYRO_SCALE_FACTOR;
-    GyroY = GyY / GYRO_SCALE_FACTOR;
-    GyroZ = GyZ / GYRO_SCALE_FACTOR;
-    
-    //Sum all readings
-    AccErrorX  = AccErrorX + AccX;
-    AccErrorY  = AccErrorY + AccY;
-    AccErrorZ  = AccErrorZ + AccZ;
-    GyroErrorX = GyroErrorX + GyroX;
-    GyroErrorY = GyroErrorY + GyroY;
-    GyroErrorZ = GyroErrorZ + GyroZ;
+    //Sum all raw readings, 12000 x 32767 fits in 32 bits
+    for (int i = 0; i < 3; i++) {
+      acc_sum[i]  += raw.acc[i];
+      gyro_sum[i] += raw.gyro[i];
+    }
     c++;
   }
 
-  //Divide the sum by 12000 to get the error value
-  AccErrorX  = AccErrorX / c;
-  AccErrorY  = AccErrorY / c;
-  AccErrorZ  = AccErrorZ / c - 1.0;
-  GyroErrorX = GyroErrorX / c;
-  GyroErrorY = GyroErrorY / c;
-  GyroErrorZ = GyroErrorZ / c;
+  //Divide the sum by 12000 and scale it to get the error value
+  AccErrorX  = acc_sum[0]  * IMUPipeline::ACCEL_SCALE / c;
+  AccErrorY  = acc_sum[1]  * IMUPipeline::ACCEL_SCALE / c;
+  AccErrorZ  = acc_sum[2]  * IMUPipeline::ACCEL_SCALE / c - 1.0;
+  GyroErrorX = gyro_sum[0] * IMUPipeline::GYRO_SCALE  / c;
+  GyroErrorY = gyro_sum[1] * IMUPipeline::GYRO_SCALE  / c;
+  GyroErrorZ = gyro_sum[2] * IMUPipeline::GYRO_SCALE  / c;
+
+  setupIMUPipeline();
+}
+
+void setupIMUPipeline() {
+  //DESCRIPTION: Fold the scale factors, error values and LP filter parameters in the sensor pipeline
+  /*
+   * Called by calculate_IMU_error(), then by filterTask() when B_accel or B_gyro is changed while the loop runs. The
+   * filter states are kept, the new coefficients apply from the next sample.
+   */
+  float acc_error[3]  = { AccErrorX,  AccErrorY,  AccErrorZ  };
+  float gyro_error[3] = { GyroErrorX, GyroErrorY, GyroErrorZ };
+  imu_pipeline.setup(acc_error, B_accel, gyro_error, B_gyro);
 }
 
 void calibrateAttitude() {
@@ -715,7 +1245,9 @@ void calibrateAttitude() {
     dt = (current_time - prev_time) / 1000000.0; 
     getIMUdata();
 
-    #if defined USE_MPU6050_I2C 
+    #if defined USE_MPU6050_DMP
+      getDMPattitude();
+    #elif defined USE_MPU6050_I2C 
       Madgwick6DOF(GyroX, -GyroY, -GyroZ, -AccX, AccY, AccZ, dt);
     #else
       Madgwick(GyroX, -GyroY, -GyroZ, -AccX, AccY, AccZ, MagY, -MagX, MagZ, dt);
@@ -922,6 +1454,90 @@ void Madgwick6DOF(float gx, float gy, float gz, float ax, float ay, float az, fl
   yaw_IMU   = -atan2(q1 * q2 + q0 * q3, 0.5f - q2 * q2 - q3 * q3) * 57.29577951;  //degrees
 }
 
+#if defined USE_MPU6050_DMP
+
+bool readDMPquaternion(float * q) {
+  //DESCRIPTION: Read the latest quaternion computed by the MPU6050 DMP from its FIFO
+  /*
+   * The FIFO is only polled when the next 100Hz DMP packet is due, the I2C transfers being blocking. Older packets
+   * still in the FIFO are dropped, only the most recent quaternion is used. After an overflow, the FIFO content is no
+   * longer aligned on packets and is reset. The quaternion is returned in the frame used by Madgwick6DOF(): the
+   * sensor is rotated 180 degrees about x, (w, x, y, z) becomes (w, x, -y, -z). Returns false if no new packet is read.
+   */
+  if ((current_time - dmp_packet_time) < (IMU_DMP_PERIOD * 9 / 10)) return false;
+
+  uint16_t count = mpu6050.getFIFOCount();
+
+  if (count < dmp_packet_size) return false;
+
+  if (count >= IMU_FIFO_SIZE) {
+    mpu6050.resetFIFO();
+    dmp_fifo_overflows++;
+    return false;
+  }
+
+  uint8_t packet[64];
+  
+  for (count = (count / dmp_packet_size) - 1; count > 0; count--) {
+    mpu6050.getFIFOBytes(packet, dmp_packet_size); //older packets
+  }
+  mpu6050.getFIFOBytes(packet, dmp_packet_size);
+
+  dmp_packet_time = current_time;
+  dmp_packets++;
+
+  Quaternion dmp_q;
+  mpu6050.dmpGetQuaternion(&dmp_q, packet);
+
+  q[0] =  dmp_q.w;
+  q[1] =  dmp_q.x;
+  q[2] = -dmp_q.y;
+  q[3] = -dmp_q.z;
+
+  return true;
+}
+
+void getDMPattitude() {
+  //DESCRIPTION: Attitude estimation done by the MPU6050 DMP - 6DOF
+  /*
+   * Replaces Madgwick6DOF() with USE_MPU6050_DMP: the sensor fusion runs in the MPU6050 Digital Motion Processor and
+   * the Teensy only fetches its quaternion. The attitude is updated at 100Hz instead of the loop rate, the rate
+   * controllers still use the gyro registers read by getIMUdata(). Updates roll_IMU, pitch_IMU, and yaw_IMU (degrees).
+   */
+  float q[4];
+
+  if (!readDMPquaternion(q)) return; //keep the last attitude
+
+  q0 = q[0];
+  q1 = q[1];
+  q2 = q[2];
+  q3 = q[3];
+
+  //compute angles
+  roll_IMU  =  atan2(q0 * q1 + q2 * q3, 0.5f - q1 * q1 - q2 * q2) * 57.29577951;  //degrees
+  pitch_IMU = -asin( -2.0f * (q1 * q3 - q0 * q2)) * 57.29577951;                  //degrees
+  yaw_IMU   = -atan2(q1 * q2 + q0 * q3, 0.5f - q2 * q2 - q3 * q3) * 57.29577951;  //degrees
+}
+
+#endif
+
+void applyFlightParams() {
+  //DESCRIPTION: Switch to the last parameter set published by the Config menus, at the start of a control iteration
+  /*
+   * The control functions read their gains and mixer values from flight_params.get(), which only changes here: every
+   * function of an iteration uses the same set. The pitch rate P-gain faded by controlMixer() in transition restarts
+   * from the configured Kp_pitch_rate when this one is changed.
+   */
+  static float configured_Kp_pitch_rate = NAN;
+
+  const FlightParams & fp = flight_params.apply();
+
+  if (fp.Kp_pitch_rate != configured_Kp_pitch_rate) {
+    configured_Kp_pitch_rate = fp.Kp_pitch_rate;
+    Kp_pitch_rate_faded      = fp.Kp_pitch_rate;
+  }
+}
+
 void getDesState() {
   //DESCRIPTION: Normalizes desired control values to appropriate values
   /*
@@ -931,19 +1547,21 @@ void getDesState() {
    * (rate mode). yaw_des is scaled to be within max yaw in degrees/sec. Also creates roll_passthru, pitch_passthru, and
    * yaw_passthru variables, to be used in commanding motors/servos with direct unstabilized commands in controlMixer().
    */
+  const FlightParams & fp = flight_params.get(); //same parameter set for the whole iteration (see applyFlightParams())
+
    thro_des = (throttle_pwm - 1000.0) / 1000.0;  //between  0 and 1
    roll_des = ( aileron_pwm - 1500.0) /  500.0;  //between -1 and 1
   pitch_des = (elevator_pwm - 1500.0) /  500.0;  //between -1 and 1
     yaw_des = (  rudder_pwm - 1500.0) /  500.0;  //between -1 and 1
   //Constrain within normalized bounds
    thro_des = constrain( thro_des,  0.0, 1.0); //between 0 and 1
-   roll_des = constrain( roll_des, -1.0, 1.0) * maxRoll;  //between -maxRoll  and +maxRoll
-  pitch_des = constrain(pitch_des, -1.0, 1.0) * maxPitch; //between -maxPitch and +maxPitch
-    yaw_des = constrain(  yaw_des, -1.0, 1.0) * maxYaw;   //between -maxYaw   and +maxYaw
+   roll_des = constrain( roll_des, -1.0, 1.0) * fp.maxRoll;  //between -maxRoll  and +maxRoll
+  pitch_des = constrain(pitch_des, -1.0, 1.0) * fp.maxPitch; //between -maxPitch and +maxPitch
+    yaw_des = constrain(  yaw_des, -1.0, 1.0) * fp.maxYaw;   //between -maxYaw   and +maxYaw
 
-   roll_passthru =  roll_des / (2 * maxRoll );
-  pitch_passthru = pitch_des / (2 * maxPitch);
-    yaw_passthru =   yaw_des / (2 * maxYaw  );
+   roll_passthru =  roll_des / (2 * fp.maxRoll );
+  pitch_passthru = pitch_des / (2 * fp.maxPitch);
+    yaw_passthru =   yaw_des / (2 * fp.maxYaw  );
 }
 
 void controlANGLE() {
@@ -958,27 +1576,29 @@ void controlANGLE() {
    * terms will always start from 0 on takeoff. This function updates the variables roll_PID, pitch_PID, and yaw_PID which
    * can be thought of as 1-D stablized signals. They are mixed to the configuration of the vehicle in controlMixer().
    */
+  const FlightParams & fp = flight_params.get(); //same parameter set for the whole iteration (see applyFlightParams())
+
   
   //Roll
        error_roll = roll_des - roll_IMU;
     integral_roll = (throttle_pwm < 1060) ? 0 : integral_roll_prev + error_roll * dt;
-    integral_roll = constrain(integral_roll, -i_limit, i_limit); //saturate integrator to prevent unsafe buildup
-  derivative_roll = GyroX;
-  roll_PID        = 0.01 * (Kp_roll_angle * error_roll + Ki_roll_angle * integral_roll - Kd_roll_angle * derivative_roll); //scaled by .01 to bring within -1 to 1 range
+    integral_roll = constrain(integral_roll, -fp.i_limit, fp.i_limit); //saturate integrator to prevent unsafe buildup
+  derivative_roll = dterm_filter.apply(0, GyroX);
+  roll_PID        = 0.01 * (fp.Kp_roll_angle * error_roll + fp.Ki_roll_angle * integral_roll - fp.Kd_roll_angle * derivative_roll); //scaled by .01 to bring within -1 to 1 range
 
   //Pitch
        error_pitch = pitch_des - pitch_IMU;
     integral_pitch = (throttle_pwm < 1060) ? 0 : integral_pitch_prev + error_pitch * dt;
-    integral_pitch = constrain(integral_pitch, -i_limit, i_limit); //saturate integrator to prevent unsafe buildup
-  derivative_pitch = GyroY;
-  pitch_PID        = .01 * (Kp_pitch_angle * error_pitch + Ki_pitch_angle * integral_pitch - Kd_pitch_angle * derivative_pitch); //scaled by .01 to bring within -1 to 1 range
+    integral_pitch = constrain(integral_pitch, -fp.i_limit, fp.i_limit); //saturate integrator to prevent unsafe buildup
+  derivative_pitch = dterm_filter.apply(1, GyroY);
+  pitch_PID        = .01 * (fp.Kp_pitch_angle * error_pitch + fp.Ki_pitch_angle * integral_pitch - fp.Kd_pitch_angle * derivative_pitch); //scaled by .01 to bring within -1 to 1 range
 
   //Yaw, stablize on rate from GyroZ
        error_yaw = yaw_des - GyroZ;
     integral_yaw = (throttle_pwm < 1060) ? 0 : integral_yaw_prev + error_yaw * dt;
-    integral_yaw = constrain(integral_yaw, -i_limit, i_limit); //saturate integrator to prevent unsafe buildup
-  derivative_yaw = (error_yaw - error_yaw_prev) / dt; 
-  yaw_PID        = .01 * (Kp_yaw * error_yaw + Ki_yaw * integral_yaw + Kd_yaw * derivative_yaw); //scaled by .01 to bring within -1 to 1 range
+    integral_yaw = constrain(integral_yaw, -fp.i_limit, fp.i_limit); //saturate integrator to prevent unsafe buildup
+  derivative_yaw = dterm_filter.apply(2, (error_yaw - error_yaw_prev) / dt); 
+  yaw_PID        = .01 * (fp.Kp_yaw * error_yaw + fp.Ki_yaw * integral_yaw + fp.Kd_yaw * derivative_yaw); //scaled by .01 to bring within -1 to 1 range
 
   //Update roll variables
   integral_roll_prev  = integral_roll;
@@ -995,21 +1615,23 @@ void controlANGLE2() {
    * Gives better performance than controlANGLE() but requires much more tuning. Not reccommended for first-time setup.
    * See the documentation for tuning this controller.
    */
+  const FlightParams & fp = flight_params.get(); //same parameter set for the whole iteration (see applyFlightParams())
+
   //Outer loop - PID on angle
   float roll_des_ol, pitch_des_ol;
   //Roll
        error_roll    = roll_des - roll_IMU;
     integral_roll_ol = (throttle_pwm < 1060) ? 0 : integral_roll_prev_ol + error_roll * dt;
-    integral_roll_ol = constrain(integral_roll_ol, -i_limit, i_limit); //saturate integrator to prevent unsafe buildup
+    integral_roll_ol = constrain(integral_roll_ol, -fp.i_limit, fp.i_limit); //saturate integrator to prevent unsafe buildup
   derivative_roll    = (roll_IMU - roll_IMU_prev) / dt; 
-  roll_des_ol        = Kp_roll_angle * error_roll + Ki_roll_angle * integral_roll_ol - Kd_roll_angle * derivative_roll;
+  roll_des_ol        = fp.Kp_roll_angle * error_roll + fp.Ki_roll_angle * integral_roll_ol - fp.Kd_roll_angle * derivative_roll;
 
   //Pitch
        error_pitch    = pitch_des - pitch_IMU;
     integral_pitch_ol = (throttle_pwm < 1060) ? 0 : integral_pitch_prev_ol + error_pitch * dt;
-    integral_pitch_ol = constrain(integral_pitch_ol, -i_limit, i_limit); //saturate integrator to prevent unsafe buildup
+    integral_pitch_ol = constrain(integral_pitch_ol, -fp.i_limit, fp.i_limit); //saturate integrator to prevent unsafe buildup
   derivative_pitch    = (pitch_IMU - pitch_IMU_prev) / dt;
-  pitch_des_ol        = Kp_pitch_angle * error_pitch + Ki_pitch_angle * integral_pitch_ol - Kd_pitch_angle*derivative_pitch;
+  pitch_des_ol        = fp.Kp_pitch_angle * error_pitch + fp.Ki_pitch_angle * integral_pitch_ol - fp.Kd_pitch_angle*derivative_pitch;
 
   //Apply loop gain, constrain, and LP filter for artificial damping
   float Kl = 30.0;
@@ -1017,30 +1639,30 @@ void controlANGLE2() {
   pitch_des_ol = Kl * pitch_des_ol;
    roll_des_ol = constrain( roll_des_ol, -240.0, 240.0);
   pitch_des_ol = constrain(pitch_des_ol, -240.0, 240.0);
-   roll_des_ol = (1.0 - B_loop_roll ) *  roll_des_prev + B_loop_roll  *  roll_des_ol;
-  pitch_des_ol = (1.0 - B_loop_pitch) * pitch_des_prev + B_loop_pitch * pitch_des_ol;
+   roll_des_ol = (1.0 - fp.B_loop_roll ) *  roll_des_prev + fp.B_loop_roll  *  roll_des_ol;
+  pitch_des_ol = (1.0 - fp.B_loop_pitch) * pitch_des_prev + fp.B_loop_pitch * pitch_des_ol;
 
   //Inner loop - PID on rate
   //Roll
        error_roll    = roll_des_ol - GyroX;
     integral_roll_il = (throttle_pwm < 1060) ? 0 : integral_roll_prev_il + error_roll*dt;
-    integral_roll_il = constrain(integral_roll_il, -i_limit, i_limit); //saturate integrator to prevent unsafe buildup
-  derivative_roll    = (error_roll - error_roll_prev) / dt; 
-  roll_PID           = .01 * (Kp_roll_rate * error_roll + Ki_roll_rate * integral_roll_il + Kd_roll_rate * derivative_roll); //scaled by .01 to bring within -1 to 1 range
+    integral_roll_il = constrain(integral_roll_il, -fp.i_limit, fp.i_limit); //saturate integrator to prevent unsafe buildup
+  derivative_roll    = dterm_filter.apply(0, (error_roll - error_roll_prev) / dt); 
+  roll_PID           = .01 * (fp.Kp_roll_rate * error_roll + fp.Ki_roll_rate * integral_roll_il + fp.Kd_roll_rate * derivative_roll); //scaled by .01 to bring within -1 to 1 range
 
   //Pitch
        error_pitch    = pitch_des_ol - GyroY;
     integral_pitch_il = (throttle_pwm < 1060) ? 0 : integral_pitch_prev_il + error_pitch*dt;
-    integral_pitch_il = constrain(integral_pitch_il, -i_limit, i_limit); //saturate integrator to prevent unsafe buildup
-  derivative_pitch    = (error_pitch - error_pitch_prev)/dt; 
-  pitch_PID           = .01 * (Kp_pitch_rate * error_pitch + Ki_pitch_rate * integral_pitch_il + Kd_pitch_rate * derivative_pitch); //scaled by .01 to bring within -1 to 1 range
+    integral_pitch_il = constrain(integral_pitch_il, -fp.i_limit, fp.i_limit); //saturate integrator to prevent unsafe buildup
+  derivative_pitch    = dterm_filter.apply(1, (error_pitch - error_pitch_prev)/dt); 
+  pitch_PID           = .01 * (Kp_pitch_rate_faded * error_pitch + fp.Ki_pitch_rate * integral_pitch_il + fp.Kd_pitch_rate * derivative_pitch); //scaled by .01 to bring within -1 to 1 range
   
   //Yaw
        error_yaw = yaw_des - GyroZ;
     integral_yaw = (throttle_pwm < 1060) ? 0 : integral_yaw_prev + error_yaw * dt;
-    integral_yaw = constrain(integral_yaw, -i_limit, i_limit); //saturate integrator to prevent unsafe buildup
-  derivative_yaw = (error_yaw - error_yaw_prev) / dt; 
-  yaw_PID        = .01 * (Kp_yaw * error_yaw + Ki_yaw * integral_yaw + Kd_yaw * derivative_yaw); //scaled by .01 to bring within -1 to 1 range
+    integral_yaw = constrain(integral_yaw, -fp.i_limit, fp.i_limit); //saturate integrator to prevent unsafe buildup
+  derivative_yaw = dterm_filter.apply(2, (error_yaw - error_yaw_prev) / dt); 
+  yaw_PID        = .01 * (fp.Kp_yaw * error_yaw + fp.Ki_yaw * integral_yaw + fp.Kd_yaw * derivative_yaw); //scaled by .01 to bring within -1 to 1 range
   
   //Update roll variables
 
@@ -1070,35 +1692,35 @@ void controlRATE() {
   /*
    * See explanation for controlANGLE(). Everything is the same here except the error is now the desired rate - raw gyro reading.
    */
+  const FlightParams & fp = flight_params.get(); //same parameter set for the whole iteration (see applyFlightParams())
+
   //Roll
        error_roll = roll_des - GyroX;
     integral_roll = (throttle_pwm < 1060) ? 0 : integral_roll_prev + error_roll * dt;
-    integral_roll = constrain(integral_roll, -i_limit, i_limit); //saturate integrator to prevent unsafe buildup
-  derivative_roll = (error_roll - error_roll_prev) / dt;
-  roll_PID        = .01 * (Kp_roll_rate * error_roll + Ki_roll_rate * integral_roll + Kd_roll_rate * derivative_roll); //scaled by .01 to bring within -1 to 1 range
+    integral_roll = constrain(integral_roll, -fp.i_limit, fp.i_limit); //saturate integrator to prevent unsafe buildup
+  derivative_roll = dterm_filter.apply(0, (error_roll - error_roll_prev) / dt);
+  roll_PID        = .01 * (fp.Kp_roll_rate * error_roll + fp.Ki_roll_rate * integral_roll + fp.Kd_roll_rate * derivative_roll); //scaled by .01 to bring within -1 to 1 range
 
   //Pitch
        error_pitch = pitch_des - GyroY;
     integral_pitch = (throttle_pwm < 1060) ? 0 : integral_pitch_prev + error_pitch * dt;
-    integral_pitch = constrain(integral_pitch, -i_limit, i_limit); //saturate integrator to prevent unsafe buildup
-  derivative_pitch = (error_pitch - error_pitch_prev) / dt; 
-  pitch_PID        = .01 * (Kp_pitch_rate * error_pitch + Ki_pitch_rate * integral_pitch + Kd_pitch_rate * derivative_pitch); //scaled by .01 to bring within -1 to 1 range
+    integral_pitch = constrain(integral_pitch, -fp.i_limit, fp.i_limit); //saturate integrator to prevent unsafe buildup
+  derivative_pitch = dterm_filter.apply(1, (error_pitch - error_pitch_prev) / dt); 
+  pitch_PID        = .01 * (Kp_pitch_rate_faded * error_pitch + fp.Ki_pitch_rate * integral_pitch + fp.Kd_pitch_rate * derivative_pitch); //scaled by .01 to bring within -1 to 1 range
 
   //Yaw, stablize on rate from GyroZ
        error_yaw = yaw_des - GyroZ;
     integral_yaw = (throttle_pwm < 1060) ? 0 : integral_yaw_prev + error_yaw * dt;
-    integral_yaw = constrain(integral_yaw, -i_limit, i_limit); //saturate integrator to prevent unsafe buildup
-  derivative_yaw = (error_yaw - error_yaw_prev) / dt; 
-  yaw_PID        = .01 * (Kp_yaw * error_yaw + Ki_yaw * integral_yaw + Kd_yaw * derivative_yaw); //scaled by .01 to bring within -1 to 1 range
+    integral_yaw = constrain(integral_yaw, -fp.i_limit, fp.i_limit); //saturate integrator to prevent unsafe buildup
+  derivative_yaw = dterm_filter.apply(2, (error_yaw - error_yaw_prev) / dt); 
+  yaw_PID        = .01 * (fp.Kp_yaw * error_yaw + fp.Ki_yaw * integral_yaw + fp.Kd_yaw * derivative_yaw); //scaled by .01 to bring within -1 to 1 range
 
   //Update roll variables
   error_roll_prev     = error_roll;
   integral_roll_prev  = integral_roll;
-  GyroX_prev          = GyroX;
   //Update pitch variables
   error_pitch_prev    = error_pitch;
   integral_pitch_prev = integral_pitch;
-  GyroY_prev          = GyroY;
   //Update yaw variables
   error_yaw_prev      = error_yaw;
   integral_yaw_prev   = integral_yaw;
@@ -1114,6 +1736,8 @@ void controlMixer() {
    * roll_passthru, pitch_passthru, and yaw_passthu. mX_command_scaled and sX_command scaled variables are used in scaleCommands() 
    * in preparation to be sent to the motor ESCs and servos.
    */
+  const FlightParams & fp = flight_params.get(); //same parameter set for the whole iteration (see applyFlightParams())
+
 
   if      (aux1_pwm > 1600) vtol_mode = HOVER;
   else if (aux1_pwm < 1400) vtol_mode = FORWARD;
@@ -1127,47 +1751,47 @@ void controlMixer() {
      right_aileron_motor_command_scaled = thro_des + pitch_PID - roll_PID + yaw_PID; //back right
       left_aileron_motor_command_scaled = thro_des + pitch_PID + roll_PID - yaw_PID; //back left
 
-       front_motor_servo_command_scaled = -mx_hover_front_roll_amount * roll_passthru + mx_hover_front_motor_center_offset;    //front motor tilt servo
-     right_aileron_servo_command_scaled =  mx_hover_right_aileron_bottom_offset;  //right aileron, pushed to the far bottom and not moving in hover
-      left_aileron_servo_command_scaled =   mx_hover_left_aileron_bottom_offset;   //left aileron, pushed to the far bottom and not moving in hover
-    right_elevator_servo_command_scaled =  mx_hover_right_elevator_center_offset; //right elevator, centered and not moving in hover
-     left_elevator_servo_command_scaled =   mx_hover_left_elevator_center_offset;  //left elevator, centered and not moving in hover
+       front_motor_servo_command_scaled = -fp.mx_hover_front_roll_amount * roll_passthru + fp.mx_hover_front_motor_center_offset;    //front motor tilt servo
+     right_aileron_servo_command_scaled =  fp.mx_hover_right_aileron_bottom_offset;  //right aileron, pushed to the far bottom and not moving in hover
+      left_aileron_servo_command_scaled =   fp.mx_hover_left_aileron_bottom_offset;   //left aileron, pushed to the far bottom and not moving in hover
+    right_elevator_servo_command_scaled =  fp.mx_hover_right_elevator_center_offset; //right elevator, centered and not moving in hover
+     left_elevator_servo_command_scaled =   fp.mx_hover_left_elevator_center_offset;  //left elevator, centered and not moving in hover
   }
   else if (vtol_mode == FORWARD) {
              front_motor_command_scaled = 0;        //turn off in forward flight
      right_aileron_motor_command_scaled = thro_des; //direct control from transmitter throttle
       left_aileron_motor_command_scaled = thro_des; //direct control from transmitter throttle
 
-       front_motor_servo_command_scaled =   mx_fw_front_motor_center_offset;                                                                  //front motor tilt not moving
-     right_aileron_servo_command_scaled =  -mx_fw_roll_amount * roll_passthru + mx_fw_pitch_amount *  pitch_passthru + mx_fw_right_aileron_center_offset;   //right aileron
-      left_aileron_servo_command_scaled =  -mx_fw_roll_amount * roll_passthru + mx_fw_pitch_amount * -pitch_passthru + mx_fw_left_aileron_center_offset;    //left aileron (inverse from the other)
-    right_elevator_servo_command_scaled =  -mx_fw_roll_amount * roll_passthru + mx_fw_pitch_amount *  pitch_passthru + mx_fw_right_elevator_center_offset;  //right elevator
-     left_elevator_servo_command_scaled =  -mx_fw_roll_amount * roll_passthru + mx_fw_pitch_amount * -pitch_passthru + mx_fw_left_elevator_center_offset;   //left elevator
+       front_motor_servo_command_scaled =   fp.mx_fw_front_motor_center_offset;                                                                  //front motor tilt not moving
+     right_aileron_servo_command_scaled =  -fp.mx_fw_roll_amount * roll_passthru + fp.mx_fw_pitch_amount *  pitch_passthru + fp.mx_fw_right_aileron_center_offset;   //right aileron
+      left_aileron_servo_command_scaled =  -fp.mx_fw_roll_amount * roll_passthru + fp.mx_fw_pitch_amount * -pitch_passthru + fp.mx_fw_left_aileron_center_offset;    //left aileron (inverse from the other)
+    right_elevator_servo_command_scaled =  -fp.mx_fw_roll_amount * roll_passthru + fp.mx_fw_pitch_amount *  pitch_passthru + fp.mx_fw_right_elevator_center_offset;  //right elevator
+     left_elevator_servo_command_scaled =  -fp.mx_fw_roll_amount * roll_passthru + fp.mx_fw_pitch_amount * -pitch_passthru + fp.mx_fw_left_elevator_center_offset;   //left elevator
   }
   else { // Transition mode
              front_motor_command_scaled = 2 * (thro_des - pitch_PID);                      //front
      right_aileron_motor_command_scaled = thro_des + pitch_PID - roll_PID + yaw_PID; //back right
       left_aileron_motor_command_scaled = thro_des + pitch_PID + roll_PID - yaw_PID; //back left
 
-       front_motor_servo_command_scaled = -mx_trans_front_roll_amount * roll_passthru + mx_trans_front_motor_center_offset;    //front motor tilt servo
-     right_aileron_servo_command_scaled =  mx_trans_right_aileron_45_offset;      //right aileron, pushed to the far bottom and not moving in hover
-      left_aileron_servo_command_scaled =   mx_trans_left_aileron_45_offset;      //left aileron, pushed to the far bottom and not moving in hover
-    right_elevator_servo_command_scaled =  mx_trans_right_elevator_center_offset; //right elevator, centered and not moving in hover
-     left_elevator_servo_command_scaled =   mx_trans_left_elevator_center_offset; //left elevator, centered and not moving in hover    
+       front_motor_servo_command_scaled = -fp.mx_trans_front_roll_amount * roll_passthru + fp.mx_trans_front_motor_center_offset;    //front motor tilt servo
+     right_aileron_servo_command_scaled =  fp.mx_trans_right_aileron_45_offset;      //right aileron, pushed to the far bottom and not moving in hover
+      left_aileron_servo_command_scaled =   fp.mx_trans_left_aileron_45_offset;      //left aileron, pushed to the far bottom and not moving in hover
+    right_elevator_servo_command_scaled =  fp.mx_trans_right_elevator_center_offset; //right elevator, centered and not moving in hover
+     left_elevator_servo_command_scaled =   fp.mx_trans_left_elevator_center_offset; //left elevator, centered and not moving in hover    
 
     if (vtol_mode == FORWARD_TO_HOVER) { //go to max specified value in mx_trans_pitch_to_over_duration seconds
-      Kp_pitch_rate = floatFaderLinear(Kp_pitch_rate, 
-                                       mx_trans_pitch_rate_low,            // minimum value
-                                       mx_trans_pitch_rate_high,           // maximum value
-                                       mx_trans_pitch_to_over_duration,    // fade time
-                                       1, 2000);                           // state (0 min or 1 max), loop frequency
+      Kp_pitch_rate_faded = floatFaderLinear(Kp_pitch_rate_faded, 
+                                             fp.mx_trans_pitch_rate_low,            // minimum value
+                                             fp.mx_trans_pitch_rate_high,           // maximum value
+                                             fp.mx_trans_pitch_to_over_duration,    // fade time
+                                             1, 2000);                              // state (0 min or 1 max), loop frequency
     }
     if (vtol_mode == HOVER_TO_FORWARD) { //go to min specified value in mx_trans_pitch_to_forward_duration seconds
-      Kp_pitch_rate = floatFaderLinear(Kp_pitch_rate, 
-                                       mx_trans_pitch_rate_low,            // minimum value
-                                       mx_trans_pitch_rate_high,           // maximum value
-                                       mx_trans_pitch_to_forward_duration, // fade time
-                                       0, 2000);                           // state (0 min or 1 max), loop frequency
+      Kp_pitch_rate_faded = floatFaderLinear(Kp_pitch_rate_faded, 
+                                             fp.mx_trans_pitch_rate_low,            // minimum value
+                                             fp.mx_trans_pitch_rate_high,           // maximum value
+                                             fp.mx_trans_pitch_to_forward_duration, // fade time
+                                             0, 2000);                              // state (0 min or 1 max), loop frequency
     }
   }
 }
@@ -1175,23 +1799,26 @@ void controlMixer() {
 void scaleCommands() {
   //DESCRIPTION: Scale normalized actuator commands to values for ESC/Servo protocol
   /*
-   * mX_command_scaled variables from the mixer function are scaled to 125-250us for OneShot125 protocol. sX_command_scaled variables from
+   * mX_command_scaled variables from the mixer function are scaled to 125-250us for OneShot125 protocol, or to the 48-2047 throttle
+   * values of the DShot protocol (MOTOR_COMMAND_MIN to MOTOR_COMMAND_MAX). sX_command_scaled variables from
    * the mixer function are scaled to 0-180 for the servo library using standard PWM.
    * mX_command_PWM are updated here which are used to command the motors in commandMotors(). sX_command_PWM are updated 
    * which are used to command the servos.
    */
 
-  //Scaled to 125us - 250us for oneshot125 protocol
+  //Scaled to 125us - 250us for oneshot125 protocol, 48 - 2047 for DShot
 
-          front_motor_command_PWM =         front_motor_command_scaled * 125 + 125;
-  right_aileron_motor_command_PWM = right_aileron_motor_command_scaled * 125 + 125;
-   left_aileron_motor_command_PWM =  left_aileron_motor_command_scaled * 125 + 125;
+  const float motor_range = MOTOR_COMMAND_MAX - MOTOR_COMMAND_MIN;
 
-  //Constrain commands to motors within oneshot125 bounds
+          front_motor_command_PWM =         front_motor_command_scaled * motor_range + MOTOR_COMMAND_MIN;
+  right_aileron_motor_command_PWM = right_aileron_motor_command_scaled * motor_range + MOTOR_COMMAND_MIN;
+   left_aileron_motor_command_PWM =  left_aileron_motor_command_scaled * motor_range + MOTOR_COMMAND_MIN;
 
-          front_motor_command_PWM = constrain(        front_motor_command_PWM, 125, 250);
-  right_aileron_motor_command_PWM = constrain(right_aileron_motor_command_PWM, 125, 250);
-   left_aileron_motor_command_PWM = constrain( left_aileron_motor_command_PWM, 125, 250);
+  //Constrain commands to motors within protocol bounds
+
+          front_motor_command_PWM = constrain(        front_motor_command_PWM, MOTOR_COMMAND_MIN, MOTOR_COMMAND_MAX);
+  right_aileron_motor_command_PWM = constrain(right_aileron_motor_command_PWM, MOTOR_COMMAND_MIN, MOTOR_COMMAND_MAX);
+   left_aileron_motor_command_PWM = constrain( left_aileron_motor_command_PWM, MOTOR_COMMAND_MIN, MOTOR_COMMAND_MAX);
 
   //Scaled to 0-180 for servo library
 
@@ -1247,7 +1874,11 @@ void getCommands() {
   #endif
   
   //Low-pass the critical commands and update previous values
-  float b = 0.2; //lower=slower, higher=noiser
+  //b = 0.2 per 2kHz step (lower=slower, higher=noiser), adjusted to the time elapsed since the previous call
+  static unsigned long prev_commands_time = 0;
+  unsigned long commands_time = micros();
+  float b = 1.0 - powf(0.8, (commands_time - prev_commands_time) * 0.002);
+  prev_commands_time = commands_time;
   throttle_pwm      = (1.0 - b) * throttle_pwm_prev + b * throttle_pwm;
    aileron_pwm      = (1.0 - b) *  aileron_pwm_prev + b *  aileron_pwm;
   elevator_pwm      = (1.0 - b) * elevator_pwm_prev + b * elevator_pwm;
@@ -1280,14 +1911,16 @@ void failSafe() {
     failed = false;
   #endif
 
-  if (failed ||
+  failSafeActive = failed ||
       !(
         ((    throttle_pwm >= minVal) && (    throttle_pwm <= maxVal)) &&
         ((     aileron_pwm >= minVal) && (     aileron_pwm <= maxVal)) &&
         ((    elevator_pwm >= minVal) && (    elevator_pwm <= maxVal)) &&
         ((      rudder_pwm >= minVal) && (      rudder_pwm <= maxVal)) &&
         ((throttle_cut_pwm >= minVal) && (throttle_cut_pwm <= maxVal)) &&
-        ((        aux1_pwm >= minVal) && (        aux1_pwm <= maxVal)))) {
+        ((        aux1_pwm >= minVal) && (        aux1_pwm <= maxVal)));
+
+  if (failSafeActive) {
 
     //Triggers for failure criteria
 
@@ -1300,12 +1933,385 @@ void failSafe() {
   }
 }
 
+void radioTask() {
+  //DESCRIPTION: Scheduler task, get vehicle commands for the next control iterations
+  PROFILE(ProfileStage::RADIO, getCommands()); //pulls current available radio commands
+  failSafe();    //prevent failures in event of bad receiver connection, defaults to failsafe values assigned in setup
+}
+
+void usbOutputTask() {
+  //DESCRIPTION: Scheduler task, print debugging data at 100hz as selected in the Config debug menu
+  uint32_t print_start = profiler.start();
+
+  switch (USB_output) {  // GT
+    case  1: printTelemetryView();  break;
+    case  2: printRadioData();      break; //radio pwm values (expected: 1000 to 2000)
+    case  3: printDesiredState();   break; //prints desired vehicle state commanded in either degrees or deg/sec (expected: +/- maxAXIS for roll, pitch, yaw; 0 to 1 for throttle)
+    case  4: printGyroData();       break; //prints filtered gyro data direct from IMU (expected: ~ -250 to 250, 0 at rest)
+    case  5: printAccelData();      break; //prints filtered accelerometer data direct from IMU (expected: ~ -2 to 2; x,y 0 when level, z 1 when level)
+    case  6: printMagData();        break; //prints filtered magnetometer data direct from IMU (expected: ~ -300 to 300)
+    case  7: printRollPitchYaw();   break; //prints roll, pitch, and yaw angles in degrees from Madgwick filter (expected: degrees, 0 when level)
+    case  8: printPIDoutput();      break; //prints computed stabilized PID variables from controller and desired setpoint (expected: ~ -1 to 1)
+    case  9: printMotorCommands();  break; //prints the values being written to the motors (expected: 120 to 250, DShot: 0 to 2047)
+    case 10: printServoCommands();  break; //prints the values being written to the servos (expected: 0 to 180)
+    case 11: printLoopRate();       break; //prints the time between loops in microseconds (expected: microseconds between loop iterations)
+    case 12: printSchedulerStats(); break; //prints background tasks timing once per second
+    case 13: printLoopProfile();    break; //prints and resets loop stages timing once per second
+    case 14: printMotorsRPM();      break; //prints the motors RPM from bidirectional DShot telemetry
+    case 15: printGyroFFTPeaks();   break; //prints the gyro vibration peaks tracked by the dynamic notch filters
+    default:                        break; //16: binary Telemetry View, sent by telemetryTask()
+  }
+
+  profiler.stop(ProfileStage::PRINT, print_start);
+}
+
+void telemetryTask() {
+  //DESCRIPTION: Scheduler task, send the due telemetry streams lines and the binary Telemetry View packet at 500Hz when selected in the Config debug menu
+  static unsigned long last_packet = 0;
+
+  uint32_t print_start = profiler.start();
+
+  telemetry.run();
+
+  if ((USB_output == 16) && ((current_time - last_packet) >= 2000)) {
+    last_packet = current_time;
+    sendTelemetryViewPacket();
+  }
+
+  profiler.stop(ProfileStage::PRINT, print_start);
+}
+
+void setupTelemetry() {
+  //DESCRIPTION: Register the variables that can be sent by the telemetry streams and start the streams set in the Config menu
+  /*
+   * Streams can also be changed at runtime with USB commands: "t" lists the fields and groups, "t1 200 gyro pid dt"
+   * sends the gyro and PID groups and the loop time at 200Hz on stream 1, "t1 0" stops it. See Telemetry/telemetry.h.
+   * The USB lines are read by the Config command line, an empty line opens the Config menu instead.
+   */
+  config.set_command_handler([](char * cmd) { telemetry.execute(cmd); });
+
+  telemetry.add_field("GyroX",                TelemetryGroup::GYRO,       &GyroX);
+  telemetry.add_field("GyroY",                TelemetryGroup::GYRO,       &GyroY);
+  telemetry.add_field("GyroZ",                TelemetryGroup::GYRO,       &GyroZ);
+  telemetry.add_field("AccX",                 TelemetryGroup::ACCEL,      &AccX);
+  telemetry.add_field("AccY",                 TelemetryGroup::ACCEL,      &AccY);
+  telemetry.add_field("AccZ",                 TelemetryGroup::ACCEL,      &AccZ);
+  telemetry.add_field("MagX",                 TelemetryGroup::MAG,        &MagX);
+  telemetry.add_field("MagY",                 TelemetryGroup::MAG,        &MagY);
+  telemetry.add_field("MagZ",                 TelemetryGroup::MAG,        &MagZ);
+  telemetry.add_field("roll_IMU",             TelemetryGroup::ATTITUDE,   &roll_IMU);
+  telemetry.add_field("pitch_IMU",            TelemetryGroup::ATTITUDE,   &pitch_IMU);
+  telemetry.add_field("yaw_IMU",              TelemetryGroup::ATTITUDE,   &yaw_IMU);
+  telemetry.add_field("q0",                   TelemetryGroup::QUATERNION, &q0);
+  telemetry.add_field("q1",                   TelemetryGroup::QUATERNION, &q1);
+  telemetry.add_field("q2",                   TelemetryGroup::QUATERNION, &q2);
+  telemetry.add_field("q3",                   TelemetryGroup::QUATERNION, &q3);
+  telemetry.add_field("thro_des",             TelemetryGroup::DES_STATE,  &thro_des);
+  telemetry.add_field("roll_des",             TelemetryGroup::DES_STATE,  &roll_des);
+  telemetry.add_field("pitch_des",            TelemetryGroup::DES_STATE,  &pitch_des);
+  telemetry.add_field("yaw_des",              TelemetryGroup::DES_STATE,  &yaw_des);
+  telemetry.add_field("roll_PID",             TelemetryGroup::PID,        &roll_PID);
+  telemetry.add_field("pitch_PID",            TelemetryGroup::PID,        &pitch_PID);
+  telemetry.add_field("yaw_PID",              TelemetryGroup::PID,        &yaw_PID);
+  telemetry.add_field("front_motor",          TelemetryGroup::MOTORS,     &front_motor_command_PWM);
+  telemetry.add_field("right_aileron_motor",  TelemetryGroup::MOTORS,     &right_aileron_motor_command_PWM);
+  telemetry.add_field("left_aileron_motor",   TelemetryGroup::MOTORS,     &left_aileron_motor_command_PWM);
+  telemetry.add_field("front_motor_servo",    TelemetryGroup::SERVOS,     &front_motor_servo_command_PWM);
+  telemetry.add_field("right_aileron_servo",  TelemetryGroup::SERVOS,     &right_aileron_servo_command_PWM);
+  telemetry.add_field("left_aileron_servo",   TelemetryGroup::SERVOS,     &left_aileron_servo_command_PWM);
+  telemetry.add_field("right_elevator_servo", TelemetryGroup::SERVOS,     &right_elevator_servo_command_PWM);
+  telemetry.add_field("left_elevator_servo",  TelemetryGroup::SERVOS,     &left_elevator_servo_command_PWM);
+  telemetry.add_field("throttle_pwm",         TelemetryGroup::RADIO,      &throttle_pwm);
+  telemetry.add_field("aileron_pwm",          TelemetryGroup::RADIO,      &aileron_pwm);
+  telemetry.add_field("elevator_pwm",         TelemetryGroup::RADIO,      &elevator_pwm);
+  telemetry.add_field("rudder_pwm",           TelemetryGroup::RADIO,      &rudder_pwm);
+  telemetry.add_field("throttle_cut_pwm",     TelemetryGroup::RADIO,      &throttle_cut_pwm);
+  telemetry.add_field("aux1_pwm",             TelemetryGroup::RADIO,      &aux1_pwm);
+  telemetry.add_field("dt",                   TelemetryGroup::LOOP,       &dt);
+  telemetry.add_field("current_time",         TelemetryGroup::LOOP,       &current_time);
+
+  telemetry.set_stream(0, telemetry_rate_0, telemetry_groups_0);
+  telemetry.set_stream(1, telemetry_rate_1, telemetry_groups_1);
+}
+
 void commandMotors() {
-  //DESCRIPTION: Send pulses to motor pins, oneshot125 protocol
+  //DESCRIPTION: Send pulses to motor pins, oneshot125 or DShot protocol
+  /*
+   * With USE_DSHOT600/300/150, mX_command_PWM are DShot throttle values. The frames of all motors are built and handed to
+   * the DMA engine, which shifts them out in parallel while the CPU returns to the loop. Frames are not sent if the previous
+   * ones are still in flight.
+   * With USE_ONESHOT125_PWM, the pulse lengths mX_command_PWM computed in scaleCommands() are latched in the FlexPWM/QuadTimer
+   * registers of each motor pin. The hardware generates the 125 - 250us pulses by itself and this function returns immediately.
+   * With USE_ONESHOT125_BITBANG, my crude implimentation of OneShot125 protocol which sends 125 - 250us pulses to the ESCs (mXPin)
+   * by busy-waiting on micros() is used.
+   */
+  #if defined USE_DSHOT
+    dshot.write(       frontMotorPin,         front_motor_command_PWM);
+    dshot.write(rightAileronMotorPin, right_aileron_motor_command_PWM);
+    dshot.write( leftAileronMotorPin,  left_aileron_motor_command_PWM);
+    dshot.send();
+
+    #if defined USE_DSHOT_BIDIR
+      updateRPMfilter(); //telemetry answers to the previous frames were decoded by send()
+    #endif
+  #elif defined USE_ONESHOT125_PWM
+    oneshot125.write(       frontMotorPin,         front_motor_command_PWM);
+    oneshot125.write(rightAileronMotorPin, right_aileron_motor_command_PWM);
+    oneshot125.write( leftAileronMotorPin,  left_aileron_motor_command_PWM);
+  #else
+    commandMotorsBitBang();
+  #endif
+}
+
+#if defined USE_DSHOT_BIDIR
+void updateRPMfilter() {
+  //DESCRIPTION: Get the motors RPM from the DShot telemetry and retune the gyro notch filters on them
+  /*
+   * ESCs report the electrical RPM, which is the mechanical RPM times the number of pole pairs (motor_poles / 2). Each motor
+   * gets one notch at its rotation frequency (RPM / 60) and one per harmonic, shared by the three gyro axes. Notches are
+   * kept at or above rpm_notch_min_hz (idle motors, no telemetry) and disabled when too close to the Nyquist frequency.
+   */
+  if (dt <= 0.0) return;
+
+  float pole_pairs = (motor_poles >= 2) ? (motor_poles / 2) : 1;
+
+          front_motor_rpm = dshot.get_erpm(       frontMotorPin) / pole_pairs;
+  right_aileron_motor_rpm = dshot.get_erpm(rightAileronMotorPin) / pole_pairs;
+   left_aileron_motor_rpm = dshot.get_erpm( leftAileronMotorPin) / pole_pairs;
+
+  float motor_hz[3] = { front_motor_rpm / 60.0f, right_aileron_motor_rpm / 60.0f, left_aileron_motor_rpm / 60.0f };
+  float sample_hz   = 1.0f / dt;
+
+  for (int m = 0; m < 3; m++) {
+    for (int h = 0; h < RPM_NOTCH_HARMONICS; h++) {
+      float center_hz = max(motor_hz[m] * (h + 1), rpm_notch_min_hz);
+
+      if (center_hz < 0.45f * sample_hz) {
+        rpm_notch[m][h][0].notch(center_hz, sample_hz, rpm_notch_q);
+      }
+      else {
+        rpm_notch[m][h][0].passthrough();
+      }
+      rpm_notch[m][h][1].copy_coefficients(rpm_notch[m][h][0]);
+      rpm_notch[m][h][2].copy_coefficients(rpm_notch[m][h][0]);
+    }
+  }
+}
+#endif
+
+void setupFilterBanks(float sample_hz) {
+  //DESCRIPTION: Compute the gyro, accelerometer and D-term biquad filter banks from the filter_menu parameters
+  /*
+   * Stages are defined in Hz, one set to 0 is disabled. The coefficients depend on the loop rate: this function is called
+   * again by filterTask() when the measured loop rate drifts or a parameter is changed. The banks are run by the
+   * CMSIS-DSP arm_biquad_cascade_df1_f32() function (see src/Filters/biquad_bank.h).
+   */
+  gyro_filter.clear();
+  gyro_filter.add_lowpass(gyro_lpf_hz);
+  gyro_filter.add_notch(gyro_notch_hz, gyro_notch_q);
+  gyro_filter.configure(sample_hz);
+
+  accel_filter.clear();
+  accel_filter.add_lowpass(accel_lpf_hz);
+  accel_filter.configure(sample_hz);
+
+  dterm_filter.clear();
+  dterm_filter.add_lowpass(dterm_lpf_hz);
+  dterm_filter.configure(sample_hz);
+
+  #if defined USE_GYRO_FFT
+    if (!gyro_fft.configure(sample_hz, dyn_notch_min_hz, dyn_notch_max_hz)) {
+      console.println(F("Dynamic notch disabled: empty dyn_notch_min_hz - dyn_notch_max_hz range"));
+    }
+  #endif
+
+  filter_sample_hz = sample_hz;
+}
+
+void filterTask() {
+  //DESCRIPTION: Scheduler task, recompute the biquad filter banks when the loop rate or a filter parameter changed
+  static unsigned long last_count = 0, last_time = 0;
+  static float         last_params[8];
+  static float         last_B_accel = -1.0, last_B_gyro = -1.0;
+
+  unsigned long now   = micros();
+  float         rate  = (loop_counter - last_count) * 1000000.0 / (now - last_time);
+  bool          valid = (last_time != 0) && (rate > 100.0); //no control loop in receiver only mode
+
+  last_count = loop_counter;
+  last_time  = now;
+
+  float params[8] = { gyro_lpf_hz, gyro_notch_hz, gyro_notch_q, accel_lpf_hz, dterm_lpf_hz,
+                      dyn_notch_q, dyn_notch_min_hz, dyn_notch_max_hz };
+  bool  changed   = memcmp(params, last_params, sizeof(params)) != 0;
+
+  if (changed) memcpy(last_params, params, sizeof(params));
+  if (!valid) rate = filter_sample_hz;
+
+  if (changed || (fabs(rate - filter_sample_hz) > 0.05 * filter_sample_hz)) {
+    setupFilterBanks(rate);
+  }
+
+  //IMU low-pass filter parameters, folded in the sensor pipeline
+  if ((B_accel != last_B_accel) || (B_gyro != last_B_gyro)) {
+    last_B_accel = B_accel;
+    last_B_gyro  = B_gyro;
+    if (receiver_only == 0) setupIMUPipeline();
+  }
+}
+
+#if defined USE_GYRO_FFT
+void fftTask() {
+  //DESCRIPTION: Scheduler task, one step of the gyro spectrum analysis and retune of the dynamic notch filters
+  /*
+   * Each run transforms one gyro axis, the fourth one searches the summed spectrum for up to three vibration peaks between
+   * dyn_notch_min_hz and dyn_notch_max_hz. The peaks move with the throttle and between the HOVER and FORWARD modes, the
+   * notch filters follow them. A notch without a peak is disabled.
+   */
+  if (!gyro_fft.update()) return;
+
+  for (int p = 0; p < GyroFFT::MAX_PEAKS; p++) {
+    if ((p < gyro_fft.get_peak_count()) && (gyro_fft.get_peak_hz(p) < 0.45f * filter_sample_hz)) {
+      dyn_notch[p][0].notch(gyro_fft.get_peak_hz(p), filter_sample_hz, dyn_notch_q);
+    }
+    else {
+      dyn_notch[p][0].passthrough();
+    }
+    dyn_notch[p][1].copy_coefficients(dyn_notch[p][0]);
+    dyn_notch[p][2].copy_coefficients(dyn_notch[p][0]);
+  }
+}
+#endif
+
+#if defined USE_BLACKBOX
+void blackboxLog(unsigned long exec_us) {
+  //DESCRIPTION: Start or stop the recording with the arming state, and log the current iteration every blackbox_divider loops
+  /*
+   * Armed means throttle cut off (throttle_cut_pwm >= 1600, see throttleCut()). Recording starts on the next arming once
+   * blackbox.setup() or the previous stop has prepared a log file. The frame is delta encoded (see blackbox_format.h) and
+   * only copied to the RAM ring: if the SD card is not keeping up, the frame is dropped and counted, the control loop never
+   * waits. The next frame is then an intra frame.
+   */
+  static unsigned long count = 0;
+  static char          header[1536];   //written once per arming, before the first frame
+
+  bool armed = (throttle_cut_pwm >= 1600) && (blackbox_divider > 0);
+
+  if (!blackbox.is_recording()) {
+    if (!armed || (blackbox.get_state() != Blackbox::State::READY)) return;
+
+    int size = blackbox_encoder.write_header(header, sizeof(header), blackbox_divider, filter_sample_hz);
+    blackbox_encoder.reset(); //the log starts with an intra frame
+    blackbox.start((const uint8_t *) header, size);
+    count = 0;
+  }
+  else if (!armed) {
+    blackbox.stop();
+    return;
+  }
+
+  if (++count < blackbox_divider) return;
+  count = 0;
+
+  //Same order as blackbox_fields[], the floats are scaled to integers with its scale column
+  int32_t values[BLACKBOX_FIELD_COUNT];
+  int     n = 0;
+
+  auto put        = [&](int32_t value) { values[n++] = value; };
+  auto put_scaled = [&](float   value) { values[n] = BlackboxEncoder::to_field(value, blackbox_fields[n].scale); n++; };
+
+  put(current_time);
+  put(dt * 1000000.0f);
+  put(exec_us);
+  put(vtol_mode);
+  #if defined USE_SBUS_RX
+    put((sbusFailSafe ? 0x01 : 0) | (sbusLostFrame ? 0x02 : 0));
+  #else
+    put(0);
+  #endif
+  for (int i = 0; i < 3; i++) put(imu_raw.acc[i]);
+  for (int i = 0; i < 3; i++) put(imu_raw.gyro[i]);
+  put_scaled(roll_IMU);
+  put_scaled(pitch_IMU);
+  put_scaled(yaw_IMU);
+  put_scaled(thro_des);
+  put_scaled(roll_des);
+  put_scaled(pitch_des);
+  put_scaled(yaw_des);
+  put_scaled(error_roll);
+  put_scaled(error_pitch);
+  put_scaled(error_yaw);
+  put_scaled(integral_roll);
+  put_scaled(integral_pitch);
+  put_scaled(integral_yaw);
+  put_scaled(derivative_roll);
+  put_scaled(derivative_pitch);
+  put_scaled(derivative_yaw);
+  put_scaled(roll_PID);
+  put_scaled(pitch_PID);
+  put_scaled(yaw_PID);
+  put(throttle_pwm);
+  put(aileron_pwm);
+  put(elevator_pwm);
+  put(rudder_pwm);
+  put(throttle_cut_pwm);
+  put(aux1_pwm);
+  put(front_motor_command_PWM);
+  put(right_aileron_motor_command_PWM);
+  put(left_aileron_motor_command_PWM);
+  put(front_motor_servo_command_PWM);
+  put(right_aileron_servo_command_PWM);
+  put(left_aileron_servo_command_PWM);
+  put(right_elevator_servo_command_PWM);
+  put(left_elevator_servo_command_PWM);
+
+  uint8_t frame[BlackboxEncoder::MAX_FRAME_SIZE];
+  int     size = blackbox_encoder.encode(values, frame);
+
+  if (!blackbox.log(frame, size)) {
+    blackbox_encoder.reset(); //a dropped frame breaks the predictions, the decoder resyncs on the next intra frame
+  }
+}
+
+void blackboxTask() {
+  //DESCRIPTION: Scheduler task, writes the full sectors of the blackbox ring to the SD card, never waiting for a busy card
+  blackbox.run();
+}
+#endif
+
+#if defined USE_SPORT
+void sportTask() {
+  //DESCRIPTION: Scheduler task, serialize the S.Port sensor values for the LPUART7 interrupt
   /*
-   * My crude implimentation of OneShot125 protocol which sends 125 - 250us pulses to the ESCs (mXPin). The pulselengths being
-   * sent are mX_command_PWM, computed in scaleCommands(). This may be replaced by something more efficient in the future.
+   * The receiver polls the sensor and expects the reply within a few hundred microseconds: the poll is answered by the
+   * LPUART7 interrupt (see SPort/sport.h) with frames prepared here, one value per poll. Angles are sent in 0.1 degree.
+   * The flags value is bit 0: failsafe values in use, bit 1: SBUS failsafe, bit 2: SBUS lost frame. The battery
+   * values (SPort::VFAS, SPort::CURRENT, SPort::FUEL) are to be added here once a battery monitor is connected.
    */
+  static unsigned long last_count = 0, last_time = 0;
+
+  unsigned long now  = micros();
+  float         rate = (last_time == 0) ? 0.0 : (loop_counter - last_count) * 1000000.0 / (now - last_time);
+
+  last_count = loop_counter;
+  last_time  = now;
+
+  int flags = failSafeActive ? 0x01 : 0;
+  #if defined USE_SBUS_RX
+    flags |= (sbusFailSafe ? 0x02 : 0) | (sbusLostFrame ? 0x04 : 0);
+  #endif
+
+  sport.set_value(SPort::ROLL,      lroundf(roll_IMU  * 10.0f));
+  sport.set_value(SPort::PITCH,     lroundf(pitch_IMU * 10.0f));
+  sport.set_value(SPort::YAW,       lroundf(yaw_IMU   * 10.0f));
+  sport.set_value(SPort::VTOL_MODE, vtol_mode);
+  sport.set_value(SPort::LOOP_RATE, lroundf(rate));
+  sport.set_value(SPort::FAILSAFE,  flags);
+}
+#endif
+
+void commandMotorsBitBang() {
+  //DESCRIPTION: Send pulses to motor pins, oneshot125 protocol generated in software
   int wentLow = 0;
   int pulseStart, timer;
   int flagM1 = 0;
@@ -1399,15 +2405,15 @@ void throttleCut() {
   //DESCRIPTION: Directly set actuator outputs to minimum value if triggered
   /*
    * Monitors the state of radio command throttle_cut_pwm and directly sets the mx_command_PWM values to minimum (120 is
-   * minimum for oneshot125 protocol, 0 is minimum for standard PWM servo library used) if channel 5 is high. This is the last function 
+   * minimum for oneshot125 protocol, 0 (motor stop) for DShot, 0 is minimum for standard PWM servo library used) if channel 5 is high. This is the last function 
    * called before commandMotors() is called so that the last thing checked is if the user is giving permission to command
    * the motors to anything other than minimum value. Safety first. 
    */
   if (throttle_cut_pwm < 1600) {
 
-            front_motor_command_PWM = 120;
-    right_aileron_motor_command_PWM = 120;
-     left_aileron_motor_command_PWM = 120;
+            front_motor_command_PWM = MOTOR_COMMAND_STOP;
+    right_aileron_motor_command_PWM = MOTOR_COMMAND_STOP;
+     left_aileron_motor_command_PWM = MOTOR_COMMAND_STOP;
 
     
     //uncomment if using servo PWM variables to control motor ESCs
@@ -1468,6 +2474,109 @@ void calibrateMagnetometer() {
   while(1); //halt code so it won't enter main loop until this function commented out
 }
 
+void calibrateIMUoffsets() {
+  #if defined USE_MPU6050_DMP
+    Serial.println("Beginning MPU6050 offsets calibration, keep the vehicle level and still...");
+    delay(1000);
+
+    mpu6050.setDMPEnabled(false);
+    mpu6050.CalibrateAccel(6); //PID tuning of the offset registers, ~700 readings each
+    mpu6050.CalibrateGyro(6);
+
+    Serial.println("Calibration complete.");
+    Serial.println("Please comment out the calibrateIMUoffsets() function and enter these values in the IMU Offsets Params menu:");
+    Serial.printf(F("float AccOffsetX  = %d;\n"), mpu6050.getXAccelOffset());
+    Serial.printf(F("float AccOffsetY  = %d;\n"), mpu6050.getYAccelOffset());
+    Serial.printf(F("float AccOffsetZ  = %d;\n"), mpu6050.getZAccelOffset());
+    Serial.printf(F("float GyroOffsetX = %d;\n"), mpu6050.getXGyroOffset());
+    Serial.printf(F("float GyroOffsetY = %d;\n"), mpu6050.getYGyroOffset());
+    Serial.printf(F("float GyroOffsetZ = %d;\n"), mpu6050.getZGyroOffset());
+    Serial.println(" ");
+
+    while(1); //halt code so it won't enter main loop until this function commented out
+  #endif
+  Serial.println("Error: USE_MPU6050_DMP not selected. The offsets are only used by the DMP.");
+  while(1); //halt code so it won't enter main loop until this function commented out
+}
+
+void benchmarkAttitude() {
+  //DESCRIPTION: Compare the DMP attitude with Madgwick6DOF() running on the Teensy
+  /*
+   * Both attitude sources run side by side at 500Hz for 4 seconds while the vehicle is rocked about its roll axis by hand.
+   * The CPU time of each call is measured with the cycle counter; for the DMP, it is mostly spent in the blocking I2C
+   * transfers. The DMP latency is the delay that best aligns its roll angle on the Madgwick one (cross-correlation), the
+   * Madgwick filter being fed with fresh sensor values at every iteration.
+   */
+  #if defined USE_MPU6050_DMP
+    const int SAMPLES = 2000;
+    const int MAX_LAG =   50; //100ms
+    static float roll_madgwick[SAMPLES], roll_dmp[SAMPLES];
+
+    uint64_t madgwick_cycles = 0, dmp_cycles = 0;
+    uint32_t madgwick_max    = 0, dmp_max    = 0;
+    float    q[4]            = { 1.0f, 0.0f, 0.0f, 0.0f };
+
+    Serial.println("Rock the vehicle about its roll axis for 4 seconds...");
+    delay(1000);
+    dmp_packets = 0;
+
+    for (int i = 0; i < SAMPLES; i++) {
+      prev_time    = current_time;      
+      current_time = micros();      
+      dt           = (current_time - prev_time) / 1000000.0;
+      getIMUdata();
+
+      uint32_t start  = ARM_DWT_CYCCNT;
+      Madgwick6DOF(GyroX, -GyroY, -GyroZ, -AccX, AccY, AccZ, dt);
+      uint32_t cycles = ARM_DWT_CYCCNT - start;
+      madgwick_cycles += cycles;
+      if (cycles > madgwick_max) madgwick_max = cycles;
+      roll_madgwick[i] = roll_IMU;
+
+      start  = ARM_DWT_CYCCNT;
+      readDMPquaternion(q);
+      cycles = ARM_DWT_CYCCNT - start;
+      dmp_cycles += cycles;
+      if (cycles > dmp_max) dmp_max = cycles;
+      roll_dmp[i] = atan2(q[0] * q[1] + q[2] * q[3], 0.5f - q[1] * q[1] - q[2] * q[2]) * 57.29577951;
+
+      loopRate(500);
+    }
+
+    float mean_madgwick = 0.0, mean_dmp = 0.0;
+    for (int i = 0; i < SAMPLES; i++) {
+      mean_madgwick += roll_madgwick[i];
+      mean_dmp      += roll_dmp[i];
+    }
+    mean_madgwick /= SAMPLES;
+    mean_dmp      /= SAMPLES;
+
+    int   best_lag  = 0;
+    float best_corr = -1.0e30;
+    for (int lag = 0; lag <= MAX_LAG; lag++) {
+      float corr = 0.0;
+      for (int i = 0; i < SAMPLES - MAX_LAG; i++) {
+        corr += (roll_madgwick[i] - mean_madgwick) * (roll_dmp[i + lag] - mean_dmp);
+      }
+      if (corr > best_corr) {
+        best_corr = corr;
+        best_lag  = lag;
+      }
+    }
+
+    float us_per_cycle = 1000000.0 / F_CPU_ACTUAL;
+    Serial.printf(F("Madgwick6DOF: %7.1fus mean, %7.1fus max, every loop\n"),
+                  madgwick_cycles * us_per_cycle / SAMPLES, madgwick_max * us_per_cycle);
+    Serial.printf(F("DMP:          %7.1fus mean, %7.1fus max, %lu quaternions/s, %lu FIFO overflows\n"),
+                  dmp_cycles * us_per_cycle / SAMPLES, dmp_max * us_per_cycle, dmp_packets / 4, dmp_fifo_overflows);
+    Serial.printf(F("DMP latency:  %d ms behind Madgwick6DOF\n"), best_lag * 2);
+
+    while(1); //halt code so it won't enter main loop until this function commented out
+  #endif
+  Serial.println("Error: USE_MPU6050_DMP not selected. Nothing to compare.");
+  while(1); //halt code so it won't enter main loop until this function commented out
+}
+
 void loopRate(int freq) {
   //DESCRIPTION: Regulate main loop rate to specified frequency in Hz
   /*
@@ -1517,111 +2626,188 @@ void setupBlink(int numBlinks,int upTime, int downTime) {
 }
 
 void printTelemetryView() {
-  if (current_time - print_counter > 10000) {
-    print_counter = micros();
-    Serial.printf(
-      F("%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f\n"), 
-      GyroX,    GyroY,     GyroZ, 
-      AccX,     AccY,      AccZ, 
-      roll_IMU, pitch_IMU, yaw_IMU, 
-      roll_PID, pitch_PID, yaw_PID,
-      q0, q1, q2, q3);
-  }
+  //DESCRIPTION: CSV line for TelemetryViewer, see TelemetryView.txt for its settings
+  /*
+   * Same 22 values as sendTelemetryViewPacket(): the motors RPM and the gyro vibration peaks are always sent (0 when
+   * USE_DSHOT_BIDIR or USE_GYRO_FFT is not defined), so that the column layout does not depend on the build options.
+   */
+  console.printf(
+    F("%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f,%.2f"), 
+    GyroX,    GyroY,     GyroZ, 
+    AccX,     AccY,      AccZ, 
+    roll_IMU, pitch_IMU, yaw_IMU, 
+    roll_PID, pitch_PID, yaw_PID,
+    q0, q1, q2, q3);
+
+  console.printf(F(",%.0f,%.0f,%.0f"), front_motor_rpm, right_aileron_motor_rpm, left_aileron_motor_rpm);
+
+  float peak_hz[3] = { 0.0f, 0.0f, 0.0f };
+  #if defined USE_GYRO_FFT
+    for (int p = 0; p < 3; p++) {
+      if (p < gyro_fft.get_peak_count()) peak_hz[p] = gyro_fft.get_peak_hz(p);
+    }
+  #endif
+  console.printf(F(",%.0f,%.0f,%.0f"), peak_hz[0], peak_hz[1], peak_hz[2]);
+
+  console.println();
 }
 
-void printRadioData() {
-  if (current_time - print_counter > 10000) {
-    print_counter = micros();
+void sendTelemetryViewPacket() {
+  //DESCRIPTION: Binary version of printTelemetryView(), see TelemetryViewBinary.txt for the TelemetryViewer settings
+  /*
+   * Same 22 values as printTelemetryView(): the 16 flight values, then the motors RPM and the gyro vibration peaks (0 when
+   * USE_DSHOT_BIDIR or USE_GYRO_FFT is not defined). The floats are copied to the packet buffer as they are, 91 bytes are
+   * sent instead of ~130 characters that took a printf() float conversion each.
+   */
+  static TelemetryPacket packet;
 
-    #if defined USE_SBUS_RX
-      Serial.print(F("FAIL: ")); Serial.print  (sbusFailSafe ? "YES" : "NO");
-    #endif
+  packet.begin();
+  packet.add(GyroX);    packet.add(GyroY);     packet.add(GyroZ);
+  packet.add(AccX);     packet.add(AccY);      packet.add(AccZ);
+  packet.add(roll_IMU); packet.add(pitch_IMU); packet.add(yaw_IMU);
+  packet.add(roll_PID); packet.add(pitch_PID); packet.add(yaw_PID);
+  packet.add(q0);       packet.add(q1);        packet.add(q2);       packet.add(q3);
+
+  packet.add(front_motor_rpm); packet.add(right_aileron_motor_rpm); packet.add(left_aileron_motor_rpm);
 
-    Serial.printf(
-      F(" THRO: %4lu AIL: %4lu ELEV: %4lu RUDD: %4lu T_CUT: %4lu AUX1: %4lu\n"), 
-          throttle_pwm, 
-           aileron_pwm, 
-          elevator_pwm, 
-            rudder_pwm, 
-      throttle_cut_pwm, 
-              aux1_pwm);
+  for (int p = 0; p < 3; p++) {
+    #if defined USE_GYRO_FFT
+      packet.add((p < gyro_fft.get_peak_count()) ? gyro_fft.get_peak_hz(p) : 0.0f);
+    #else
+      packet.add(0.0f);
+    #endif
   }
+
+  console.write(packet.get_data(), packet.finish());
+}
+
+void printRadioData() {
+  #if defined USE_SBUS_RX
+    console.print(F("FAIL: ")); console.print  (sbusFailSafe ? "YES" : "NO");
+  #endif
+
+  console.printf(
+    F(" THRO: %4lu AIL: %4lu ELEV: %4lu RUDD: %4lu T_CUT: %4lu AUX1: %4lu\n"), 
+        throttle_pwm, 
+         aileron_pwm, 
+        elevator_pwm, 
+          rudder_pwm, 
+    throttle_cut_pwm, 
+            aux1_pwm);
 }
 
 void printDesiredState() {
-  if (current_time - print_counter > 10000) {
-    print_counter = micros();
-    Serial.print(F( "thro_des: " )); Serial.print  (thro_des);
-    Serial.print(F(" roll_des: " )); Serial.print  (roll_des);
-    Serial.print(F(" pitch_des: ")); Serial.print  (pitch_des);
-    Serial.print(F(" yaw_des: "  )); Serial.println(yaw_des);
-  }
+  console.print(F( "thro_des: " )); console.print  (thro_des);
+  console.print(F(" roll_des: " )); console.print  (roll_des);
+  console.print(F(" pitch_des: ")); console.print  (pitch_des);
+  console.print(F(" yaw_des: "  )); console.println(yaw_des);
 }
 
 void printGyroData() {
-  if (current_time - print_counter > 10000) {
-    print_counter = micros();
-    Serial.printf(F("GyroX: %7.2f GyroY: %7.2f GyroZ: %7.2f\n"), GyroX, GyroY, GyroZ);
-  }
+  console.printf(F("GyroX: %7.2f GyroY: %7.2f GyroZ: %7.2f\n"), GyroX, GyroY, GyroZ);
 }
 
 void printAccelData() {
-  if (current_time - print_counter > 10000) {
-    print_counter = micros();
-    Serial.printf(F("AccX: %5.2f AccY: %5.2f AccZ: %5.2f\n"), AccX, AccY, AccZ);
-  }
+  console.printf(F("AccX: %5.2f AccY: %5.2f AccZ: %5.2f\n"), AccX, AccY, AccZ);
 }
 
 void printMagData() {
-  if (current_time - print_counter > 10000) {
-    print_counter = micros();
-    Serial.printf(F("MagX: %7.2f MagY: %7.2f MagZ: %7.2f\n"), MagX, MagY, MagZ);
-  }
+  console.printf(F("MagX: %7.2f MagY: %7.2f MagZ: %7.2f\n"), MagX, MagY, MagZ);
 }
 
 void printRollPitchYaw() {
-  if (current_time - print_counter > 10000) {
-    print_counter = micros();
-    Serial.printf(F("Roll: %7.2f Pitch: %7.2f Yaw: %7.2f\n"), roll_IMU, pitch_IMU, yaw_IMU);
-  }
+  console.printf(F("Roll: %7.2f Pitch: %7.2f Yaw: %7.2f\n"), roll_IMU, pitch_IMU, yaw_IMU);
 }
 
 void printPIDoutput() {
-  if (current_time - print_counter > 10000) {
-    print_counter = micros();
-    Serial.printf(F("RollPID: %5.2f PitchPID: %5.2f YawPID: %5.2f\n"), roll_PID, pitch_PID, yaw_PID);
-  }
+  console.printf(F("RollPID: %5.2f PitchPID: %5.2f YawPID: %5.2f\n"), roll_PID, pitch_PID, yaw_PID);
 }
 
 void printMotorCommands() {
-  if (current_time - print_counter > 10000) {
-    print_counter = micros();
-    Serial.printf(
-      F("frontMotor: %4lu rightAileronMotor: %4lu leftAileronMotor: %4lu\n"),
-              front_motor_command_PWM,
-      right_aileron_motor_command_PWM,
-       left_aileron_motor_command_PWM);
-  }
+  console.printf(
+    F("frontMotor: %4lu rightAileronMotor: %4lu leftAileronMotor: %4lu\n"),
+            front_motor_command_PWM,
+    right_aileron_motor_command_PWM,
+     left_aileron_motor_command_PWM);
+}
+
+void printMotorsRPM() {
+  #if defined USE_DSHOT_BIDIR
+    console.printf(
+      F("frontMotor: %5.0f rightAileronMotor: %5.0f leftAileronMotor: %5.0f RPM (telemetry errors: %lu %lu %lu)\n"),
+              front_motor_rpm,
+      right_aileron_motor_rpm,
+       left_aileron_motor_rpm,
+      dshot.get_telemetry_errors(       frontMotorPin),
+      dshot.get_telemetry_errors(rightAileronMotorPin),
+      dshot.get_telemetry_errors( leftAileronMotorPin));
+  #else
+    console.println(F("Motors' RPM requires USE_DSHOT_BIDIR"));
+  #endif
+}
+
+void printGyroFFTPeaks() {
+  #if defined USE_GYRO_FFT
+    console.print(F("Gyro peaks:"));
+    for (int p = 0; p < gyro_fft.get_peak_count(); p++) {
+      console.printf(F(" %5.1fHz (%6.1f)"), gyro_fft.get_peak_hz(p), gyro_fft.get_peak_mag(p));
+    }
+    console.println();
+  #else
+    console.println(F("Gyro FFT Peaks requires USE_GYRO_FFT"));
+  #endif
 }
 
 void printServoCommands() {
-  if (current_time - print_counter > 10000) {
-    print_counter = micros();
-    Serial.printf(
-      F("frontMotor: %4lu rightAileron: %4lu leftAileron: %4lu rightElevator: %4lu leftElevator: %4lu\n"),
-         front_motor_servo_command_PWM,
-       right_aileron_servo_command_PWM,
-        left_aileron_servo_command_PWM,
-      right_elevator_servo_command_PWM,
-       left_elevator_servo_command_PWM);
-  }
+  console.printf(
+    F("frontMotor: %4lu rightAileron: %4lu leftAileron: %4lu rightElevator: %4lu leftElevator: %4lu\n"),
+       front_motor_servo_command_PWM,
+     right_aileron_servo_command_PWM,
+      left_aileron_servo_command_PWM,
+    right_elevator_servo_command_PWM,
+     left_elevator_servo_command_PWM);
 }
 
 void printLoopRate() {
-  if (current_time - print_counter > 10000) {
-    print_counter = micros();
-    Serial.print(F("dt = "));
-    Serial.println(dt*1000000.0);
+  console.print(F("dt = "));
+  console.println(dt*1000000.0);
+}
+
+void printSchedulerStats() {
+  static int count = 0;
+  if (++count >= 100) { //once per second
+    count = 0;
+    scheduler.show_stats();
+  }
+}
+
+void printLoopProfile() {
+  static int count = 0;
+  if (++count >= 100) { //once per second
+    count = 0;
+    profiler.show();
+    profiler.reset();
+    #if defined USE_MPU6050_ASYNC
+      lpi2c_async.show_stats();
+    #endif
+    #if defined USE_MPU6050_DMP
+      console.printf(F("DMP: %lu quaternions/s, %lu overflows\n"), dmp_packets, dmp_fifo_overflows);
+      dmp_packets = 0;
+    #endif
+    #if defined USE_IMU_FIFO
+      console.printf(F("IMU FIFO: %.1f samples per loop, %lu overflows\n"),
+                    imu_fifo_reads ? (float) imu_fifo_samples / imu_fifo_reads : 0.0f,
+                    imu_fifo_overflows);
+      imu_fifo_samples = imu_fifo_reads = 0;
+    #endif
+    console.show_stats();
+    #if defined USE_BLACKBOX
+      blackbox.show_stats();
+      blackbox_encoder.show_stats();
+    #endif
+    #if defined USE_SPORT
+      sport.show_stats();
+    #endif
   }
 }
 
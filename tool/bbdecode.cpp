@@ -0,0 +1,542 @@
+// Host Blackbox Log Decoder for the dRehmFlight Flight Control Software
+//
+// GPL 3.0
+//
+// Decodes the LOGnnnnn.BBL files written by the SD card blackbox (see src/Blackbox/blackbox_format.h).
+// The field names, scales and predictors are read from the log header. The file is memory mapped
+// and cut in chunks starting on intra frames, the chunks being decoded in parallel, a round of one
+// chunk per thread at a time to bound the memory used with multi-gigabyte logs. A chunk is decoded
+// up to the first intra frame of the next chunk. After a corrupted frame, decoding resumes at the
+// next intra frame.
+//
+// Output is CSV (one line per frame, values divided by their scale) or columnar: one raw int32
+// little endian file per field (<field>.i32, values multiplied by their scale) and a columns.txt
+// file listing the fields and scales, in an output directory.
+//
+// Build and run from the repository root:
+//
+//   g++ -O2 -std=gnu++14 -pthread -o bbdecode tool/bbdecode.cpp
+//   ./bbdecode [-t threads] [-f csv|columns] [-o output] LOG00001.BBL
+//   ./bbdecode -b LOG00001.BBL      (decoding throughput benchmark, no output)
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static const uint8_t SYNC_0       = 0xA5;   // Same as BlackboxEncoder
+static const uint8_t SYNC_1       = 0x5A;
+static const uint8_t INTRA_MARKER = 'I';
+static const uint8_t INTER_MARKER = 'P';
+
+static const size_t  CHUNK_SIZE   = 8 * 1024 * 1024;
+
+enum Predictor { PREDICT_NONE, PREDICT_PREVIOUS, PREDICT_LINEAR };
+
+struct Field {
+  std::string name;
+  double      scale;
+  int         predictor;
+  int         decimals;      // Power of 10 scales are printed as fixed point, -1 otherwise
+};
+
+struct Log {
+  const uint8_t    * data;
+  size_t             size;
+  size_t             frames_offset;  // First byte after the header
+  unsigned           divider;
+  unsigned           loop_rate;
+  unsigned           intra_interval;
+  std::vector<Field> fields;
+};
+
+struct Chunk {
+  size_t               begin, end;
+  std::vector<int32_t> values;         // Decoded frames, field_count values each
+  std::string          csv;
+  size_t               frames = 0;
+  size_t               intra_frames = 0;
+  size_t               errors = 0;     // Corrupted frames skipped
+};
+
+enum class Format { CSV, COLUMNS, NONE };
+
+// ---- Header ----
+
+static bool
+parse_header(Log & log)
+{
+  static const char MAGIC[] = "DRFBBX2\n";
+
+  if ((log.size < sizeof(MAGIC) - 1) || (memcmp(log.data, MAGIC, sizeof(MAGIC) - 1) != 0)) {
+    fprintf(stderr, "Not a blackbox log (DRFBBX2 expected)\n");
+    return false;
+  }
+
+  const char * p   = (const char *) log.data + sizeof(MAGIC) - 1;
+  const char * end = (const char *) log.data + log.size;
+
+  while (p < end) {
+    const char * eol = (const char *) memchr(p, '\n', end - p);
+    if (!eol || (p[0] != 'H') || (p[1] != ' ')) break;
+
+    std::string line(p + 2, eol);
+    p = eol + 1;
+
+    if (line == "end") {
+      log.frames_offset = p - (const char *) log.data;
+      return !log.fields.empty();
+    }
+
+    size_t colon = line.find(':');
+    if (colon == std::string::npos) continue;
+    std::string key   = line.substr(0, colon);
+    std::string value = line.substr(colon + 1);
+
+    if      (key == "divider")        log.divider        = atoi(value.c_str());
+    else if (key == "loop_rate")      log.loop_rate      = atoi(value.c_str());
+    else if (key == "intra_interval") log.intra_interval = atoi(value.c_str());
+    else if (key == "field") {
+      size_t c1 = value.find(',');
+      size_t c2 = value.find(',', c1 + 1);
+      if ((c1 == std::string::npos) || (c2 == std::string::npos)) continue;
+
+      Field f;
+      f.name      = value.substr(0, c1);
+      f.scale     = atof(value.substr(c1 + 1, c2 - c1 - 1).c_str());
+      f.predictor = atoi(value.substr(c2 + 1).c_str());
+      f.decimals  = -1;
+      for (int d = 0; d <= 6; d++) {
+        if (f.scale == pow(10.0, d)) f.decimals = d;
+      }
+      log.fields.push_back(f);
+    }
+  }
+
+  fprintf(stderr, "Truncated or invalid log header\n");
+  return false;
+}
+
+// ---- Frames ----
+
+static inline bool
+get_varint(const uint8_t *& p, const uint8_t * end, int32_t & value)
+{
+  uint32_t v = 0;
+
+  for (int shift = 0; shift < 35; shift += 7) {
+    if (p >= end) return false;
+    uint8_t b = *p++;
+    v |= (uint32_t) (b & 0x7F) << shift;
+    if (!(b & 0x80)) {
+      value = (int32_t) ((v >> 1) ^ (0U - (v & 1))); // zig-zag
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static inline bool
+decode_intra(const Log & log, const uint8_t *& p, const uint8_t * end, int32_t * values, int32_t * previous2)
+{
+  // p is after the sync sequence
+
+  int n = log.fields.size();
+
+  for (int i = 0; i < n; i++) {
+    if (!get_varint(p, end, values[i])) return false;
+    previous2[i] = values[i];
+  }
+
+  return true;
+}
+
+static inline bool
+decode_inter(const Log & log, const uint8_t *& p, const uint8_t * end, const int32_t * previous,
+             int32_t * previous2, int32_t * values)
+{
+  // p is after the marker
+
+  int             n      = log.fields.size();
+  const uint8_t * bitmap = p;
+
+  p += (n + 7) >> 3;
+  if (p > end) return false;
+
+  for (int i = 0; i < n; i++) {
+    int32_t residual = 0;
+
+    if ((bitmap[i >> 3] & (1 << (i & 7))) && !get_varint(p, end, residual)) return false;
+
+    uint32_t prediction;
+    switch (log.fields[i].predictor) {
+      case PREDICT_PREVIOUS: prediction = previous[i];                                          break;
+      case PREDICT_LINEAR:   prediction = 2 * (uint32_t) previous[i] - (uint32_t) previous2[i]; break;
+      default:               prediction = 0;                                                    break;
+    }
+    values[i]    = (int32_t) (prediction + (uint32_t) residual);
+    previous2[i] = previous[i];
+  }
+
+  return true;
+}
+
+static inline bool
+is_sync(const Log & log, size_t offset)
+{
+  return (offset + 3 <= log.size) &&
+         (log.data[offset] == SYNC_0) && (log.data[offset + 1] == SYNC_1) && (log.data[offset + 2] == INTRA_MARKER);
+}
+
+static bool
+valid_sync(const Log & log, size_t offset)
+{
+  // The sync bytes can also be found inside a frame: a real intra frame decodes to the field
+  // count and is followed by another frame or by the end of the log
+
+  if (!is_sync(log, offset)) return false;
+
+  std::vector<int32_t> values(log.fields.size()), previous2(log.fields.size());
+  const uint8_t      * p   = log.data + offset + 3;
+  const uint8_t      * end = log.data + log.size;
+
+  if (!decode_intra(log, p, end, values.data(), previous2.data())) return false;
+
+  return (p == end) || (*p == INTER_MARKER) || is_sync(log, p - log.data);
+}
+
+static size_t
+find_sync(const Log & log, size_t from)
+{
+  // Offset of the first intra frame at or after from, log.size if none. from is past the end
+  // after a frame truncated at the end of the log.
+
+  if (from >= log.size) return log.size;
+
+  const uint8_t * p = log.data + from;
+
+  while ((p = (const uint8_t *) memchr(p, SYNC_0, log.data + log.size - p)) != nullptr) {
+    if (valid_sync(log, p - log.data)) return p - log.data;
+    p++;
+  }
+
+  return log.size;
+}
+
+static void
+decode_chunk(const Log & log, Chunk & chunk)
+{
+  int                  n = log.fields.size();
+  std::vector<int32_t> current(n), previous(n), previous2(n);
+  bool                 synced = false;
+  const uint8_t      * p      = log.data + chunk.begin;
+  const uint8_t      * end    = log.data + chunk.end;
+
+  chunk.values.clear();
+  chunk.values.reserve((chunk.end - chunk.begin) / 16);
+
+  while (p < end) {
+    bool ok;
+
+    if ((*p == SYNC_0) && is_sync(log, p - log.data)) {
+      p     += 3;
+      ok     = decode_intra(log, p, log.data + log.size, current.data(), previous2.data());
+      synced = ok;
+      if (ok) chunk.intra_frames++;
+    }
+    else if ((*p == INTER_MARKER) && synced) {
+      p++;
+      ok = decode_inter(log, p, log.data + log.size, previous.data(), previous2.data(), current.data());
+    }
+    else {
+      ok = false;
+    }
+
+    if (!ok) {
+      chunk.errors++;
+      synced = false;
+      size_t next = find_sync(log, (p - log.data) + 1);
+      p = log.data + std::min(next, chunk.end);
+      continue;
+    }
+
+    chunk.values.insert(chunk.values.end(), current.begin(), current.end());
+    chunk.frames++;
+    std::swap(current, previous);
+  }
+}
+
+// ---- Output ----
+
+static inline void
+append_int(std::string & out, int64_t v)
+{
+  char   buf[24];
+  char * p   = buf + sizeof(buf);
+  bool   neg = v < 0;
+  uint64_t u = neg ? -(uint64_t) v : (uint64_t) v;
+
+  do { *--p = '0' + (u % 10); u /= 10; } while (u);
+  if (neg) *--p = '-';
+  out.append(p, buf + sizeof(buf) - p);
+}
+
+static inline void
+append_value(std::string & out, const Field & f, int32_t v)
+{
+  if (f.decimals == 0) {
+    append_int(out, v);
+  }
+  else if (f.decimals > 0) {
+    // Fixed point: integer part, then exactly f.decimals digits
+    int64_t div = (int64_t) f.scale;
+    int64_t a   = v < 0 ? -(int64_t) v : v;
+    if (v < 0) out.push_back('-');
+    append_int(out, a / div);
+    out.push_back('.');
+    std::string frac;
+    append_int(frac, a % div);
+    out.append(f.decimals - frac.size(), '0');
+    out.append(frac);
+  }
+  else {
+    char buf[32];
+    out.append(buf, snprintf(buf, sizeof(buf), "%g", v / f.scale));
+  }
+}
+
+static void
+format_csv(const Log & log, Chunk & chunk)
+{
+  int n = log.fields.size();
+
+  chunk.csv.clear();
+  chunk.csv.reserve(chunk.frames * n * 6);
+
+  for (size_t row = 0; row < chunk.frames; row++) {
+    const int32_t * v = &chunk.values[row * n];
+    for (int i = 0; i < n; i++) {
+      if (i) chunk.csv.push_back(',');
+      append_value(chunk.csv, log.fields[i], v[i]);
+    }
+    chunk.csv.push_back('\n');
+  }
+}
+
+struct Output {
+  Format              format;
+  FILE              * csv = nullptr;
+  std::vector<FILE *> columns;
+};
+
+static bool
+open_output(const Log & log, Output & out, const char * path)
+{
+  if (out.format == Format::CSV) {
+    out.csv = path ? fopen(path, "w") : stdout;
+    if (!out.csv) { perror(path); return false; }
+    for (size_t i = 0; i < log.fields.size(); i++) {
+      fprintf(out.csv, "%s%s", i ? "," : "", log.fields[i].name.c_str());
+    }
+    fprintf(out.csv, "\n");
+  }
+  else if (out.format == Format::COLUMNS) {
+    std::string dir = path ? path : "bbdecode_columns";
+    mkdir(dir.c_str(), 0755);
+
+    FILE * index = fopen((dir + "/columns.txt").c_str(), "w");
+    if (!index) { perror(dir.c_str()); return false; }
+    fprintf(index, "# name scale (<name>.i32: int32 little endian, value = raw / scale)\n");
+
+    for (auto & f : log.fields) {
+      fprintf(index, "%s %g\n", f.name.c_str(), f.scale);
+      FILE * file = fopen((dir + "/" + f.name + ".i32").c_str(), "wb");
+      if (!file) { perror(f.name.c_str()); fclose(index); return false; }
+      out.columns.push_back(file);
+    }
+    fclose(index);
+  }
+
+  return true;
+}
+
+static void
+write_chunk(const Log & log, Output & out, const Chunk & chunk)
+{
+  if ((out.format == Format::CSV) && out.csv) {
+    fwrite(chunk.csv.data(), 1, chunk.csv.size(), out.csv);
+  }
+  else if (out.format == Format::COLUMNS) {
+    int                  n = log.fields.size();
+    std::vector<int32_t> column(chunk.frames);
+    for (int i = 0; i < n; i++) {
+      for (size_t row = 0; row < chunk.frames; row++) column[row] = chunk.values[row * n + i];
+      fwrite(column.data(), sizeof(int32_t), chunk.frames, out.columns[i]);
+    }
+  }
+}
+
+static void
+close_output(Output & out)
+{
+  if (out.csv && (out.csv != stdout)) fclose(out.csv);
+  for (auto f : out.columns) fclose(f);
+}
+
+// ---- Parallel decode ----
+
+struct Totals {
+  size_t frames = 0, intra_frames = 0, errors = 0;
+};
+
+static Totals
+decode_log(const Log & log, Output & out, int thread_count)
+{
+  Totals             totals;
+  std::vector<Chunk> chunks(thread_count);
+  size_t             next = find_sync(log, log.frames_offset);
+
+  if (next != log.frames_offset) totals.errors++; // Garbage between the header and the first intra frame
+
+  while (next < log.size) {
+    // Next round: up to one chunk per thread, each one starting on an intra frame
+
+    int count = 0;
+    while ((count < thread_count) && (next < log.size)) {
+      chunks[count].begin = next;
+      next = (log.size - next > CHUNK_SIZE) ? find_sync(log, next + CHUNK_SIZE) : log.size;
+      chunks[count].end = next;
+      count++;
+    }
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < count; i++) {
+      threads.emplace_back([&, i]() {
+        Chunk & c = chunks[i];
+        c.frames = c.intra_frames = c.errors = 0;
+        decode_chunk(log, c);
+        if (out.format == Format::CSV) format_csv(log, c);
+      });
+    }
+    for (auto & t : threads) t.join();
+
+    for (int i = 0; i < count; i++) {
+      write_chunk(log, out, chunks[i]);
+      totals.frames       += chunks[i].frames;
+      totals.intra_frames += chunks[i].intra_frames;
+      totals.errors       += chunks[i].errors;
+    }
+  }
+
+  return totals;
+}
+
+static void
+benchmark(const Log & log, int thread_count)
+{
+  // Best of 3 runs, decode only then decode and CSV formatting (no output file: Output::csv is null)
+
+  const Format formats[] = { Format::NONE, Format::CSV };
+  const char * names[]   = { "decode",     "decode + CSV" };
+
+  for (int f = 0; f < 2; f++) {
+    double best = 1.0e30;
+    Totals totals;
+
+    for (int run = 0; run < 3; run++) {
+      Output out;
+      out.format = formats[f];
+
+      auto start = std::chrono::steady_clock::now();
+      totals     = decode_log(log, out, thread_count);
+      std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+      best = std::min(best, elapsed.count());
+    }
+
+    fprintf(stderr, "%-13s %2d threads: %8.1f MB/s, %.1f Mframes/s\n", names[f], thread_count,
+            log.size / best / 1.0e6, totals.frames / best / 1.0e6);
+  }
+}
+
+static void
+usage()
+{
+  fprintf(stderr, "Usage: bbdecode [-t threads] [-f csv|columns] [-o output] [-b] LOGnnnnn.BBL\n"
+                  "  -t  decoding threads (default: hardware concurrency)\n"
+                  "  -f  csv (default, to stdout without -o) or columns (one .i32 file per field in the -o directory)\n"
+                  "  -o  output file (csv) or directory (columns)\n"
+                  "  -b  throughput benchmark, no output\n");
+}
+
+int
+main(int argc, char ** argv)
+{
+  int          thread_count = std::max(1U, std::thread::hardware_concurrency());
+  Format       format       = Format::CSV;
+  const char * output       = nullptr;
+  bool         bench        = false;
+  int          opt;
+
+  while ((opt = getopt(argc, argv, "t:f:o:b")) != -1) {
+    switch (opt) {
+      case 't': thread_count = std::max(1, atoi(optarg)); break;
+      case 'o': output = optarg;                           break;
+      case 'b': bench = true;                              break;
+      case 'f':
+        if      (!strcmp(optarg, "csv"))     format = Format::CSV;
+        else if (!strcmp(optarg, "columns")) format = Format::COLUMNS;
+        else { usage(); return 1; }
+        break;
+      default: usage(); return 1;
+    }
+  }
+  if (optind != argc - 1) { usage(); return 1; }
+
+  int fd = open(argv[optind], O_RDONLY);
+  struct stat st;
+  if ((fd < 0) || (fstat(fd, &st) < 0)) { perror(argv[optind]); return 1; }
+  if (st.st_size == 0) { fprintf(stderr, "Empty log\n"); return 1; }
+
+  Log log = {};
+  log.size = st.st_size;
+  log.data = (const uint8_t *) mmap(nullptr, log.size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (log.data == MAP_FAILED) { perror("mmap"); return 1; }
+  madvise((void *) log.data, log.size, MADV_SEQUENTIAL);
+
+  if (!parse_header(log)) return 1;
+
+  fprintf(stderr, "%s: %zu bytes, %zu fields, loop %u Hz / %u, intra frame every %u frames\n",
+          argv[optind], log.size, log.fields.size(), log.loop_rate, log.divider, log.intra_interval);
+
+  if (bench) {
+    benchmark(log, thread_count);
+  }
+  else {
+    Output out;
+    out.format = format;
+    if (!open_output(log, out, output)) return 1;
+
+    Totals totals = decode_log(log, out, thread_count);
+    close_output(out);
+
+    fprintf(stderr, "%zu frames (%zu intra), %zu corrupted frames skipped\n",
+            totals.frames, totals.intra_frames, totals.errors);
+  }
+
+  munmap((void *) log.data, log.size);
+  return 0;
+}
@@ -0,0 +1,264 @@
+// Host Test of the Blackbox Log Decoder for the dRehmFlight Flight Control Software
+//
+// GPL 3.0
+//
+// Generates a blackbox log in the format of src/Blackbox/blackbox_format.h, larger than one
+// decoder chunk, and checks that bbdecode gives back the same values (columns output). Then checks
+// logs truncated inside their last frame (intra and inter) and a log with a corrupted frame:
+// decoding resumes at the next intra frame. Ends with the -b benchmark on the generated log.
+//
+// Build and run from the repository root:
+//
+//   g++ -O2 -std=gnu++14 -pthread -o bbdecode tool/bbdecode.cpp
+//   g++ -O2 -std=gnu++14 -o bbdecode_test tool/bbdecode_test.cpp && ./bbdecode_test ./bbdecode
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static const uint8_t SYNC_0         = 0xA5;   // Same as BlackboxEncoder
+static const uint8_t SYNC_1         = 0x5A;
+static const uint8_t INTRA_MARKER   = 'I';
+static const uint8_t INTER_MARKER   = 'P';
+static const int     INTRA_INTERVAL = 32;
+static const int     FRAMES         = 32 * 40000 + 1;   // About 12MB, the last frame is an intra frame
+
+enum Predictor { PREDICT_NONE, PREDICT_PREVIOUS, PREDICT_LINEAR };
+
+struct Field {
+  const char * name;
+  float        scale;
+  int          predictor;
+};
+
+static const Field FIELDS[] = {
+  { "time_us",  1,    PREDICT_LINEAR   },
+  { "gyro_x",   100,  PREDICT_PREVIOUS },
+  { "gyro_y",   100,  PREDICT_PREVIOUS },
+  { "gyro_z",   100,  PREDICT_PREVIOUS },
+  { "motor_1",  1,    PREDICT_NONE     },
+  { "armed",    1,    PREDICT_PREVIOUS },
+};
+
+static const int FIELD_COUNT = sizeof(FIELDS) / sizeof(FIELDS[0]);
+
+struct TestLog {
+  std::vector<uint8_t> data;
+  std::vector<size_t>  frame_offset;   // Of each frame, then of the end of the log
+  std::vector<int32_t> values;         // FIELD_COUNT per frame
+};
+
+static const char * decoder;
+static std::string  dir;
+static int          failures;
+
+// ---- Encoder, same format as BlackboxEncoder::encode() ----
+
+static void
+put_varint(std::vector<uint8_t> & out, int32_t value)
+{
+  uint32_t v = ((uint32_t) value << 1) ^ (uint32_t) (value >> 31);   // zig-zag
+
+  while (v >= 0x80) {
+    out.push_back((uint8_t) (v | 0x80));
+    v >>= 7;
+  }
+  out.push_back((uint8_t) v);
+}
+
+static void
+generate(TestLog & log)
+{
+  char header[1024];
+  int  len = snprintf(header, sizeof(header), "DRFBBX2\nH divider:2\nH loop_rate:2000\nH intra_interval:%d\n",
+                      INTRA_INTERVAL);
+
+  for (int i = 0; i < FIELD_COUNT; i++) {
+    len += snprintf(header + len, sizeof(header) - len, "H field:%s,%g,%d\n",
+                    FIELDS[i].name, (double) FIELDS[i].scale, FIELDS[i].predictor);
+  }
+  len += snprintf(header + len, sizeof(header) - len, "H end\n");
+
+  log.data.assign(header, header + len);
+
+  int32_t  values[FIELD_COUNT], previous[FIELD_COUNT], previous2[FIELD_COUNT];
+  uint32_t seed = 12345;
+
+  memset(values, 0, sizeof(values));
+  values[0] = 0xFFF00000;   // time_us wraps around
+
+  for (int frame = 0; frame < FRAMES; frame++) {
+    seed = seed * 1664525 + 1013904223;
+
+    values[0] += 1000 + ((seed >> 28) == 0 ? 3 : 0);   // Loop time jitter
+    for (int i = 1; i <= 3; i++) values[i] += (int32_t) ((seed >> (8 * i)) & 0x3FF) - 512;
+    values[4] = 1000 + (seed & 0x3FF);
+    values[5] = (frame / 5000) & 1;
+
+    log.frame_offset.push_back(log.data.size());
+    log.values.insert(log.values.end(), values, values + FIELD_COUNT);
+
+    if ((frame % INTRA_INTERVAL) == 0) {
+      log.data.push_back(SYNC_0);
+      log.data.push_back(SYNC_1);
+      log.data.push_back(INTRA_MARKER);
+      for (int i = 0; i < FIELD_COUNT; i++) {
+        put_varint(log.data, values[i]);
+        previous2[i] = previous[i] = values[i];
+      }
+      continue;
+    }
+
+    log.data.push_back(INTER_MARKER);
+    size_t bitmap = log.data.size();
+    log.data.resize(bitmap + ((FIELD_COUNT + 7) >> 3), 0);
+
+    for (int i = 0; i < FIELD_COUNT; i++) {
+      uint32_t prediction;
+      switch (FIELDS[i].predictor) {
+        case PREDICT_PREVIOUS: prediction = previous[i];                                          break;
+        case PREDICT_LINEAR:   prediction = 2 * (uint32_t) previous[i] - (uint32_t) previous2[i]; break;
+        default:               prediction = 0;                                                    break;
+      }
+      int32_t residual = (int32_t) ((uint32_t) values[i] - prediction);
+      if (residual != 0) {
+        log.data[bitmap + (i >> 3)] |= 1 << (i & 7);
+        put_varint(log.data, residual);
+      }
+      previous2[i] = previous[i];
+      previous[i]  = values[i];
+    }
+  }
+
+  log.frame_offset.push_back(log.data.size());
+}
+
+// ---- Decoder runs ----
+
+static bool
+write_file(const std::string & path, const uint8_t * data, size_t size)
+{
+  FILE * file = fopen(path.c_str(), "wb");
+  if (!file) { perror(path.c_str()); return false; }
+  bool ok = fwrite(data, 1, size, file) == size;
+  fclose(file);
+  return ok;
+}
+
+static bool
+run_decoder(const std::string & options, const std::string & path)
+{
+  std::string command = std::string(decoder) + " " + options + " " + path + " 2>/dev/null";
+  return system(command.c_str()) == 0;
+}
+
+// Decodes data and compares the output with the expected frames of the log, prints the failure
+
+static bool
+check(const char * name, const TestLog & log, const std::vector<uint8_t> & data, const std::vector<int> & frames)
+{
+  std::string path    = dir + "/" + name + ".BBL";
+  std::string columns = dir + "/" + name;
+
+  if (!write_file(path, data.data(), data.size()) || !run_decoder("-t 4 -f columns -o " + columns, path)) {
+    printf("%-22s FAILED: bbdecode error\n", name);
+    return false;
+  }
+
+  for (int i = 0; i < FIELD_COUNT; i++) {
+    std::string          column_path = columns + "/" + FIELDS[i].name + ".i32";
+    FILE               * file        = fopen(column_path.c_str(), "rb");
+    std::vector<int32_t> column(frames.size() + 1);
+    size_t               count       = file ? fread(column.data(), sizeof(int32_t), column.size(), file) : 0;
+
+    if (file) fclose(file);
+
+    if (count != frames.size()) {
+      printf("%-22s FAILED: %s has %zu frames, %zu expected\n", name, FIELDS[i].name, count, frames.size());
+      return false;
+    }
+    for (size_t row = 0; row < count; row++) {
+      if (column[row] != log.values[frames[row] * FIELD_COUNT + i]) {
+        printf("%-22s FAILED: %s differs at frame %d\n", name, FIELDS[i].name, frames[row]);
+        return false;
+      }
+    }
+  }
+
+  return true;
+}
+
+static void
+report(const char * name, bool ok, const char * details)
+{
+  if (ok) printf("%-22s OK, %s\n", name, details);
+  else    failures++;
+}
+
+static std::vector<int>
+frame_range(int first, int last)
+{
+  std::vector<int> frames;
+  for (int i = first; i < last; i++) frames.push_back(i);
+  return frames;
+}
+
+int
+main(int argc, char ** argv)
+{
+  if (argc != 2) {
+    fprintf(stderr, "Usage: bbdecode_test <path of bbdecode>\n");
+    return 1;
+  }
+  decoder = argv[1];
+
+  char tmp[] = "/tmp/bbdecode_test.XXXXXX";
+  if (!mkdtemp(tmp)) { perror("mkdtemp"); return 1; }
+  dir = tmp;
+
+  TestLog log;
+  generate(log);
+  printf("Generated log: %zu bytes, %d frames\n", log.data.size(), FRAMES);
+
+  report("round_trip", check("round_trip", log, log.data, frame_range(0, FRAMES)), "all frames");
+
+  // Every cut inside the last frame (intra), then inside the frame before it (inter)
+
+  for (int last = FRAMES - 1; last >= FRAMES - 2; last--) {
+    const char * name = (last == FRAMES - 1) ? "truncated_intra" : "truncated_inter";
+    bool         ok   = true;
+
+    for (size_t cut = log.frame_offset[last] + 1; ok && (cut < log.frame_offset[last + 1]); cut++) {
+      std::vector<uint8_t> data(log.data.begin(), log.data.begin() + cut);
+      ok = check(name, log, data, frame_range(0, last));
+    }
+    report(name, ok, "truncated frame skipped at every cut");
+  }
+
+  // Corrupted marker of an inter frame: the frames up to the next intra frame are skipped
+
+  int                  corrupted = INTRA_INTERVAL * 1000 + 7;
+  int                  resumed   = INTRA_INTERVAL * 1001;
+  std::vector<uint8_t> data      = log.data;
+  std::vector<int>     frames    = frame_range(0, corrupted);
+  std::vector<int>     tail      = frame_range(resumed, FRAMES);
+
+  data[log.frame_offset[corrupted]] = 0;
+  frames.insert(frames.end(), tail.begin(), tail.end());
+  report("corrupted", check("corrupted", log, data, frames), "resumed at the next intra frame");
+
+  // Throughput benchmark on the generated log
+
+  bool bench = run_decoder("-b", dir + "/round_trip.BBL");
+  if (!bench) printf("%-22s FAILED: bbdecode error\n", "benchmark");
+  report("benchmark", bench, "bbdecode -b");
+
+  std::string cleanup = "rm -r " + dir;
+  if (system(cleanup.c_str()) != 0) fprintf(stderr, "%s not removed\n", dir.c_str());
+
+  printf("%s\n", failures ? "FAILED" : "All tests passed");
+  return failures ? 1 : 0;
+}
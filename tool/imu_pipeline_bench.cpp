@@ -0,0 +1,130 @@
+// Host Benchmark of the IMU Sensor Pipeline for the dRehmFlight Flight Control Software
+//
+// GPL 3.0
+//
+// Runs the raw to filtered gyro and accelerometer conversion of getIMUdata() on the same random
+// samples, the way it was done with the GYRO_SCALE_FACTOR / ACCEL_SCALE_FACTOR double literals,
+// then with the SensorPipeline type. Both results are checked to be the same. The host timings
+// say nothing of the Cortex-M7 cost: on target, use the IMU stage of the Loop Profile output.
+//
+// Build and run from the repository root:
+//
+//   g++ -O2 -std=gnu++14 -I src -o imu_pipeline_bench tool/imu_pipeline_bench.cpp && ./imu_pipeline_bench
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "IMU/sensor_pipeline.h"
+
+typedef SensorPipeline<IMUDriver::MPU6050, IMUGyroRange::DPS_250, IMUAccelRange::G_2> Pipeline;
+
+#define GYRO_SCALE_FACTOR  131.0
+#define ACCEL_SCALE_FACTOR 16384.0
+
+static const int SAMPLES =   4096;
+static const int PASSES  =  10000;
+
+static const float B_accel = 0.14;
+static const float B_gyro  = 0.1;
+
+static const float acc_error[3]  = { 0.012f, -0.020f, 0.031f };
+static const float gyro_error[3] = { 0.500f, -1.250f, 0.750f };
+
+static float AccX_prev, AccY_prev, AccZ_prev, GyroX_prev, GyroY_prev, GyroZ_prev;
+
+static void
+legacy(const IMURawSample & raw, float acc[3], float gyro[3])
+{
+  float AccX, AccY, AccZ, GyroX, GyroY, GyroZ;
+
+  AccX = raw.acc[0] / ACCEL_SCALE_FACTOR;
+  AccY = raw.acc[1] / ACCEL_SCALE_FACTOR;
+  AccZ = raw.acc[2] / ACCEL_SCALE_FACTOR;
+  AccX = AccX - acc_error[0];
+  AccY = AccY - acc_error[1];
+  AccZ = AccZ - acc_error[2];
+  AccX = (1.0 - B_accel) * AccX_prev + B_accel*AccX;
+  AccY = (1.0 - B_accel) * AccY_prev + B_accel*AccY;
+  AccZ = (1.0 - B_accel) * AccZ_prev + B_accel*AccZ;
+  AccX_prev = AccX;
+  AccY_prev = AccY;
+  AccZ_prev = AccZ;
+
+  GyroX = raw.gyro[0] / GYRO_SCALE_FACTOR;
+  GyroY = raw.gyro[1] / GYRO_SCALE_FACTOR;
+  GyroZ = raw.gyro[2] / GYRO_SCALE_FACTOR;
+  GyroX = GyroX - gyro_error[0];
+  GyroY = GyroY - gyro_error[1];
+  GyroZ = GyroZ - gyro_error[2];
+  GyroX = (1.0 - B_gyro) * GyroX_prev + B_gyro*GyroX;
+  GyroY = (1.0 - B_gyro) * GyroY_prev + B_gyro*GyroY;
+  GyroZ = (1.0 - B_gyro) * GyroZ_prev + B_gyro*GyroZ;
+  GyroX_prev = GyroX;
+  GyroY_prev = GyroY;
+  GyroZ_prev = GyroZ;
+
+  acc[0]  = AccX;  acc[1]  = AccY;  acc[2]  = AccZ;
+  gyro[0] = GyroX; gyro[1] = GyroY; gyro[2] = GyroZ;
+}
+
+template <typename F>
+static double
+run(const std::vector<IMURawSample> & samples, std::vector<float> & out, F step)
+{
+  auto start = std::chrono::steady_clock::now();
+
+  for (int pass = 0; pass < PASSES; pass++) {
+    for (int i = 0; i < SAMPLES; i++) {
+      step(samples[i], &out[i * 6], &out[i * 6 + 3]);
+    }
+  }
+
+  std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+  return elapsed.count() / ((double) SAMPLES * PASSES);
+}
+
+int
+main()
+{
+  std::vector<IMURawSample> samples(SAMPLES);
+  std::vector<float>        out_legacy(SAMPLES * 6), out_pipeline(SAMPLES * 6);
+
+  srand(1);
+  for (auto & s : samples) {
+    for (int i = 0; i < 3; i++) {
+      s.acc[i]  = (rand() % 65536) - 32768;
+      s.gyro[i] = (rand() % 65536) - 32768;
+    }
+  }
+
+  Pipeline pipeline;
+  pipeline.setup(acc_error, B_accel, gyro_error, B_gyro);
+
+  auto step = [&](const IMURawSample & raw, float acc[3], float gyro[3]) {
+    pipeline.process_accel(raw, acc);
+    pipeline.convert_gyro(raw, gyro);
+    pipeline.filter_gyro(gyro);
+  };
+
+  // Best of 5 runs, to filter out the host scheduling noise
+
+  double ns_legacy = 1.0e9, ns_pipeline = 1.0e9;
+  for (int i = 0; i < 5; i++) {
+    ns_legacy   = fmin(ns_legacy,   run(samples, out_legacy,   legacy));
+    ns_pipeline = fmin(ns_pipeline, run(samples, out_pipeline, step));
+  }
+
+  float max_diff = 0.0f;
+  for (int i = 0; i < SAMPLES * 6; i++) {
+    max_diff = fmaxf(max_diff, fabsf(out_legacy[i] - out_pipeline[i]));
+  }
+
+  printf("Legacy defines:  %6.2f ns per 6-axis sample\n", ns_legacy);
+  printf("SensorPipeline:  %6.2f ns per 6-axis sample (%.2fx)\n", ns_pipeline, ns_legacy / ns_pipeline);
+  printf("Max difference:  %g\n", max_diff);
+
+  return (max_diff < 1.0e-3f) ? 0 : 1;
+}